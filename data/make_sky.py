@@ -0,0 +1,62 @@
+#!/usr/bin/env python3
+# Writes sky.hdr, the environment map of the random_spheres scene:
+#
+#   python3 make_sky.py > sky.hdr
+#
+# An equirectangular Radiance RGBE image in the layout EnvironmentMap
+# expects, u = phi / 2 pi around the y axis starting at +x and
+# v = theta / pi from +y down. The sky blends from white at the horizon to
+# blue at the zenith, the ground is a flat brown, and a sun 35 degrees above
+# the horizon with a glow around it outshines both by orders of magnitude.
+import math
+import sys
+
+WIDTH, HEIGHT = 256, 128
+
+SUN_THETA = math.radians(55.0)  # from the zenith
+SUN_PHI = math.radians(30.0)
+SUN_RADIUS = math.radians(2.0)
+SUN = (1000.0, 950.0, 850.0)
+GLOW = 0.5       # added to the sky towards the sun
+GLOW_EXPONENT = 32
+
+HORIZON = (1.0, 1.0, 1.0)
+ZENITH = (0.3, 0.5, 1.0)
+GROUND = (0.15, 0.13, 0.10)
+
+
+def direction(theta, phi):
+    return (math.sin(theta) * math.cos(phi), math.cos(theta), math.sin(theta) * math.sin(phi))
+
+
+def radiance(d, sun):
+    if d[1] < 0.0:
+        return GROUND
+    cos_sun = sum(a * b for a, b in zip(d, sun))
+    if cos_sun > math.cos(SUN_RADIUS):
+        return SUN
+    glow = GLOW * max(cos_sun, 0.0) ** GLOW_EXPONENT
+    return tuple((1.0 - d[1]) * h + d[1] * z + glow for h, z in zip(HORIZON, ZENITH))
+
+
+def rgbe(c):
+    largest = max(c)
+    if largest < 1e-32:
+        return bytes(4)
+    mantissa, exponent = math.frexp(largest)
+    scale = mantissa * 256.0 / largest
+    return bytes([int(c[0] * scale), int(c[1] * scale), int(c[2] * scale), exponent + 128])
+
+
+def main():
+    sun = direction(SUN_THETA, SUN_PHI)
+    out = bytearray(b'#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n\n-Y %d +X %d\n' % (HEIGHT, WIDTH))
+    for j in range(HEIGHT):
+        for i in range(WIDTH):
+            d = direction(math.pi * (j + 0.5) / HEIGHT, 2.0 * math.pi * (i + 0.5) / WIDTH)
+            out += rgbe(radiance(d, sun))
+    sys.stdout.buffer.write(out)
+
+
+if __name__ == '__main__':
+    main()
@@ -4,10 +4,22 @@
 #include <ray.hpp>
 #include <vec3.hpp>
 
+#include <algorithm>
 #include <cmath>
+#include <optional>
+#include <utility>
 
 using AabbBounds = TypedInterval<vec3, struct AabbBoundsTag>;
 
+// Bounds of the origins and inverse directions of a packet of rays. Packets
+// whose directions share a nonzero sign per axis are coherent and can be
+// culled as a whole with interval arithmetic.
+struct PacketBounds {
+    vec3 origin_min{0.0}, origin_max{0.0};
+    vec3 inverse_direction_min{0.0}, inverse_direction_max{0.0};
+    bool coherent{false};
+};
+
 template <>
 struct TypedIntervalTraits<vec3, struct AabbBoundsTag> {
     static vec3 length(vec3 const & difference) { return difference; }
@@ -22,6 +34,13 @@ public:
 
     bool hit(Ray const & r, TimeInterval times) const;
 
+    // ray parameters at which the ray enters and leaves the box, if it does so within `times`
+    std::optional<TimeInterval> intersect_interval(Ray const & r,
+                                                   TimeInterval times = TimeInterval{-infinity, infinity}) const;
+
+    // false only if no ray of a coherent packet hits the box within `times`
+    bool may_hit(PacketBounds const & packet, TimeInterval times) const;
+
     explicit operator bool() const {
         return bounds_.min.x <= bounds_.max.x &&
                bounds_.min.y <= bounds_.max.y &&
@@ -65,6 +84,47 @@ inline bool Aabb::hit(Ray const & r, TimeInterval times) const {
     return true;
 }
 
+inline bool Aabb::may_hit(PacketBounds const & packet, TimeInterval times) const {
+    if (!packet.coherent)
+        return true;
+
+    // bounds of the products of two intervals
+    auto const product = [](double const a0, double const a1, double const b0, double const b1) {
+        auto const p0 = a0 * b0, p1 = a0 * b1, p2 = a1 * b0, p3 = a1 * b1;
+        return std::pair{std::min({p0, p1, p2, p3}), std::max({p0, p1, p2, p3})};
+    };
+
+    for (std::size_t dim = 0; dim < 3; ++dim) {
+        auto const inverse_min = packet.inverse_direction_min[dim];
+        auto const inverse_max = packet.inverse_direction_max[dim];
+        auto const near = inverse_min > 0.0 ? bounds_.min[dim] : bounds_.max[dim];
+        auto const far = inverse_min > 0.0 ? bounds_.max[dim] : bounds_.min[dim];
+        // earliest entry and latest exit of any ray of the packet
+        auto const entry = product(near - packet.origin_max[dim], near - packet.origin_min[dim], inverse_min, inverse_max).first;
+        auto const exit = product(far - packet.origin_max[dim], far - packet.origin_min[dim], inverse_min, inverse_max).second;
+        times.min = entry > times.min ? entry : times.min;
+        times.max = exit < times.max ? exit : times.max;
+        if (times.max <= times.min)
+            return false;
+    }
+    return true;
+}
+
+inline std::optional<TimeInterval> Aabb::intersect_interval(Ray const & r, TimeInterval times) const {
+    for (std::size_t dim = 0; dim < 3; ++dim) {
+        auto const inverse_direction = 1.0 / r.d[dim];
+        auto t0 = (bounds_.min[dim] - r.o[dim]) * inverse_direction;
+        auto t1 = (bounds_.max[dim] - r.o[dim]) * inverse_direction;
+        if (inverse_direction < 0.0)
+            std::swap(t0, t1);
+        times.min = t0 > times.min ? t0 : times.min;
+        times.max = t1 < times.max ? t1 : times.max;
+        if (times.max < times.min)
+            return std::nullopt;
+    }
+    return times;
+}
+
 Aabb surrounding_box(Aabb const & aabb0, Aabb const & aabb1) {
     return Aabb{AabbBounds{
         min_components(aabb0.min(), aabb1.min()),
@@ -68,6 +68,19 @@ TEST_F(AnAabb, can_be_missed) {
     EXPECT_FALSE(aabb.hit(r, TimeInterval{0.0, 2.0 * aabb.max().z}));
 }
 
+TEST_F(AnAabb, returns_entry_and_exit_interval) {
+    Ray const r{point3{-2.0, 0.0, 0.0}, vec3{0.5, 0.0, 0.0}};
+    auto const interval = aabb.intersect_interval(r);
+    ASSERT_TRUE(interval);
+    EXPECT_THAT(interval->min, Eq(2.0));
+    EXPECT_THAT(interval->max, Eq(6.0));
+}
+
+TEST_F(AnAabb, returns_no_interval_when_missed) {
+    Ray const r{2.0 * aabb.max(), vec3{1.0, 0.0, 0.0}};
+    EXPECT_FALSE(aabb.intersect_interval(r));
+}
+
 TEST(Aabb, can_be_cast_to_bool) {
     Aabb const box_true{AabbBounds{vec3{0.0}, vec3{1.0}}};
     Aabb const box_false{AabbBounds{vec3{0.0}, vec3{-1.0}}};
@@ -115,6 +128,41 @@ TEST(Aabb, can_return_all_corners) {
                     Ne(std::cend(all_corners)));
 }
 
+TEST(Aabb, may_be_hit_by_a_packet_if_any_of_its_rays_hits) {
+    Aabb const aabb{AabbBounds{vec3{-1.0}, vec3{1.0}}};
+    // rays from the corners of a unit square at z = 5, aimed at the box and beside it
+    for (double const offset : {0.0, 1.5, 2.5}) {
+        PacketBounds packet{};
+        packet.coherent = true;
+        packet.origin_min = point3{offset, offset, 5.0};
+        packet.origin_max = point3{offset + 1.0, offset + 1.0, 5.0};
+        packet.inverse_direction_min = packet.inverse_direction_max = vec3{1e300, 1e300, -1.0};
+        bool any_hit = false;
+        for (double const x : {offset, offset + 1.0})
+            for (double const y : {offset, offset + 1.0})
+                any_hit = any_hit || aabb.hit(Ray{point3{x, y, 5.0}, vec3{1e-300, 1e-300, -1.0}}, TimeInterval{0.0, infinity});
+        EXPECT_THAT(aabb.may_hit(packet, TimeInterval{0.0, infinity}), Eq(any_hit));
+    }
+}
+
+TEST(Aabb, is_not_hit_by_a_packet_that_ends_before_it) {
+    Aabb const aabb{AabbBounds{vec3{-1.0}, vec3{1.0}}};
+    PacketBounds packet{};
+    packet.coherent = true;
+    packet.origin_min = packet.origin_max = point3{0.0, 0.0, 5.0};
+    packet.inverse_direction_min = vec3{10.0, 10.0, -1.0};
+    packet.inverse_direction_max = vec3{20.0, 20.0, -1.0};
+    EXPECT_TRUE(aabb.may_hit(packet, TimeInterval{0.0, infinity}));
+    EXPECT_FALSE(aabb.may_hit(packet, TimeInterval{0.0, 3.0}));
+}
+
+TEST(Aabb, may_be_hit_by_any_incoherent_packet) {
+    Aabb const aabb{AabbBounds{vec3{-1.0}, vec3{1.0}}};
+    PacketBounds packet{};
+    packet.origin_min = packet.origin_max = point3{10.0};
+    packet.inverse_direction_min = packet.inverse_direction_max = vec3{1.0};
+    EXPECT_TRUE(aabb.may_hit(packet, TimeInterval{0.0, infinity}));
+}
 
 int main(int argc, char **argv)
 {
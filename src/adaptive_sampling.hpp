@@ -0,0 +1,95 @@
+#pragma once
+
+#include <color.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+// Running mean of the samples of a pixel, and the variance of their
+// luminance (Welford's algorithm).
+class PixelEstimate {
+public:
+    void add(color const & sample) {
+        ++count_;
+        sum_ += sample;
+        auto const l = luminance(sample);
+        auto const delta = l - mean_luminance_;
+        mean_luminance_ += delta / count_;
+        m2_ += delta * (l - mean_luminance_);
+    }
+
+    int count() const { return count_; }
+
+    color mean() const { return count_ > 0 ? sum_ / count_ : color{0.0, 0.0, 0.0}; }
+
+    // sample variance of the luminance
+    double variance() const { return count_ > 1 ? m2_ / (count_ - 1) : 0.0; }
+
+    // Standard error of the mean luminance after gamma 2 correction, as in the
+    // written image. Dark pixels tolerate less absolute noise than bright ones
+    // this way; `floor` keeps black pixels from needing zero variance.
+    double display_error(double const floor) const {
+        if (count_ == 0)
+            return infinity;
+        return std::sqrt(variance() / count_) / (2.0 * std::sqrt(std::max(mean_luminance_, 0.0) + floor));
+    }
+
+private:
+    int count_{0};
+    color sum_{0.0, 0.0, 0.0};
+    double mean_luminance_{0.0};
+    double m2_{0.0};
+};
+
+struct AdaptiveSamplingSettings {
+    int min_samples{16};            // before a pixel may be considered converged
+    int max_samples{256};
+    double target_display_error{0.02};
+    double luminance_floor{0.01};   // see PixelEstimate::display_error
+};
+
+// Distributes a budget of samples over the pixels of a row. Every pixel
+// gets `min_samples`, then sampling continues only on the pixels whose
+// display error is still above the target, so that the budget left by
+// converged pixels goes to noisy ones. The caller takes one sample of every
+// active pixel per pass until `done`.
+class AdaptiveSampler {
+public:
+    explicit AdaptiveSampler(AdaptiveSamplingSettings const & settings) : settings_{settings} {}
+
+    void reset(std::size_t const pixels, long const budget) {
+        estimates_.assign(pixels, PixelEstimate{});
+        budget_ = budget;
+    }
+
+    bool active(std::size_t const pixel) const {
+        auto const & estimate = estimates_[pixel];
+        if (budget_ <= 0 || estimate.count() >= settings_.max_samples)
+            return false;
+        return estimate.count() < settings_.min_samples
+            || estimate.display_error(settings_.luminance_floor) >= settings_.target_display_error;
+    }
+
+    bool done() const {
+        for (std::size_t ii = 0; ii < estimates_.size(); ++ii)
+            if (active(ii))
+                return false;
+        return true;
+    }
+
+    void add(std::size_t const pixel, color const & sample) {
+        estimates_[pixel].add(sample);
+        --budget_;
+    }
+
+    PixelEstimate const & estimate(std::size_t const pixel) const { return estimates_[pixel]; }
+
+    long budget() const { return budget_; }
+
+private:
+    AdaptiveSamplingSettings settings_;
+    std::vector<PixelEstimate> estimates_;
+    long budget_{0};
+};
@@ -0,0 +1,100 @@
+#include <adaptive_sampling.hpp>
+
+#include <common.hpp>
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+
+using testing::DoubleEq;
+using testing::DoubleNear;
+using testing::Eq;
+using testing::Test;
+
+
+TEST(PixelEstimate, averages_its_samples) {
+    PixelEstimate estimate;
+    estimate.add(color{1.0, 0.0, 0.5});
+    estimate.add(color{0.0, 1.0, 0.5});
+    EXPECT_THAT(estimate.count(), Eq(2));
+    EXPECT_THAT(estimate.mean(), Eq(color{0.5, 0.5, 0.5}));
+}
+
+TEST(PixelEstimate, has_the_sample_variance_of_the_luminance) {
+    PixelEstimate estimate;
+    for (double const l : {1.0, 2.0, 3.0, 4.0})
+        estimate.add(color{l});
+    EXPECT_THAT(estimate.variance(), DoubleNear(5.0 / 3.0, 1e-12));
+}
+
+TEST(PixelEstimate, has_no_error_for_constant_samples) {
+    PixelEstimate estimate;
+    for (int ii = 0; ii < 4; ++ii)
+        estimate.add(color{0.3});
+    EXPECT_THAT(estimate.display_error(0.0), DoubleEq(0.0));
+}
+
+TEST(PixelEstimate, has_an_error_that_falls_with_the_samples) {
+    PixelEstimate estimate;
+    for (int ii = 0; ii < 16; ++ii)
+        estimate.add(color{random_double()});
+    auto const error = estimate.display_error(0.0);
+    for (int ii = 0; ii < 48; ++ii)
+        estimate.add(color{random_double()});
+    EXPECT_THAT(estimate.display_error(0.0), DoubleNear(0.5 * error, 0.2 * error));
+}
+
+struct AnAdaptiveSampler : Test {
+public:
+    AnAdaptiveSampler() { sampler.reset(2, 200); }
+
+    // one pass over the active pixels, with a constant pixel 0 and a noisy pixel 1
+    void pass() {
+        if (sampler.active(0))
+            sampler.add(0, color{0.5});
+        if (sampler.active(1))
+            sampler.add(1, color{random_double() < 0.5 ? 0.0 : 1.0});
+    }
+
+    AdaptiveSampler sampler{AdaptiveSamplingSettings{4, 150, 0.01, 0.01}};
+};
+
+TEST_F(AnAdaptiveSampler, takes_the_minimum_number_of_samples_of_every_pixel) {
+    for (int ii = 0; ii < 4; ++ii) {
+        EXPECT_TRUE(sampler.active(0));
+        pass();
+    }
+    EXPECT_FALSE(sampler.active(0));
+}
+
+TEST_F(AnAdaptiveSampler, spends_the_budget_on_noisy_pixels) {
+    while (!sampler.done())
+        pass();
+    EXPECT_THAT(sampler.estimate(0).count(), Eq(4));
+    EXPECT_THAT(sampler.estimate(1).count(), Eq(150));
+    EXPECT_THAT(sampler.budget(), Eq(200 - 154));
+}
+
+TEST_F(AnAdaptiveSampler, stops_when_the_budget_is_spent) {
+    sampler.reset(2, 10);
+    while (!sampler.done())
+        pass();
+    EXPECT_THAT(sampler.estimate(0).count() + sampler.estimate(1).count(), Eq(10));
+}
+
+TEST_F(AnAdaptiveSampler, samples_every_pixel_equally_without_a_target) {
+    AdaptiveSampler uniform{AdaptiveSamplingSettings{1, 100, 0.0, 0.01}};
+    uniform.reset(3, 30);
+    while (!uniform.done())
+        for (std::size_t ii = 0; ii < 3; ++ii)
+            if (uniform.active(ii))
+                uniform.add(ii, color{0.5});
+    for (std::size_t ii = 0; ii < 3; ++ii)
+        EXPECT_THAT(uniform.estimate(ii).count(), Eq(10));
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
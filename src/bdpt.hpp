@@ -0,0 +1,372 @@
+#pragma once
+
+#include <camera.hpp>
+#include <color.hpp>
+#include <common.hpp>
+#include <hit.hpp>
+#include <integrator.hpp>
+#include <material.hpp>
+#include <ray.hpp>
+#include <scenes.hpp>
+#include <vec3.hpp>
+
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <vector>
+
+// Sums of the light tracing contributions to the pixels of an image, which
+// threads add to concurrently. Pixel (i, j) covers the film coordinates
+// [i, i + 1) / (width - 1) x [j, j + 1) / (height - 1) of Camera::get_ray,
+// j counting from the bottom.
+class SplatFilm {
+public:
+    SplatFilm(std::size_t width, std::size_t height)
+        : width_{width}, height_{height}, sums_{std::make_unique<std::atomic<double>[]>(3 * width * height)} {}
+
+    std::size_t width() const { return width_; }
+    std::size_t height() const { return height_; }
+
+    // drops values outside the image
+    void add(double const h, double const v, color const & value) {
+        auto const x = std::floor(h * (width_ - 1)), y = std::floor(v * (height_ - 1));
+        if (!(x >= 0.0 && x < width_ && y >= 0.0 && y < height_))
+            return;
+        auto const pixel = static_cast<std::size_t>(y) * width_ + static_cast<std::size_t>(x);
+        for (int c = 0; c < 3; ++c)
+            atomic_add(sums_[3 * pixel + c], value[c]);
+    }
+
+    color pixel(std::size_t const i, std::size_t const j) const {
+        auto const pixel = j * width_ + i;
+        return color{sums_[3 * pixel].load(std::memory_order_relaxed),
+                     sums_[3 * pixel + 1].load(std::memory_order_relaxed),
+                     sums_[3 * pixel + 2].load(std::memory_order_relaxed)};
+    }
+
+private:
+    std::size_t width_, height_;
+    std::unique_ptr<std::atomic<double>[]> sums_;
+};
+
+// A vertex of a camera or light subpath. The first vertex of a camera
+// subpath is the origin of the camera ray, the first of a light subpath the
+// point sampled on the lights.
+struct BdptVertex {
+    HitRecord rec;
+    color beta{1.0, 1.0, 1.0};       // throughput of the subpath up to the vertex
+    color emitted{0.0, 0.0, 0.0};    // towards the previous vertex
+    double pdf_fwd{0.0};             // area density of sampling the vertex from the previous one
+    double pdf_rev{0.0};             // of sampling it from the next one, in the opposite direction
+    bool delta{false};               // scattered specularly
+};
+
+namespace ns_bdpt {
+    // per unit area at `to` of the solid angle density `pdf` at `from`;
+    // vertices in media have no cosine
+    inline double to_area(double const pdf, point3 const & from, BdptVertex const & to) {
+        vec3 const d = to.rec.p - from;
+        auto const distance_squared = d.length_squared();
+        if (distance_squared <= 0.0)
+            return 0.0;
+        auto const cos_theta = to.rec.side == FaceSide::medium ? 1.0 : std::abs(dot(to.rec.normal, d)) / std::sqrt(distance_squared);
+        return pdf * cos_theta / distance_squared;
+    }
+
+    // emitters shine to both sides, cosine weighted, like the photons
+    inline double emission_pdf(HitRecord const & light, vec3 const & direction) {
+        return 0.5 * std::abs(dot(light.normal, unit_vector(direction))) / pi;
+    }
+
+    inline double remap_zero(double const pdf) { return pdf != 0.0 ? pdf : 1.0; }
+
+    // true if nothing in `world` blocks the segment between `a` and `b`
+    inline bool unoccluded(HittableI const & world, point3 const & a, point3 const & b, double const time) {
+        vec3 const d = b - a;
+        auto const distance = d.length();
+        return !world.hit(Ray{a, d / distance, time}, 1e-3, distance - 1e-3);
+    }
+}
+
+// Bidirectional path tracing: every camera ray is followed by a camera
+// subpath, and a light subpath starts on `scene.lights` at the time of the
+// ray. Each prefix of one is connected to each prefix of the other, and the
+// contributions are weighted with the balance heuristic over all the
+// strategies that could have sampled the same path. Connections of light
+// subpaths to a pinhole camera are splatted into `film`, assuming one light
+// subpath per sample of every pixel.
+//
+// Paths have at most `max_depth` scattering events like in `ray_color`.
+// Emitters that are not in `scene.lights` and the background are only found
+// by the camera subpaths; `scene.media`, `scene.environment` and
+// `scene.caustics` are not treated specially. No footprints are tracked, so
+// textures are point sampled and noise uses all its octaves, regardless of
+// `scene.pixel_spread`.
+class BidirectionalIntegrator {
+public:
+    BidirectionalIntegrator(HittableI const & world, Scene const & scene, int const max_depth, SplatFilm & film)
+        : world_{world}
+        , scene_{scene}
+        , max_vertices_{static_cast<std::size_t>(max_depth) + 1}
+        , film_{film}
+        // the extent of the pixels in film coordinates
+        , film_area_{static_cast<double>(film.width() * film.height()) / ((film.width() - 1) * (film.height() - 1))} {}
+
+    // radiance along the camera ray `ray`
+    color sample(Ray const & ray);
+
+private:
+    // Appends the vertices found along `ray` from the last vertex of
+    // `path`, whose scattering pdf for `ray` is `pdf`, until `path` holds
+    // `max_vertices`. Returns the light of the background if the subpath
+    // escapes.
+    color extend(std::vector<BdptVertex> & path, Ray ray, color beta, double pdf, std::size_t max_vertices) const;
+
+    void trace_light_path();
+
+    // solid angle density of the camera rays, and their importance, towards
+    // `cos_theta` from the viewing direction
+    double camera_pdf(double const cos_theta) const {
+        return 1.0 / (film_area_ * scene_.camera.viewport_area() * cos_theta * cos_theta * cos_theta);
+    }
+
+    // weighted contribution of the first `s` light and `t` camera vertices
+    color connect(std::size_t s, std::size_t t);
+
+    // for s == 1 the light vertex is `sampled`
+    double mis_weight(std::size_t s, std::size_t t, BdptVertex * sampled);
+
+    HittableI const & world_;
+    Scene const & scene_;
+    std::size_t max_vertices_;
+    SplatFilm & film_;
+    double film_area_;
+    double time_{0.0};
+    std::vector<BdptVertex> camera_path_;
+    std::vector<BdptVertex> light_path_;
+};
+
+inline color BidirectionalIntegrator::sample(Ray const & ray) {
+    time_ = ray.time();
+    camera_path_.clear();
+    BdptVertex camera{HitRecord::miss()};
+    camera.rec.p = ray.o;
+    camera_path_.push_back(camera);
+    auto const film_point = scene_.camera.is_pinhole() ? scene_.camera.film_point(ray.o + ray.d) : std::nullopt;
+    // the density of lens cameras matters only for light tracing, which they do not support
+    auto const pdf = film_point ? camera_pdf(film_point->cos_theta) : 0.0;
+    color result = extend(camera_path_, ray, color{1.0, 1.0, 1.0}, pdf, max_vertices_);
+
+    trace_light_path();
+    for (std::size_t t = 1; t <= camera_path_.size(); ++t)
+        for (std::size_t s = 0; s + t <= max_vertices_ && s <= std::max<std::size_t>(light_path_.size(), 1); ++s)
+            result += connect(s, t);
+    return result;
+}
+
+inline color BidirectionalIntegrator::extend(std::vector<BdptVertex> & path,
+                                             Ray ray,
+                                             color beta,
+                                             double pdf,
+                                             std::size_t const max_vertices) const {
+    while (path.size() < max_vertices) {
+        auto const rec = world_.hit(ray, 1e-3, infinity);
+        if (!rec)
+            return beta * scene_.background_color(ray);
+
+        BdptVertex vertex{rec, beta};
+        vertex.pdf_fwd = ns_bdpt::to_area(pdf, path.back().rec.p, vertex);
+        auto const scatter_info = rec.material_ptr->scatter(ray, rec);
+        vertex.emitted = scatter_info.emitted;
+        path.push_back(vertex);
+        if (!scatter_info)
+            break;
+
+        auto & current = path.back();
+        auto & previous = path[path.size() - 2];
+        vec3 const wo = -unit_vector(ray.d);
+        vec3 const wi = unit_vector(scatter_info.scattered_ray.d);
+        current.delta = rec.material_ptr->is_specular();
+        double pdf_rev = 0.0;
+        pdf = 0.0;
+        if (!current.delta) {
+            pdf = rec.material_ptr->pdf(rec, wi, wo);
+            pdf_rev = rec.material_ptr->pdf(rec, wo, wi);
+            if (pdf <= 0.0)
+                break;
+        }
+        previous.pdf_rev = ns_bdpt::to_area(pdf_rev, rec.p, previous);
+
+        beta = beta * scatter_info.attenuation;
+        if (!ns_integrator::survives_roulette(static_cast<int>(path.size()) - 2, beta))
+            break;
+        ray = scatter_info.scattered_ray;
+    }
+    return color{0.0, 0.0, 0.0};
+}
+
+inline void BidirectionalIntegrator::trace_light_path() {
+    light_path_.clear();
+    auto const light = scene_.lights.sample_surface();
+    if (light.pdf <= 0.0)
+        return;
+
+    auto const normal = random_double() < 0.5 ? light.record.normal : -light.record.normal;
+    auto direction = normal + random_unit_vector();
+    if (direction.near_zero())
+        direction = normal;
+    Ray const ray{light.record.p, unit_vector(direction), time_};
+    auto const emitted = light.record.material_ptr->scatter(Ray{light.record.p + ray.d, -ray.d}, light.record).emitted;
+
+    BdptVertex origin{light.record};
+    origin.pdf_fwd = light.pdf;
+    light_path_.push_back(origin);
+    // the cosine cancels against the emission pdf
+    extend(light_path_, ray, 2.0 * pi / light.pdf * emitted, ns_bdpt::emission_pdf(light.record, ray.d), max_vertices_ - 1);
+}
+
+inline color BidirectionalIntegrator::connect(std::size_t const s, std::size_t const t) {
+    color const black{0.0, 0.0, 0.0};
+    if (s == 0) {
+        // the camera subpath hit an emitter
+        auto const & z = camera_path_[t - 1];
+        if (t < 2 || z.emitted == black)
+            return black;
+        return mis_weight(0, t, nullptr) * z.beta * z.emitted;
+    }
+
+    if (t == 1) {
+        // light tracing
+        if (s < 2 || !scene_.camera.is_pinhole())
+            return black;
+        auto const & y = light_path_[s - 1];
+        if (y.delta)
+            return black;
+        auto const film_point = scene_.camera.film_point(y.rec.p);
+        if (!film_point)
+            return black;
+        vec3 const to_camera = scene_.camera.origin() - y.rec.p;
+        auto const f = y.rec.material_ptr->eval(y.rec, to_camera, light_path_[s - 2].rec.p - y.rec.p);
+        if (f == black || !ns_bdpt::unoccluded(world_, y.rec.p, scene_.camera.origin(), time_))
+            return black;
+        auto const contribution = camera_pdf(film_point->cos_theta) / to_camera.length_squared() * y.beta * f;
+        film_.add(film_point->h, film_point->v, mis_weight(s, 1, nullptr) * contribution);
+        return black;
+    }
+
+    auto const & z = camera_path_[t - 1];
+    if (z.delta)
+        return black;
+    vec3 const to_camera = camera_path_[t - 2].rec.p - z.rec.p;
+
+    if (s == 1) {
+        // a new point on the lights, like the light samples of `ray_color`
+        auto const light = scene_.lights.sample_surface();
+        if (light.pdf <= 0.0)
+            return black;
+        BdptVertex y{light.record};
+        y.pdf_fwd = light.pdf;
+        vec3 const to_light = y.rec.p - z.rec.p;
+        auto const f = z.rec.material_ptr->eval(z.rec, to_light, to_camera);
+        auto const cos_light = std::abs(dot(y.rec.normal, to_light)) / to_light.length();
+        if (f == black || cos_light <= 0.0 || !ns_bdpt::unoccluded(world_, z.rec.p, y.rec.p, time_))
+            return black;
+        auto const emitted = y.rec.material_ptr->scatter(Ray{z.rec.p, to_light, time_}, y.rec).emitted;
+        auto const contribution = cos_light / (to_light.length_squared() * y.pdf_fwd) * z.beta * f * emitted;
+        return mis_weight(1, t, &y) * contribution;
+    }
+
+    if (s > light_path_.size())
+        return black;
+    auto const & y = light_path_[s - 1];
+    if (y.delta)
+        return black;
+    vec3 const to_light = y.rec.p - z.rec.p;
+    auto const f_camera = z.rec.material_ptr->eval(z.rec, to_light, to_camera);
+    if (f_camera == black)
+        return black;
+    auto const f_light = y.rec.material_ptr->eval(y.rec, -to_light, light_path_[s - 2].rec.p - y.rec.p);
+    if (f_light == black || !ns_bdpt::unoccluded(world_, z.rec.p, y.rec.p, time_))
+        return black;
+    auto const contribution = 1.0 / to_light.length_squared() * z.beta * f_camera * f_light * y.beta;
+    return mis_weight(s, t, nullptr) * contribution;
+}
+
+inline double BidirectionalIntegrator::mis_weight(std::size_t const s, std::size_t const t, BdptVertex * const sampled) {
+    auto const n = s + t;
+    auto camera = [this](std::size_t const ii) -> BdptVertex & { return camera_path_[ii]; };
+    auto light = [this, s, sampled](std::size_t const ii) -> BdptVertex & {
+        return s == 1 && ii == 0 ? *sampled : light_path_[ii];
+    };
+    auto const & lights = scene_.lights;
+
+    // only the camera subpaths find emitters outside of `scene.lights`
+    if (s == 0 && !lights.contains(camera(t - 1).rec.object))
+        return 1.0;
+
+    // the reverse densities at the ends of both subpaths, which depend on the
+    // connection, restored before returning
+    BdptVertex * z = &camera(t - 1);
+    BdptVertex * z_previous = t > 1 ? &camera(t - 2) : nullptr;
+    BdptVertex * y = s > 0 ? &light(s - 1) : nullptr;
+    BdptVertex * y_previous = s > 1 ? &light(s - 2) : nullptr;
+    double const saved[4] = {z->pdf_rev,
+                             z_previous ? z_previous->pdf_rev : 0.0,
+                             y ? y->pdf_rev : 0.0,
+                             y_previous ? y_previous->pdf_rev : 0.0};
+
+    auto const scattering_pdf = [](BdptVertex const & at, BdptVertex const & from, BdptVertex const & to) {
+        return at.rec.material_ptr->pdf(at.rec, unit_vector(to.rec.p - at.rec.p), unit_vector(from.rec.p - at.rec.p));
+    };
+    if (s == 0)
+        z->pdf_rev = lights.surface_pdf(z->rec);
+    else if (s == 1 && t > 1)
+        z->pdf_rev = ns_bdpt::to_area(ns_bdpt::emission_pdf(y->rec, z->rec.p - y->rec.p), y->rec.p, *z);
+    else if (t > 1)
+        z->pdf_rev = ns_bdpt::to_area(scattering_pdf(*y, *y_previous, *z), y->rec.p, *z);
+
+    if (z_previous)
+        z_previous->pdf_rev = s == 0
+            ? ns_bdpt::to_area(ns_bdpt::emission_pdf(z->rec, z_previous->rec.p - z->rec.p), z->rec.p, *z_previous)
+            : ns_bdpt::to_area(scattering_pdf(*z, *y, *z_previous), z->rec.p, *z_previous);
+
+    if (y) {
+        if (t == 1) {
+            auto const film_point = scene_.camera.film_point(y->rec.p);
+            y->pdf_rev = film_point ? ns_bdpt::to_area(camera_pdf(film_point->cos_theta), z->rec.p, *y) : 0.0;
+        } else
+            y->pdf_rev = ns_bdpt::to_area(scattering_pdf(*z, *z_previous, *y), z->rec.p, *y);
+    }
+
+    if (y_previous)
+        y_previous->pdf_rev = ns_bdpt::to_area(scattering_pdf(*y, *z, *y_previous), y->rec.p, *y_previous);
+
+    // ratios of the densities of the other strategies to this one, moving
+    // the connection towards the camera and then towards the light
+    double sum = 0.0;
+    double ratio = 1.0;
+    for (auto ii = t - 1; ii > 0; --ii) {
+        ratio *= ns_bdpt::remap_zero(camera(ii).pdf_rev) / ns_bdpt::remap_zero(camera(ii).pdf_fwd);
+        // with one camera vertex, light tracing from at least two light vertices
+        bool const available = ii > 1 || (scene_.camera.is_pinhole() && n >= 3);
+        if (available && !camera(ii).delta && !camera(ii - 1).delta)
+            sum += ratio;
+    }
+    ratio = 1.0;
+    for (auto ii = s; ii-- > 0;) {
+        ratio *= ns_bdpt::remap_zero(light(ii).pdf_rev) / ns_bdpt::remap_zero(light(ii).pdf_fwd);
+        if (!light(ii).delta && (ii == 0 || !light(ii - 1).delta))
+            sum += ratio;
+    }
+
+    z->pdf_rev = saved[0];
+    if (z_previous)
+        z_previous->pdf_rev = saved[1];
+    if (y)
+        y->pdf_rev = saved[2];
+    if (y_previous)
+        y_previous->pdf_rev = saved[3];
+    return 1.0 / (1.0 + sum);
+}
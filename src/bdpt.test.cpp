@@ -0,0 +1,101 @@
+#include <bdpt.hpp>
+
+#include <hittable_list.hpp>
+#include <material.hpp>
+#include <quad.hpp>
+#include <sphere.hpp>
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <memory>
+#include <vector>
+
+
+using testing::DoubleNear;
+using testing::Eq;
+using testing::Test;
+
+
+TEST(ASplatFilm, adds_to_the_pixel_of_the_film_coordinates) {
+    SplatFilm film{3, 2};
+    film.add(0.75, 0.5, color{1.0, 2.0, 3.0});
+    film.add(0.6, 0.9, color{1.0, 0.0, 0.0});
+    EXPECT_THAT(film.pixel(1, 0), Eq(color{2.0, 2.0, 3.0}));
+    EXPECT_THAT(film.pixel(0, 0), Eq(color{0.0, 0.0, 0.0}));
+}
+
+TEST(ASplatFilm, drops_values_outside_of_the_image) {
+    SplatFilm film{3, 2};
+    film.add(-0.1, 0.5, color{1.0});
+    film.add(0.5, 2.0, color{1.0});
+    for (std::size_t j = 0; j < 2; ++j)
+        for (std::size_t i = 0; i < 3; ++i)
+            EXPECT_THAT(film.pixel(i, j), Eq(color{0.0}));
+}
+
+
+// a pinhole camera above a diffuse floor with a sphere on it, lit by a
+// quad light between them
+struct ARoomSeenByABidirectionalIntegrator : Test {
+    ARoomSeenByABidirectionalIntegrator() {
+        world.add(std::make_shared<Quad>(point3{-50.0, 0.0, -50.0}, vec3{0.0, 0.0, 100.0}, vec3{100.0, 0.0, 0.0},
+                                         std::make_shared<lambertian>(color{0.5})));
+        world.add(std::make_shared<Sphere>(point3{0.5, 0.5, 0.0}, 0.5, std::make_shared<lambertian>(color{0.8})));
+        lights.add(std::make_shared<Quad>(point3{-1.0, 1.5, -0.5}, vec3{1.0, 0.0, 0.0}, vec3{0.0, 0.0, 1.0},
+                                          std::make_shared<DiffuseLight>(color{4.0})));
+        world.add(lights.objects.front());
+    }
+
+    Scene scene() const {
+        return Scene{world,
+                     [](Ray const &) { return color{0.0}; },
+                     Camera{point3{0.0, 3.0, 0.5}, point3{0.0, 0.0, 0.0}, vec3{0.0, 1.0, 0.0}, FieldOfView{60.0}, AspectRatio{1.0}},
+                     lights,
+                     {}};
+    }
+
+    HittableList world;
+    HittableList lights;
+    std::size_t const width = 3;
+    std::size_t const height = 3;
+    int const max_depth = 4;
+};
+
+TEST_F(ARoomSeenByABidirectionalIntegrator, matches_the_path_tracer) {
+    auto const scene = this->scene();
+    SplatFilm film{width, height};
+    BidirectionalIntegrator integrator{scene.world, scene, max_depth, film};
+    std::vector<color> bidirectional(width * height), path(width * height);
+    int const n = 20000;
+    for (std::size_t j = 0; j < height; ++j)
+        for (std::size_t i = 0; i < width; ++i)
+            for (int ii = 0; ii < n; ++ii) {
+                auto const ray = scene.camera.get_ray((i + random_double()) / (width - 1), (j + random_double()) / (height - 1));
+                bidirectional[j * width + i] += integrator.sample(ray) / n;
+                path[j * width + i] += ray_color(ray, scene.world, scene, max_depth) / n;
+            }
+
+    for (std::size_t j = 0; j < height; ++j)
+        for (std::size_t i = 0; i < width; ++i) {
+            auto const expected = path[j * width + i].x;
+            EXPECT_THAT(bidirectional[j * width + i].x + film.pixel(i, j).x / n, DoubleNear(expected, 0.03 * expected))
+                << "pixel " << i << ", " << j;
+        }
+}
+
+TEST_F(ARoomSeenByABidirectionalIntegrator, finds_unlisted_emitters_with_the_camera_subpaths) {
+    lights.objects.clear();
+    auto const scene = this->scene();
+    SplatFilm film{width, height};
+    BidirectionalIntegrator integrator{scene.world, scene, max_depth, film};
+    // straight up from the floor into the emitter
+    Ray const ray{point3{-0.5, 0.1, 0.0}, vec3{0.0, 1.0, 0.0}};
+    EXPECT_THAT(integrator.sample(ray), Eq(color{4.0}));
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -16,10 +16,14 @@ public:
     // HittableI
     Aabb bounding_box(TimeInterval times) const override;
     HitRecord hit(Ray const & r, double t_min, double t_max) const override;
+    double transmittance(Ray const & r, double t_min, double t_max) const override;
+    void hit_packet(RayPacket & packet) const override;
 
     std::shared_ptr<HittableI> left;
     std::shared_ptr<HittableI> right;
     Aabb aabb{AabbBounds{vec3{0.0}, vec3{-1.0}}};
+    vec3 left_to_right{0.0};  // between the centers of the children's boxes, orders packet traversals
+    bool has_leaves{true};    // neither child is a BvhNode, e.g. of a nested BVH
 };
 
 // compare HittableI's bounding_boxes minimum corners along a given axis
@@ -55,6 +59,8 @@ inline BvhNode::BvhNode(std::vector<std::shared_ptr<HittableI>> hittables,
     else if (hittables.size() <= 2) {
         left = hittables.front();
         right = hittables.back();
+        // packets keep traversing nested BVHs
+        has_leaves = !std::dynamic_pointer_cast<BvhNode>(left) && !std::dynamic_pointer_cast<BvhNode>(right);
     }
     else {
         auto const axis = random_int(0, 2);
@@ -65,10 +71,14 @@ inline BvhNode::BvhNode(std::vector<std::shared_ptr<HittableI>> hittables,
         auto const middle = std::cbegin(hittables) + hittables.size() / 2;
         left = std::make_shared<BvhNode>(std::vector(std::cbegin(hittables), middle), times);
         right = std::make_shared<BvhNode>(std::vector(middle, std::cend(hittables)), times);
+        has_leaves = false;
     }
 
     // assume that every HittableI will return a valid bounding box
-    aabb = surrounding_box(left->bounding_box(times), right->bounding_box(times));
+    auto const left_box = left->bounding_box(times);
+    auto const right_box = right->bounding_box(times);
+    aabb = surrounding_box(left_box, right_box);
+    left_to_right = 0.5 * (right_box.min() + right_box.max() - left_box.min() - left_box.max());
 }
 
 std::ostream & operator<<(std::ostream & out, Aabb const & aabb) {
@@ -83,3 +93,27 @@ HitRecord BvhNode::hit(Ray const & ray, double t_min, double t_max) const {
     auto const hit_right = right->hit(ray, t_min, hit_left ? hit_left.t : t_max);
     return hit_right ? hit_right : hit_left;
 }
+
+inline double BvhNode::transmittance(Ray const & ray, double const t_min, double const t_max) const {
+    if (!left || !aabb.hit(ray, TimeInterval(t_min, t_max)))
+        return 1.0;
+
+    auto const left_transmittance = left->transmittance(ray, t_min, t_max);
+    if (left_transmittance <= 0.0 || right == left)  // a single object is both children
+        return left_transmittance;
+    return left_transmittance * right->transmittance(ray, t_min, t_max);
+}
+
+inline void BvhNode::hit_packet(RayPacket & packet) const {
+    if (!left || !aabb.may_hit(packet.bounds, TimeInterval(packet.t_min, packet.t_max_bound)))
+        return;
+    // Without a common direction octant the packet bounds cull nothing. Above
+    // the leaves, the box test of each ray is cheaper than the leaf hits it avoids.
+    if (!packet.bounds.coherent || has_leaves)
+        return HittableI::hit_packet(packet);
+
+    // visit the child closer to the packet first, so that its hits cull the other one
+    bool const left_first = dot(left_to_right, packet.rays.front().d) >= 0.0;
+    (left_first ? left : right)->hit_packet(packet);
+    (left_first ? right : left)->hit_packet(packet);
+}
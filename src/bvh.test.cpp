@@ -82,6 +82,80 @@ TEST_F(ManyBvhNodes, can_be_hit4) {
     EXPECT_TRUE(bvh.hit(ray4, 0.0, infinity));
 }
 
+struct ASceneOfSpheres : Test {
+public:
+    ASceneOfSpheres() {
+        for (int ii = 0; ii < 200; ++ii)
+            spheres.add(std::make_shared<Sphere>(point3{random_double(-5.0, 5.0), random_double(-5.0, 5.0), random_double(-20.0, -5.0)},
+                                                 random_double(0.1, 0.5)));
+    }
+
+    // the rays of `packet` hit `bvh` as they do one by one
+    void expect_single_ray_hits(RayPacket & packet) const {
+        packet.prepare();
+        bvh.hit_packet(packet);
+        for (std::size_t ii = 0; ii < packet.rays.size(); ++ii) {
+            auto const expected = bvh.hit(packet.rays[ii], packet.t_min, infinity);
+            ASSERT_THAT(static_cast<bool>(packet.hits[ii]), Eq(static_cast<bool>(expected)));
+            if (expected) {
+                EXPECT_THAT(packet.hits[ii].t, Eq(expected.t));
+                EXPECT_THAT(packet.hits[ii].object, Eq(expected.object));
+            }
+        }
+    }
+
+    HittableList spheres;
+    BvhNode const bvh{spheres, TimeInterval{}};
+};
+
+TEST_F(ASceneOfSpheres, is_hit_by_a_coherent_packet_as_by_single_rays) {
+    RayPacket packet;
+    for (int ii = 0; ii < 8; ++ii)
+        for (int jj = 0; jj < 8; ++jj)
+            packet.add(Ray{point3{0.0}, vec3{-0.3 + 0.01 * ii, -0.2 + 0.01 * jj, -1.0}});
+    expect_single_ray_hits(packet);
+    EXPECT_TRUE(packet.bounds.coherent);
+}
+
+TEST_F(ASceneOfSpheres, is_hit_by_a_packet_with_spread_origins_as_by_single_rays) {
+    RayPacket packet;
+    for (int ii = 0; ii < 64; ++ii)
+        packet.add(Ray{point3{random_double(-1.0, 1.0), random_double(-1.0, 1.0), 0.0},
+                       vec3{random_double(0.01, 0.3), random_double(0.01, 0.3), -1.0}});
+    expect_single_ray_hits(packet);
+    EXPECT_TRUE(packet.bounds.coherent);
+}
+
+TEST_F(ASceneOfSpheres, is_hit_by_a_packet_through_a_nested_bvh_as_by_single_rays) {
+    BvhNode const outer{std::vector<std::shared_ptr<HittableI>>{
+                            std::make_shared<BvhNode>(bvh),
+                            std::make_shared<Sphere>(point3{0.0, 0.0, -30.0}, 1.0)},
+                        TimeInterval{}};
+    EXPECT_FALSE(outer.has_leaves);
+
+    RayPacket packet;
+    for (int ii = 0; ii < 8; ++ii)
+        for (int jj = 0; jj < 8; ++jj)
+            packet.add(Ray{point3{0.0}, vec3{-0.3 + 0.01 * ii, -0.2 + 0.01 * jj, -1.0}});
+    packet.prepare();
+    outer.hit_packet(packet);
+    for (std::size_t ii = 0; ii < packet.rays.size(); ++ii) {
+        auto const expected = outer.hit(packet.rays[ii], packet.t_min, infinity);
+        ASSERT_THAT(static_cast<bool>(packet.hits[ii]), Eq(static_cast<bool>(expected)));
+        if (expected) {
+            EXPECT_THAT(packet.hits[ii].object, Eq(expected.object));
+        }
+    }
+}
+
+TEST_F(ASceneOfSpheres, is_hit_by_an_incoherent_packet_as_by_single_rays) {
+    RayPacket packet;
+    for (int ii = 0; ii < 64; ++ii)
+        packet.add(Ray{point3{0.0}, random_unit_vector() + vec3{0.0, 0.0, -1.0}});
+    expect_single_ray_hits(packet);
+    EXPECT_FALSE(packet.bounds.coherent);
+}
+
 int main(int argc, char **argv)
 {
     ::testing::InitGoogleTest(&argc, argv);
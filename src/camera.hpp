@@ -4,6 +4,9 @@
 #include <vec3.hpp>
 
 #include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
 
 #include <iostream>
 
@@ -26,6 +29,7 @@ public:
         double const time1 = 1.0
     )
         : origin_{lookfrom}
+        , focus_distance_{focus_dist.value()}
         , lens_radius_{aperture.value() / 2.0}
         , time0_{time0}
         , time1_{time1}
@@ -45,6 +49,9 @@ public:
         lower_left_corner_ = origin_ - 0.5*horizontal_ - 0.5*vertical_ - focus_dist.value() * w_;
     }
 
+    // calls of random_2d and random_double per get_ray, for the lens and the time
+    static constexpr std::uint32_t random_dimensions{2};
+
     Ray get_ray(double h, double v) const {
         vec3 const rd = lens_radius_ * random_in_unit_disk();
         vec3 const offset = u_ * rd.x + v_ * rd.y;
@@ -54,12 +61,45 @@ public:
                    random_double(time0_, time1_)};
     }
 
+    // where a ray from the center of the lens towards a point crosses the film
+    struct FilmPoint {
+        double h, v;       // arguments of get_ray, in [0, 1] on the viewport
+        double cos_theta;  // between the ray and the viewing direction
+    };
+
+    // nothing for points behind the camera
+    std::optional<FilmPoint> film_point(point3 const & p) const {
+        vec3 const direction = p - origin_;
+        auto const depth = -dot(direction, w_);
+        if (depth <= 0.0)
+            return std::nullopt;
+        vec3 const on_film = origin_ + focus_distance_ / depth * direction - lower_left_corner_;
+        return FilmPoint{dot(on_film, horizontal_) / horizontal_.length_squared(),
+                         dot(on_film, vertical_) / vertical_.length_squared(),
+                         depth / direction.length()};
+    }
+
+    point3 const & origin() const { return origin_; }
+    bool is_pinhole() const { return lens_radius_ == 0.0; }
+
+    // of the viewport at unit distance from the origin
+    double viewport_area() const {
+        return horizontal_.length() * vertical_.length() / (focus_distance_ * focus_distance_);
+    }
+
+    // angle between the rays of vertically neighbouring pixels at the center
+    // of an image of `image_height` pixels
+    double pixel_spread(std::size_t const image_height) const {
+        return vertical_.length() / focus_distance_ / (image_height - 1);
+    }
+
 protected:
     point3 origin_;
     point3 lower_left_corner_;
     vec3 horizontal_;
     vec3 vertical_;
     vec3 u_, v_, w_;
+    double focus_distance_;
     double lens_radius_;
     double time0_, time1_;
 };
\ No newline at end of file
@@ -6,6 +6,7 @@
 
 using testing::AllOf;
 using testing::DoubleEq;
+using testing::DoubleNear;
 using testing::Eq;
 using testing::Ge;
 using testing::Lt;
@@ -107,6 +108,27 @@ TEST(Camera, emits_ray_with_time_inside_cameras_time_bounds) {
     EXPECT_THAT(ray.time(), AllOf(Ge(cam.time0_), Lt(cam.time1_)));
 }
 
+TEST(Camera, projects_points_to_the_film_coordinates_of_their_rays) {
+    Camera const cam{point3{1.0, 2.0, 3.0}, point3{0.0, 0.0, -1.0}, vec3{0.0, 1.0, 0.0},
+                     FieldOfView{40.0}, AspectRatio{1.5}, Aperture{0.0}, FocusDistance{3.0}};
+    auto const ray = cam.get_ray(0.2, 0.7);
+    auto const film_point = cam.film_point(ray.at(7.0));
+    ASSERT_TRUE(film_point);
+    EXPECT_THAT(film_point->h, DoubleNear(0.2, 1e-12));
+    EXPECT_THAT(film_point->v, DoubleNear(0.7, 1e-12));
+    EXPECT_THAT(film_point->cos_theta, DoubleNear(dot(unit_vector(ray.d), unit_vector(point3{-1.0, -2.0, -4.0})), 1e-12));
+    EXPECT_FALSE(cam.film_point(ray.at(-1.0)));
+}
+
+TEST(Camera, spreads_the_rays_of_neighbouring_pixels_by_the_pixel_spread) {
+    Camera const cam{point3{1.0, 2.0, 3.0}, point3{0.0, 0.0, -1.0}, vec3{0.0, 1.0, 0.0},
+                     FieldOfView{40.0}, AspectRatio{1.5}, Aperture{0.0}, FocusDistance{3.0}};
+    std::size_t const height = 101;
+    auto const lower = unit_vector(cam.get_ray(0.5, 0.5).d);
+    auto const upper = unit_vector(cam.get_ray(0.5, 0.5 + 1.0 / (height - 1)).d);
+    EXPECT_THAT(std::acos(dot(lower, upper)), DoubleNear(cam.pixel_spread(height), 1e-6));
+}
+
 int main(int argc, char **argv)
 {
     ::testing::InitGoogleTest(&argc, argv);
@@ -8,6 +8,9 @@
 
 using color  = vec3;
 
+// relative luminance of linear Rec. 709 primaries
+inline double luminance(color const & c) { return 0.2126 * c.x + 0.7152 * c.y + 0.0722 * c.z; }
+
 namespace ns_color {
     struct WritePrettyTag{};
     using WritePretty = TypedBool<WritePrettyTag>;
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <array>
+#include <atomic>
 #include <limits>
 #include <random>
 #include <thread>
@@ -71,12 +73,69 @@ inline double degree_to_radians(double degrees) {
     return degrees * pi / 180.0;
 }
 
+// multiple importance sampling weight of a sample drawn with density `pdf`
+// while another strategy would have drawn it with density `other_pdf`
+inline double power_heuristic(double const pdf, double const other_pdf) {
+    auto const pdf2 = pdf * pdf;
+    auto const sum = pdf2 + other_pdf * other_pdf;
+    return sum > 0.0 ? pdf2 / sum : 0.0;
+}
+
+// adds `value` to `target`, which other threads may add to concurrently
+inline void atomic_add(std::atomic<double> & target, double const value) {
+    auto expected = target.load(std::memory_order_relaxed);
+    while (!target.compare_exchange_weak(expected, expected + value, std::memory_order_relaxed)) {}
+}
+
+// Source of the numbers of `random_double` and `random_2d`, e.g. a
+// low-discrepancy sampler. Without one, they use a thread local Mersenne
+// Twister.
+class RandomSourceI {
+public:
+    virtual ~RandomSourceI() = default;
+
+    virtual double get_1d() = 0;
+    // two dimensions that are stratified jointly
+    virtual std::array<double, 2> get_2d() = 0;
+};
+
+namespace ns_common {
+    inline RandomSourceI * & random_source() {
+        static thread_local RandomSourceI * source = nullptr;
+        return source;
+    }
+}
+
+// installs `source` for the current thread during its lifetime
+class ScopedRandomSource {
+public:
+    explicit ScopedRandomSource(RandomSourceI & source) : previous_{ns_common::random_source()} {
+        ns_common::random_source() = &source;
+    }
+    ~ScopedRandomSource() { ns_common::random_source() = previous_; }
+
+    ScopedRandomSource(ScopedRandomSource const &)            = delete;
+    ScopedRandomSource& operator=(ScopedRandomSource const &) = delete;
+
+private:
+    RandomSourceI * previous_;
+};
+
 inline double random_double() {
+    if (auto * const source = ns_common::random_source())
+        return source->get_1d();
     static thread_local std::mt19937 generator;
     static std::uniform_real_distribution<double> distribution(0.0, 1.0);
     return distribution(generator);
 }
 
+// a point in [0, 1)^2, for samplers that stratify pairs of dimensions
+inline std::array<double, 2> random_2d() {
+    if (auto * const source = ns_common::random_source())
+        return source->get_2d();
+    return {random_double(), random_double()};
+}
+
 inline double random_double(double min, double max) {
     return min + (max - min) * random_double();
 }
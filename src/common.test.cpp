@@ -72,6 +72,15 @@ TEST(common, DISABLED_typed_bool_cannot_be_cast_across_types) {
     //MyBool mb{MyBool2{true}}; // TODO: assert that this line is invalid, then enable test
 }
 
+TEST(common, power_heuristic_weights_sum_to_one) {
+    EXPECT_THAT(power_heuristic(1.0, 3.0) + power_heuristic(3.0, 1.0), DoubleEq(1.0));
+    EXPECT_THAT(power_heuristic(1.0, 3.0), DoubleEq(0.1));
+}
+
+TEST(common, power_heuristic_is_zero_for_zero_pdfs) {
+    EXPECT_THAT(power_heuristic(0.0, 0.0), Eq(0.0));
+}
+
 
 int main(int argc, char **argv)
 {
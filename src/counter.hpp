@@ -1,5 +1,8 @@
 #pragma once
 
+#include <algorithm>
+#include <cstddef>
+#include <mutex>
 #include <optional>
 #include <thread>
 
@@ -18,4 +21,49 @@ public:
 private:
     std::size_t counter_{0}, end_{};
     std::mutex mutex_;
-};
\ No newline at end of file
+};
+
+// Tasks of rendering a share of the samples of the pixels of a row, handed
+// out like `Counter`, all shares of a row after the other. Splitting the
+// rows into shares keeps all threads busy when there are few rows.
+class RowSampleTasks {
+public:
+    struct Task {
+        std::size_t row;
+        std::size_t share;
+        std::size_t samples;  // per pixel
+    };
+
+    RowSampleTasks(std::size_t const rows, std::size_t const samples_per_pixel, std::size_t const shares_per_row)
+        : tasks_{rows * shares_per_row}, samples_per_pixel_{samples_per_pixel}, shares_per_row_{shares_per_row} {}
+
+    // enough shares for `tasks_per_thread` tasks per thread, but whole rows
+    // if there are enough of them and at least one sample per share
+    static std::size_t shares_per_row(std::size_t const rows,
+                                      std::size_t const samples_per_pixel,
+                                      std::size_t const threads,
+                                      std::size_t const tasks_per_thread) {
+        auto const shares = (threads * tasks_per_thread + rows - 1) / std::max<std::size_t>(rows, 1);
+        return std::clamp<std::size_t>(shares, 1, std::max<std::size_t>(samples_per_pixel, 1));
+    }
+
+    std::size_t shares_per_row() const { return shares_per_row_; }
+
+    // most samples per pixel of a share
+    std::size_t max_samples() const { return (samples_per_pixel_ + shares_per_row_ - 1) / shares_per_row_; }
+
+    std::optional<Task> next() {
+        auto const task = tasks_.next();
+        if (!task)
+            return std::nullopt;
+        auto const share = task.value() % shares_per_row_;
+        return Task{task.value() / shares_per_row_,
+                    share,
+                    samples_per_pixel_ * (share + 1) / shares_per_row_ - samples_per_pixel_ * share / shares_per_row_};
+    }
+
+private:
+    Counter tasks_;
+    std::size_t samples_per_pixel_;
+    std::size_t shares_per_row_;
+};
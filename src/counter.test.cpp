@@ -33,6 +33,27 @@ TEST(counter, is_thread_safe) {
                 1);
 }
 
+TEST(RowSampleTasks, split_the_samples_of_every_row_into_shares) {
+    RowSampleTasks tasks{3, 10, 4};
+    EXPECT_THAT(tasks.max_samples(), testing::Eq(3u));
+    std::vector<std::size_t> samples(3, 0);
+    std::size_t count = 0;
+    while (auto const task = tasks.next()) {
+        EXPECT_THAT(task->share, testing::Eq(count % 4));
+        EXPECT_THAT(task->samples, testing::AllOf(testing::Ge(2u), testing::Le(tasks.max_samples())));
+        samples[task->row] += task->samples;
+        ++count;
+    }
+    EXPECT_THAT(count, testing::Eq(12u));
+    EXPECT_THAT(samples, testing::Each(10u));
+}
+
+TEST(RowSampleTasks, keep_rows_whole_if_there_are_enough) {
+    EXPECT_THAT(RowSampleTasks::shares_per_row(400, 100, 16, 8), testing::Eq(1u));
+    EXPECT_THAT(RowSampleTasks::shares_per_row(64, 100000, 64, 8), testing::Eq(8u));
+    EXPECT_THAT(RowSampleTasks::shares_per_row(2, 3, 64, 8), testing::Eq(3u));
+}
+
 
 int main(int argc, char ** argv) {
     ::testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <color.hpp>
+#include <counter.hpp>
+#include <vec3.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// Per pixel averages of what the camera rays hit first, in row-major order.
+// Pixels without a surface hit have a zero normal and depth.
+struct FeatureBuffers {
+    FeatureBuffers(std::size_t const width, std::size_t const height)
+        : width{width}
+        , height{height}
+        , albedo(width * height, color{0.0, 0.0, 0.0})
+        , normal(width * height, vec3{0.0, 0.0, 0.0})
+        , depth(width * height, 0.0) {}
+
+    std::size_t width, height;
+    std::vector<color> albedo;
+    std::vector<vec3> normal;
+    std::vector<double> depth;
+};
+
+struct DenoiserSettings {
+    int iterations{5};
+    double sigma_color{4.0};   // of the illumination, relative to its local level; halved per iteration
+    double sigma_normal{0.3};
+    double sigma_depth{0.05};  // relative to the depth of the center pixel
+    double sigma_albedo{0.1};
+    std::size_t tile_size{32};
+};
+
+// Edge-avoiding à-trous wavelet filter (Dammertz et al., "Edge-Avoiding
+// À-Trous Wavelet Transform for fast Global Illumination Filtering"). Each
+// iteration blurs with a 5x5 B3 spline kernel whose taps are spread 2^i
+// pixels apart, weighted down across edges of the feature buffers and of
+// the image itself. The image is divided by the albedo first, so that
+// textures are not blurred, and multiplied with it at the end. The tiles of
+// an iteration are filtered by all cores.
+class Denoiser {
+public:
+    explicit Denoiser(DenoiserSettings const & settings = DenoiserSettings{}) : settings_{settings} {}
+
+    // `image` holds the mean color of every pixel, in the layout of `features`
+    std::vector<color> operator()(std::vector<color> const & image, FeatureBuffers const & features) const;
+
+private:
+    void filter_tile(std::size_t tile,
+                     int step,
+                     double sigma_color,
+                     std::vector<color> const & input,
+                     std::vector<color> & output,
+                     FeatureBuffers const & features) const;
+
+    static color demodulated(color const & c, color const & albedo) {
+        return color{c.x / albedo_floor(albedo.x), c.y / albedo_floor(albedo.y), c.z / albedo_floor(albedo.z)};
+    }
+    static double albedo_floor(double const a) { return std::max(a, 1e-3); }
+
+    DenoiserSettings settings_;
+};
+
+inline std::vector<color> Denoiser::operator()(std::vector<color> const & image, FeatureBuffers const & features) const {
+    std::vector<color> input(image.size()), output(image.size());
+    for (std::size_t ii = 0; ii < image.size(); ++ii)
+        input[ii] = demodulated(image[ii], features.albedo[ii]);
+
+    auto const tiles_x = (features.width + settings_.tile_size - 1) / settings_.tile_size;
+    auto const tiles_y = (features.height + settings_.tile_size - 1) / settings_.tile_size;
+    auto const number_of_threads = std::max(1u, std::thread::hardware_concurrency());
+    double sigma_color = settings_.sigma_color;
+    for (int iteration = 0; iteration < settings_.iterations; ++iteration) {
+        Counter tiles{tiles_x * tiles_y};
+        auto const work = [&, step = 1 << iteration] {
+            while (auto const tile = tiles.next())
+                filter_tile(tile.value(), step, sigma_color, input, output, features);
+        };
+        std::vector<std::thread> threads;
+        for (unsigned ii = 1; ii < number_of_threads; ++ii)
+            threads.emplace_back(work);
+        work();
+        for (auto & thread : threads)
+            thread.join();
+
+        std::swap(input, output);
+        sigma_color *= 0.5;
+    }
+
+    for (std::size_t ii = 0; ii < image.size(); ++ii) {
+        auto const & albedo = features.albedo[ii];
+        output[ii] = color{input[ii].x * albedo_floor(albedo.x),
+                           input[ii].y * albedo_floor(albedo.y),
+                           input[ii].z * albedo_floor(albedo.z)};
+    }
+    return output;
+}
+
+inline void Denoiser::filter_tile(std::size_t const tile,
+                                  int const step,
+                                  double const sigma_color,
+                                  std::vector<color> const & input,
+                                  std::vector<color> & output,
+                                  FeatureBuffers const & features) const {
+    static constexpr std::array<double, 5> kernel{1.0 / 16.0, 1.0 / 4.0, 3.0 / 8.0, 1.0 / 4.0, 1.0 / 16.0};
+    auto const width = static_cast<int>(features.width);
+    auto const height = static_cast<int>(features.height);
+    auto const tiles_x = (features.width + settings_.tile_size - 1) / settings_.tile_size;
+    auto const x0 = static_cast<int>((tile % tiles_x) * settings_.tile_size);
+    auto const y0 = static_cast<int>((tile / tiles_x) * settings_.tile_size);
+    auto const x1 = std::min(x0 + static_cast<int>(settings_.tile_size), width);
+    auto const y1 = std::min(y0 + static_cast<int>(settings_.tile_size), height);
+
+    for (int y = y0; y < y1; ++y)
+        for (int x = x0; x < x1; ++x) {
+            auto const p = static_cast<std::size_t>(y * width + x);
+            auto const & c_p = input[p];
+            auto const & n_p = features.normal[p];
+            auto const & a_p = features.albedo[p];
+            auto const z_p = features.depth[p];
+            // the noise of the illumination grows with its level
+            auto const color_scale = sigma_color * sigma_color * (c_p.length_squared() / 3.0 + 1e-2);
+
+            color sum{0.0, 0.0, 0.0};
+            double weight_sum = 0.0;
+            for (int dy = -2; dy <= 2; ++dy)
+                for (int dx = -2; dx <= 2; ++dx) {
+                    auto const qx = x + dx * step;
+                    auto const qy = y + dy * step;
+                    if (qx < 0 || qx >= width || qy < 0 || qy >= height)
+                        continue;
+                    auto const q = static_cast<std::size_t>(qy * width + qx);
+
+                    auto const color_distance = (input[q] - c_p).length_squared() / color_scale;
+                    auto const normal_distance = (features.normal[q] - n_p).length_squared()
+                                               / (settings_.sigma_normal * settings_.sigma_normal);
+                    auto const albedo_distance = (features.albedo[q] - a_p).length_squared()
+                                               / (settings_.sigma_albedo * settings_.sigma_albedo);
+                    auto const depth_distance = std::abs(features.depth[q] - z_p)
+                                              / (settings_.sigma_depth * std::max(z_p, 1e-3) * step);
+                    auto const weight = kernel[dx + 2] * kernel[dy + 2]
+                                      * std::exp(-color_distance - normal_distance - albedo_distance - depth_distance);
+                    sum += weight * input[q];
+                    weight_sum += weight;
+                }
+            output[p] = sum / weight_sum;
+        }
+}
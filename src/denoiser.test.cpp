@@ -0,0 +1,83 @@
+#include <denoiser.hpp>
+
+#include <common.hpp>
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <vector>
+
+
+using testing::DoubleNear;
+using testing::Lt;
+using testing::Test;
+
+
+struct ADenoiser : Test {
+public:
+    ADenoiser() {
+        std::fill(std::begin(features.albedo), std::end(features.albedo), color{0.5, 0.5, 0.5});
+        std::fill(std::begin(features.normal), std::end(features.normal), vec3{0.0, 0.0, 1.0});
+        std::fill(std::begin(features.depth), std::end(features.depth), 10.0);
+    }
+
+    static double variance(std::vector<color> const & image, double const mean) {
+        double result = 0.0;
+        for (auto const & c : image)
+            result += (c.x - mean) * (c.x - mean) / image.size();
+        return result;
+    }
+
+    std::size_t const width{40}, height{30};
+    FeatureBuffers features{width, height};
+    Denoiser const denoiser{};
+};
+
+TEST_F(ADenoiser, keeps_a_constant_image) {
+    std::vector<color> const image(width * height, color{0.2, 0.3, 0.4});
+    for (auto const & c : denoiser(image, features)) {
+        EXPECT_THAT(c.x, DoubleNear(0.2, 1e-12));
+        EXPECT_THAT(c.y, DoubleNear(0.3, 1e-12));
+        EXPECT_THAT(c.z, DoubleNear(0.4, 1e-12));
+    }
+}
+
+TEST_F(ADenoiser, reduces_noise) {
+    std::vector<color> image(width * height);
+    for (auto & c : image)
+        c = color{0.25 + 0.1 * (random_double() - 0.5)};
+    auto const denoised = denoiser(image, features);
+    EXPECT_THAT(variance(denoised, 0.25), Lt(0.1 * variance(image, 0.25)));
+}
+
+TEST_F(ADenoiser, keeps_edges_of_the_normals) {
+    std::vector<color> image(width * height);
+    for (std::size_t y = 0; y < height; ++y)
+        for (std::size_t x = 0; x < width; ++x) {
+            auto const left = x < width / 2;
+            image[y * width + x] = color{left ? 0.1 : 0.4};
+            features.normal[y * width + x] = left ? vec3{1.0, 0.0, 0.0} : vec3{0.0, 0.0, 1.0};
+        }
+    auto const denoised = denoiser(image, features);
+    for (std::size_t y = 0; y < height; ++y) {
+        EXPECT_THAT(denoised[y * width + width / 2 - 1].x, DoubleNear(0.1, 1e-3));
+        EXPECT_THAT(denoised[y * width + width / 2].x, DoubleNear(0.4, 1e-3));
+    }
+}
+
+TEST_F(ADenoiser, keeps_textures_under_constant_light) {
+    std::vector<color> image(width * height);
+    for (std::size_t ii = 0; ii < image.size(); ++ii) {
+        features.albedo[ii] = color{(ii / 3) % 2 ? 0.8 : 0.2};
+        image[ii] = 0.5 * features.albedo[ii];
+    }
+    auto const denoised = denoiser(image, features);
+    for (std::size_t ii = 0; ii < image.size(); ++ii)
+        EXPECT_THAT(denoised[ii].x, DoubleNear(image[ii].x, 1e-12));
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <common.hpp>
+#include <ray.hpp>
+#include <vec3.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+// Strategies to sample a ray parameter t within [t_min, t_max], e.g. for
+// scattering events inside a participating medium. All densities are with
+// respect to the ray parameter t, not to distance.
+
+struct DistanceSample {
+    double t;
+    double pdf;
+};
+
+//-------------------------------------------------------------------equiangular
+// Density proportional to the inverse squared distance to `light_point`, as
+// proposed by Kulla and Fajardo ("Importance Sampling Techniques for Path
+// Tracing in Participating Media"). The sampled points crowd around the
+// point of the ray closest to the light, where in-scattering peaks.
+namespace ns_equiangular {
+    struct Frame {
+        double delta;         // distance along the ray to the point closest to the light
+        double D;             // distance of the light to the ray
+        double length;        // |ray.d|, converts between t and distances
+        double theta_min, theta_max;
+    };
+
+    inline Frame frame(Ray const & ray, point3 const & light_point, double const t_min, double const t_max) {
+        auto const length = ray.d.length();
+        vec3 const direction = ray.d / length;
+        vec3 const to_light = light_point - ray.o;
+        auto const delta = dot(to_light, direction);
+        auto const D = std::max((to_light - delta * direction).length(), 1e-8);
+        return {delta, D, length,
+                std::atan((t_min * length - delta) / D),
+                std::atan((t_max * length - delta) / D)};
+    }
+}
+
+inline double equiangular_pdf(Ray const & ray, point3 const & light_point,
+                              double const t_min, double const t_max, double const t) {
+    if (t < t_min || t_max < t || t_max <= t_min)
+        return 0.0;
+    auto const f = ns_equiangular::frame(ray, light_point, t_min, t_max);
+    auto const s = t * f.length - f.delta;
+    return f.length * f.D / ((f.theta_max - f.theta_min) * (f.D * f.D + s * s));
+}
+
+inline DistanceSample sample_equiangular(Ray const & ray, point3 const & light_point,
+                                         double const t_min, double const t_max, double const u) {
+    auto const f = ns_equiangular::frame(ray, light_point, t_min, t_max);
+    auto const theta = f.theta_min + u * (f.theta_max - f.theta_min);
+    auto const t = std::clamp((f.delta + f.D * std::tan(theta)) / f.length, t_min, t_max);
+    return {t, equiangular_pdf(ray, light_point, t_min, t_max, t)};
+}
+
+//-------------------------------------------------------------------exponential
+// Density proportional to the transmittance exp(-sigma (t - t_min)) of a
+// homogeneous medium, truncated to [t_min, t_max]. `sigma` is the extinction
+// per unit of t.
+inline double exponential_pdf(double const sigma, double const t_min, double const t_max, double const t) {
+    if (t < t_min || t_max < t || t_max <= t_min)
+        return 0.0;
+    return sigma * std::exp(-sigma * (t - t_min)) / -std::expm1(-sigma * (t_max - t_min));
+}
+
+inline DistanceSample sample_exponential(double const sigma, double const t_min, double const t_max, double const u) {
+    auto const t = std::clamp(t_min - std::log1p(u * std::expm1(-sigma * (t_max - t_min))) / sigma, t_min, t_max);
+    return {t, exponential_pdf(sigma, t_min, t_max, t)};
+}
@@ -0,0 +1,100 @@
+#include <distance_sampling.hpp>
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+
+using testing::DoubleNear;
+using testing::Eq;
+using testing::Ge;
+using testing::Le;
+using testing::Test;
+
+
+struct ARayPassingALight : Test {
+    Ray const ray{point3{0.0}, vec3{2.0, 0.0, 0.0}};
+    point3 const light{1.0, 0.5, 0.0};
+    double const t_min = 0.1;
+    double const t_max = 1.5;
+
+    // midpoint rule
+    template <typename Pdf>
+    double integrate(Pdf const & pdf) const {
+        int const n = 100000;
+        double const dt = (t_max - t_min) / n;
+        double result = 0.0;
+        for (int ii = 0; ii < n; ++ii)
+            result += pdf(t_min + (ii + 0.5) * dt) * dt;
+        return result;
+    }
+};
+
+TEST_F(ARayPassingALight, equiangular_pdf_is_normalized) {
+    EXPECT_THAT(integrate([this](double const t) { return equiangular_pdf(ray, light, t_min, t_max, t); }),
+                DoubleNear(1.0, 1e-6));
+}
+
+TEST_F(ARayPassingALight, equiangular_pdf_peaks_closest_to_the_light) {
+    EXPECT_THAT(equiangular_pdf(ray, light, t_min, t_max, 0.5), Ge(equiangular_pdf(ray, light, t_min, t_max, 0.4)));
+    EXPECT_THAT(equiangular_pdf(ray, light, t_min, t_max, 0.5), Ge(equiangular_pdf(ray, light, t_min, t_max, 0.6)));
+}
+
+TEST_F(ARayPassingALight, equiangular_pdf_is_zero_outside_the_interval) {
+    EXPECT_THAT(equiangular_pdf(ray, light, t_min, t_max, 0.0), Eq(0.0));
+    EXPECT_THAT(equiangular_pdf(ray, light, t_min, t_max, 2.0), Eq(0.0));
+}
+
+TEST_F(ARayPassingALight, equiangular_samples_lie_in_the_interval) {
+    for (int ii = 0; ii < 1000; ++ii) {
+        auto const sample = sample_equiangular(ray, light, t_min, t_max, random_double());
+        ASSERT_THAT(sample.t, Ge(t_min));
+        ASSERT_THAT(sample.t, Le(t_max));
+        ASSERT_THAT(sample.pdf, DoubleNear(equiangular_pdf(ray, light, t_min, t_max, sample.t), 1e-12));
+    }
+}
+
+TEST_F(ARayPassingALight, equiangular_samples_follow_the_pdf) {
+    // fraction of samples before the point closest to the light
+    int const n = 20000;
+    int before = 0;
+    for (int ii = 0; ii < n; ++ii)
+        before += sample_equiangular(ray, light, t_min, t_max, random_double()).t < 0.5 ? 1 : 0;
+    double expected = 0.0;
+    int const steps = 10000;
+    for (int ii = 0; ii < steps; ++ii) {
+        auto const t = t_min + (ii + 0.5) * (0.5 - t_min) / steps;
+        expected += equiangular_pdf(ray, light, t_min, t_max, t) * (0.5 - t_min) / steps;
+    }
+    EXPECT_THAT(static_cast<double>(before) / n, DoubleNear(expected, 0.015));
+}
+
+TEST_F(ARayPassingALight, exponential_pdf_is_normalized) {
+    EXPECT_THAT(integrate([this](double const t) { return exponential_pdf(3.0, t_min, t_max, t); }),
+                DoubleNear(1.0, 1e-6));
+}
+
+TEST_F(ARayPassingALight, exponential_samples_lie_in_the_interval) {
+    for (int ii = 0; ii < 1000; ++ii) {
+        auto const sample = sample_exponential(3.0, t_min, t_max, random_double());
+        ASSERT_THAT(sample.t, Ge(t_min));
+        ASSERT_THAT(sample.t, Le(t_max));
+        ASSERT_THAT(sample.pdf, DoubleNear(exponential_pdf(3.0, t_min, t_max, sample.t), 1e-12));
+    }
+}
+
+TEST_F(ARayPassingALight, exponential_samples_have_the_truncated_mean) {
+    double const sigma = 3.0;
+    int const n = 20000;
+    double mean = 0.0;
+    for (int ii = 0; ii < n; ++ii)
+        mean += sample_exponential(sigma, t_min, t_max, random_double()).t / n;
+    auto const expected = integrate([&](double const t) { return t * exponential_pdf(sigma, t_min, t_max, t); });
+    EXPECT_THAT(mean, DoubleNear(expected, 0.01));
+}
+
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
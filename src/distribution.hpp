@@ -0,0 +1,46 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// Piecewise constant density on [0, 1) with one piece per function value.
+class PiecewiseConstant1d {
+public:
+    struct Sample {
+        double x;
+        double pdf;
+        std::size_t index;
+    };
+
+    explicit PiecewiseConstant1d(std::vector<double> function) : function_{std::move(function)}, cdf_(function_.size() + 1, 0.0) {
+        auto const n = static_cast<double>(function_.size());
+        for (std::size_t ii = 0; ii < function_.size(); ++ii)
+            cdf_[ii + 1] = cdf_[ii] + function_[ii] / n;
+        integral_ = cdf_.back();
+        // uniform where the function vanishes
+        for (std::size_t ii = 1; ii < cdf_.size(); ++ii)
+            cdf_[ii] = integral_ > 0.0 ? cdf_[ii] / integral_ : ii / n;
+    }
+
+    double integral() const { return integral_; }
+    std::size_t size() const { return function_.size(); }
+
+    double pdf(std::size_t const index) const {
+        return integral_ > 0.0 ? function_[index] / integral_ : 1.0;
+    }
+
+    Sample sample(double const u) const {
+        auto const upper = std::upper_bound(std::begin(cdf_), std::end(cdf_), u);
+        auto const index = static_cast<std::size_t>(std::clamp<std::ptrdiff_t>(upper - std::begin(cdf_) - 1, 0, function_.size() - 1));
+        auto const width = cdf_[index + 1] - cdf_[index];
+        auto const offset = width > 0.0 ? (u - cdf_[index]) / width : 0.0;
+        return {(index + std::clamp(offset, 0.0, 1.0)) / function_.size(), pdf(index), index};
+    }
+
+private:
+    std::vector<double> function_;
+    std::vector<double> cdf_;
+    double integral_{0.0};
+};
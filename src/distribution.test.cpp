@@ -0,0 +1,31 @@
+#include <distribution.hpp>
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+
+using testing::DoubleNear;
+using testing::Eq;
+
+
+TEST(APiecewiseConstant1d, samples_in_proportion_to_the_function) {
+    PiecewiseConstant1d const distribution{{1.0, 0.0, 3.0}};
+    EXPECT_THAT(distribution.integral(), DoubleNear(4.0 / 3.0, 1e-12));
+    EXPECT_THAT(distribution.sample(0.1).index, Eq(0u));
+    EXPECT_THAT(distribution.sample(0.5).index, Eq(2u));
+    EXPECT_THAT(distribution.sample(0.5).pdf, DoubleNear(9.0 / 4.0, 1e-12));
+    // the cdf is linear within a piece
+    EXPECT_THAT(distribution.sample(0.625).x, DoubleNear(2.0 / 3.0 + 1.0 / 6.0, 1e-12));
+}
+
+TEST(APiecewiseConstant1d, is_uniform_for_a_vanishing_function) {
+    PiecewiseConstant1d const distribution{{0.0, 0.0}};
+    EXPECT_THAT(distribution.sample(0.75).x, DoubleNear(0.75, 1e-12));
+    EXPECT_THAT(distribution.pdf(1), Eq(1.0));
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <color.hpp>
+#include <common.hpp>
+#include <distribution.hpp>
+#include <texture.hpp>
+#include <vec3.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Radiance arriving from infinitely far away, stored as an equirectangular
+// image: u = phi / 2 pi around the y axis starting at +x, v = theta / pi
+// from +y (up). Directions are importance sampled in proportion to the
+// luminance of the pixels times the solid angle they cover, by a marginal
+// distribution over the rows and a conditional one per row.
+class EnvironmentMap {
+public:
+    struct DirectionSample {
+        vec3 direction;
+        color radiance;
+        double pdf;  // per solid angle
+    };
+
+    EnvironmentMap(std::size_t width, std::size_t height, std::vector<color> pixels, double scale = 1.0);
+
+    // an HDR image (.hdr) or any format stb_image reads, linearized
+    static EnvironmentMap load(std::string const & file_name, double scale = 1.0);
+
+    color radiance(vec3 const & direction) const { return pixels_[pixel(uv(direction))]; }
+
+    DirectionSample sample(std::array<double, 2> const & u) const;
+
+    double pdf(vec3 const & direction) const;
+
+    static std::array<double, 2> uv(vec3 const & direction) {
+        auto const d = unit_vector(direction);
+        auto phi = std::atan2(d.z, d.x);
+        if (phi < 0.0)
+            phi += 2.0 * pi;
+        return {phi / (2.0 * pi), std::acos(std::clamp(d.y, -1.0, 1.0)) / pi};
+    }
+
+    static vec3 direction(std::array<double, 2> const & uv) {
+        auto const phi = 2.0 * pi * uv[0];
+        auto const theta = pi * uv[1];
+        return vec3{std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi)};
+    }
+
+private:
+    std::size_t pixel(std::array<double, 2> const & uv) const {
+        auto const i = std::min(static_cast<std::size_t>(uv[0] * width_), width_ - 1);
+        auto const j = std::min(static_cast<std::size_t>(uv[1] * height_), height_ - 1);
+        return j * width_ + i;
+    }
+
+    std::size_t width_, height_;
+    std::vector<color> pixels_;
+    std::vector<PiecewiseConstant1d> rows_;  // conditional distributions of u
+    PiecewiseConstant1d marginal_;            // of v
+};
+
+namespace ns_environment {
+    inline std::vector<color> validated(std::size_t const width, std::size_t const height, std::vector<color> pixels) {
+        if (pixels.size() != width * height || pixels.empty())
+            throw std::invalid_argument("EnvironmentMap: the pixels do not match the size");
+        return pixels;
+    }
+
+    inline std::vector<color> scaled(std::vector<color> pixels, double const scale) {
+        for (auto & pixel : pixels)
+            pixel = scale * pixel;
+        return pixels;
+    }
+
+    // per row, the luminance of the pixels times the sine of the polar angle
+    inline std::vector<PiecewiseConstant1d> rows(std::size_t const width, std::size_t const height, std::vector<color> const & pixels) {
+        std::vector<PiecewiseConstant1d> result;
+        for (std::size_t j = 0; j < height; ++j) {
+            auto const sin_theta = std::sin(pi * (j + 0.5) / height);
+            std::vector<double> function(width);
+            for (std::size_t i = 0; i < width; ++i)
+                function[i] = std::max(luminance(pixels[j * width + i]), 0.0) * sin_theta;
+            result.emplace_back(std::move(function));
+        }
+        return result;
+    }
+
+    inline std::vector<double> row_integrals(std::vector<PiecewiseConstant1d> const & rows) {
+        std::vector<double> result;
+        for (auto const & row : rows)
+            result.push_back(row.integral());
+        return result;
+    }
+}
+
+inline EnvironmentMap::EnvironmentMap(std::size_t const width, std::size_t const height, std::vector<color> pixels, double const scale)
+    : width_{width}
+    , height_{height}
+    , pixels_{ns_environment::scaled(ns_environment::validated(width, height, std::move(pixels)), scale)}
+    , rows_{ns_environment::rows(width_, height_, pixels_)}
+    , marginal_{ns_environment::row_integrals(rows_)} {}
+
+inline EnvironmentMap EnvironmentMap::load(std::string const & file_name, double const scale) {
+    int width, height, components_per_pixel;
+    float * const data = stbi_loadf(file_name.data(), &width, &height, &components_per_pixel, 3);
+    if (!data)
+        throw std::runtime_error("Could not load environment map: " + file_name + "\n");
+
+    std::vector<color> pixels(static_cast<std::size_t>(width) * height);
+    for (std::size_t ii = 0; ii < pixels.size(); ++ii)
+        pixels[ii] = color{data[3 * ii], data[3 * ii + 1], data[3 * ii + 2]};
+    stbi_image_free(data);
+    return EnvironmentMap{static_cast<std::size_t>(width), static_cast<std::size_t>(height), std::move(pixels), scale};
+}
+
+inline EnvironmentMap::DirectionSample EnvironmentMap::sample(std::array<double, 2> const & u) const {
+    auto const v = marginal_.sample(u[1]);
+    auto const u_sample = rows_[v.index].sample(u[0]);
+    std::array<double, 2> const uv{u_sample.x, v.x};
+    auto const sin_theta = std::sin(pi * uv[1]);
+    if (sin_theta <= 0.0)
+        return {vec3{0.0, 1.0, 0.0}, color{0.0}, 0.0};
+    // from the density on the square to the density per solid angle
+    auto const pdf = v.pdf * u_sample.pdf / (2.0 * pi * pi * sin_theta);
+    return {direction(uv), pixels_[v.index * width_ + u_sample.index], pdf};
+}
+
+inline double EnvironmentMap::pdf(vec3 const & direction) const {
+    auto const coordinates = uv(direction);
+    auto const sin_theta = std::sin(pi * coordinates[1]);
+    if (sin_theta <= 0.0)
+        return 0.0;
+    auto const index = pixel(coordinates);
+    auto const row = index / width_;
+    return marginal_.pdf(row) * rows_[row].pdf(index % width_) / (2.0 * pi * pi * sin_theta);
+}
@@ -0,0 +1,106 @@
+#include <environment.hpp>
+
+#include <color.hpp>
+#include <common.hpp>
+#include <vec3.hpp>
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+
+using testing::DoubleNear;
+using testing::Eq;
+using testing::Gt;
+using testing::Test;
+
+
+struct AnEnvironmentMap : Test {
+public:
+    static std::size_t constexpr width = 32;
+    static std::size_t constexpr height = 16;
+
+    // a dim sky with a bright pixel in `sun`
+    static std::vector<color> pixels() {
+        std::vector<color> result(width * height, color{0.1, 0.2, 0.3});
+        result[sun] = color{100.0};
+        return result;
+    }
+
+    static std::size_t constexpr sun = 4 * width + 5;
+    EnvironmentMap const environment{width, height, pixels()};
+    vec3 const sun_direction = EnvironmentMap::direction({(5 + 0.5) / width, (4 + 0.5) / height});
+};
+
+TEST_F(AnEnvironmentMap, maps_directions_to_pixels_and_back) {
+    for (int ii = 0; ii < 100; ++ii) {
+        auto const direction = random_unit_vector();
+        auto const mapped = EnvironmentMap::direction(EnvironmentMap::uv(direction));
+        EXPECT_THAT((mapped - direction).length(), DoubleNear(0.0, 1e-9));
+    }
+    EXPECT_THAT(EnvironmentMap::uv(vec3{0.0, 1.0, 0.0})[1], DoubleNear(0.0, 1e-12));
+    EXPECT_THAT(environment.radiance(sun_direction), Eq(color{100.0}));
+    EXPECT_THAT(environment.radiance(-sun_direction), Eq(color{0.1, 0.2, 0.3}));
+}
+
+TEST_F(AnEnvironmentMap, has_a_pdf_that_integrates_to_one) {
+    int const n = 200000;
+    double integral = 0.0;
+    for (int ii = 0; ii < n; ++ii)
+        integral += environment.pdf(random_unit_vector()) * 4.0 * pi / n;
+    EXPECT_THAT(integral, DoubleNear(1.0, 0.05));
+}
+
+TEST_F(AnEnvironmentMap, returns_the_pdf_and_radiance_of_its_samples) {
+    for (int ii = 0; ii < 100; ++ii) {
+        auto const sample = environment.sample(random_2d());
+        ASSERT_THAT(sample.pdf, Gt(0.0));
+        EXPECT_THAT(environment.pdf(sample.direction), DoubleNear(sample.pdf, 1e-9 * sample.pdf));
+        EXPECT_THAT(environment.radiance(sample.direction), Eq(sample.radiance));
+    }
+}
+
+TEST_F(AnEnvironmentMap, estimates_its_irradiance_without_bias) {
+    // of the radiance over the sphere, against uniform sampling
+    int const n = 200000;
+    double importance = 0.0, uniform = 0.0;
+    for (int ii = 0; ii < n; ++ii) {
+        auto const sample = environment.sample(random_2d());
+        importance += sample.radiance.x / sample.pdf / n;
+        uniform += environment.radiance(random_unit_vector()).x * 4.0 * pi / n;
+    }
+    EXPECT_THAT(importance, DoubleNear(uniform, 0.03 * uniform));
+}
+
+TEST_F(AnEnvironmentMap, prefers_bright_regions) {
+    int const n = 10000;
+    int in_sun = 0;
+    for (int ii = 0; ii < n; ++ii)
+        in_sun += environment.sample(random_2d()).radiance == color{100.0};
+    EXPECT_THAT(in_sun, Gt(n / 2));
+}
+
+TEST(AnEnvironmentMapOfTooFewPixels, throws) {
+    EXPECT_THROW((EnvironmentMap{4, 2, std::vector<color>(7, color{1.0, 1.0, 1.0})}), std::invalid_argument);
+}
+
+TEST(AnEnvironmentMapFile, throws_if_it_cannot_be_loaded) {
+    EXPECT_THROW(EnvironmentMap::load("does_not_exist.hdr"), std::runtime_error);
+}
+
+TEST(AnEnvironmentMapFile, loads_as_linear_floats) {
+    auto const environment = EnvironmentMap::load(DATA_PATH "/sky.hdr");
+    // the sun outshines the sky by orders of magnitude
+    EXPECT_THAT(environment.sample({0.5, 0.5}).radiance.x, Gt(100.0));
+    EXPECT_THAT(environment.radiance(vec3{0.0, 1.0, 0.0}).x, DoubleNear(0.3, 0.01));
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <common.hpp>
+#include <distribution.hpp>
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Pixel reconstruction filters, separable into the same profile along both
+// axes. Offsets are in pixels from the pixel center.
+class FilterI {
+public:
+    virtual ~FilterI() = default;
+
+    // the profile vanishes from here on
+    virtual double radius() const = 0;
+    virtual double evaluate(double x) const = 0;
+};
+
+//-------------------------------------------------------------------box
+// Uniform over the pixel, like jittering within it.
+class BoxFilter : public FilterI {
+public:
+    double radius() const override { return 0.5; }
+    double evaluate(double const x) const override { return std::abs(x) <= 0.5 ? 1.0 : 0.0; }
+};
+
+//-------------------------------------------------------------------gaussian
+// Gaussian of `sigma`, shifted down to vanish at the radius.
+class GaussianFilter : public FilterI {
+public:
+    explicit GaussianFilter(double const radius = 1.5, double const sigma = 0.5)
+        : radius_{radius}, sigma_{sigma}, offset_{gaussian(radius)} {}
+
+    double radius() const override { return radius_; }
+    double evaluate(double const x) const override { return std::max(gaussian(x) - offset_, 0.0); }
+
+private:
+    double gaussian(double const x) const { return std::exp(-x * x / (2.0 * sigma_ * sigma_)); }
+
+    double radius_;
+    double sigma_;
+    double offset_;
+};
+
+//-------------------------------------------------------------------mitchell
+// Mitchell-Netravali cubic ("Reconstruction Filters in Computer Graphics")
+// over a radius of 2, sharper than the Gaussian thanks to its negative lobes.
+class MitchellFilter : public FilterI {
+public:
+    explicit MitchellFilter(double const b = 1.0 / 3.0, double const c = 1.0 / 3.0) : b_{b}, c_{c} {}
+
+    double radius() const override { return 2.0; }
+    double evaluate(double const x) const override {
+        auto const t = std::abs(x);
+        if (t < 1.0)
+            return ((12.0 - 9.0 * b_ - 6.0 * c_) * t * t * t + (-18.0 + 12.0 * b_ + 6.0 * c_) * t * t + (6.0 - 2.0 * b_)) / 6.0;
+        if (t < 2.0)
+            return ((-b_ - 6.0 * c_) * t * t * t + (6.0 * b_ + 30.0 * c_) * t * t + (-12.0 * b_ - 48.0 * c_) * t + (8.0 * b_ + 24.0 * c_)) / 6.0;
+        return 0.0;
+    }
+
+private:
+    double b_;
+    double c_;
+};
+
+//-------------------------------------------------------------------blackman-harris
+// 4-term Blackman-Harris window over a radius of 2, between the Gaussian and
+// Mitchell in sharpness, without negative lobes.
+class BlackmanHarrisFilter : public FilterI {
+public:
+    double radius() const override { return 2.0; }
+    double evaluate(double const x) const override {
+        if (std::abs(x) >= radius())
+            return 0.0;
+        auto const t = 2.0 * pi * (x + radius()) / (2.0 * radius());
+        return 0.35875 - 0.48829 * std::cos(t) + 0.14128 * std::cos(2.0 * t) - 0.01168 * std::cos(3.0 * t);
+    }
+};
+
+enum class FilterType { box, gaussian, mitchell, blackman_harris };
+
+inline std::unique_ptr<FilterI> make_filter(FilterType const type) {
+    switch (type) {
+    case FilterType::box:
+        return std::make_unique<BoxFilter>();
+    case FilterType::gaussian:
+        return std::make_unique<GaussianFilter>();
+    case FilterType::mitchell:
+        return std::make_unique<MitchellFilter>();
+    case FilterType::blackman_harris:
+        return std::make_unique<BlackmanHarrisFilter>();
+    }
+    return std::make_unique<BoxFilter>();
+}
+
+namespace ns_filter {
+    // pieces of the tabulated profile
+    inline constexpr std::size_t table_size{64};
+}
+
+// Filter importance sampling (Ernst et al., "Filter Importance Sampling"):
+// offsets of the camera rays from the pixel center are distributed like the
+// absolute value of the filter, tabulated per axis, and each sample of the
+// pixel is weighted with the sign of the filter. The weights average to 1,
+// so the mean of the weighted samples is the filtered pixel, and each sample
+// stays in its own pixel. The offsets are monotonic in the random numbers,
+// which keeps the stratification of the sampler.
+class FilterSampler {
+public:
+    struct Sample {
+        double x, y;
+        double weight;
+    };
+
+    explicit FilterSampler(FilterI const & filter)
+        : radius_{filter.radius()}, values_{tabulate(filter)}, profile_{absolute(values_)} {
+        double absolute_integral = 0.0, signed_integral = 0.0;
+        for (auto const value : values_) {
+            absolute_integral += std::abs(value);
+            signed_integral += value;
+        }
+        // per axis
+        auto const ratio = absolute_integral / signed_integral;
+        weight_ = ratio * ratio;
+    }
+
+    double radius() const { return radius_; }
+
+    Sample sample(std::array<double, 2> const u) const {
+        auto const x = profile_.sample(u[0]);
+        auto const y = profile_.sample(u[1]);
+        auto const sign = (values_[x.index] < 0.0) != (values_[y.index] < 0.0) ? -1.0 : 1.0;
+        return {radius_ * (2.0 * x.x - 1.0), radius_ * (2.0 * y.x - 1.0), sign * weight_};
+    }
+
+private:
+    // at the centers of the pieces
+    static std::vector<double> tabulate(FilterI const & filter) {
+        std::vector<double> result(ns_filter::table_size);
+        for (std::size_t ii = 0; ii < ns_filter::table_size; ++ii)
+            result[ii] = filter.evaluate(filter.radius() * (2.0 * (ii + 0.5) / ns_filter::table_size - 1.0));
+        return result;
+    }
+
+    static PiecewiseConstant1d absolute(std::vector<double> values) {
+        for (auto & value : values)
+            value = std::abs(value);
+        return PiecewiseConstant1d{std::move(values)};
+    }
+
+    double radius_;
+    std::vector<double> values_;
+    PiecewiseConstant1d profile_;
+    double weight_{1.0};
+};
@@ -0,0 +1,100 @@
+#include <filter.hpp>
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <cmath>
+#include <memory>
+
+
+using testing::DoubleNear;
+using testing::Eq;
+using testing::Ge;
+using testing::Gt;
+using testing::Le;
+using testing::Lt;
+
+
+TEST(ABoxFilter, jitters_uniformly_within_the_pixel) {
+    FilterSampler const sampler{BoxFilter{}};
+    auto const sample = sampler.sample({0.25, 0.8});
+    EXPECT_THAT(sample.x, DoubleNear(-0.25, 1e-9));
+    EXPECT_THAT(sample.y, DoubleNear(0.3, 1e-9));
+    EXPECT_THAT(sample.weight, DoubleNear(1.0, 1e-12));
+}
+
+TEST(AGaussianFilter, vanishes_at_its_radius) {
+    GaussianFilter const filter;
+    EXPECT_THAT(filter.evaluate(filter.radius()), DoubleNear(0.0, 1e-12));
+    EXPECT_THAT(filter.evaluate(0.0), Gt(filter.evaluate(0.5)));
+}
+
+TEST(AMitchellFilter, has_negative_lobes) {
+    MitchellFilter const filter;
+    EXPECT_THAT(filter.evaluate(1.5), Lt(0.0));
+    EXPECT_THAT(filter.evaluate(2.0), Eq(0.0));
+}
+
+TEST(ABlackmanHarrisFilter, peaks_at_the_center_and_vanishes_at_its_radius) {
+    BlackmanHarrisFilter const filter;
+    EXPECT_THAT(filter.evaluate(0.0), DoubleNear(1.0, 1e-9));
+    EXPECT_THAT(filter.evaluate(filter.radius() - 1e-9), DoubleNear(0.0, 1e-4));
+}
+
+struct AFilterSampler : testing::TestWithParam<FilterType> {};
+
+TEST_P(AFilterSampler, stays_within_the_radius) {
+    auto const filter = make_filter(GetParam());
+    FilterSampler const sampler{*filter};
+    for (int ii = 0; ii < 1000; ++ii) {
+        auto const sample = sampler.sample(random_2d());
+        EXPECT_THAT(std::abs(sample.x), Le(filter->radius()));
+        EXPECT_THAT(std::abs(sample.y), Le(filter->radius()));
+    }
+}
+
+TEST_P(AFilterSampler, has_weights_averaging_to_one) {
+    FilterSampler const sampler{*make_filter(GetParam())};
+    int const n = 100000;
+    double mean = 0.0;
+    for (int ii = 0; ii < n; ++ii)
+        mean += sampler.sample(random_2d()).weight / n;
+    EXPECT_THAT(mean, DoubleNear(1.0, 0.02));
+}
+
+// the weighted samples of a function estimate its filtered value
+TEST_P(AFilterSampler, estimates_the_filtered_value) {
+    auto const filter = make_filter(GetParam());
+    FilterSampler const sampler{*filter};
+    auto const f = [](double const x, double const y) { return 1.0 + x + 0.5 * y * y; };
+
+    // midpoint rule over the support
+    int const m = 400;
+    auto const step = 2.0 * filter->radius() / m;
+    double weighted = 0.0, total = 0.0;
+    for (int ii = 0; ii < m; ++ii)
+        for (int jj = 0; jj < m; ++jj) {
+            auto const x = -filter->radius() + (ii + 0.5) * step;
+            auto const y = -filter->radius() + (jj + 0.5) * step;
+            auto const w = filter->evaluate(x) * filter->evaluate(y);
+            weighted += w * f(x, y);
+            total += w;
+        }
+
+    int const n = 200000;
+    double mean = 0.0;
+    for (int ii = 0; ii < n; ++ii) {
+        auto const sample = sampler.sample(random_2d());
+        mean += sample.weight * f(sample.x, sample.y) / n;
+    }
+    EXPECT_THAT(mean, DoubleNear(weighted / total, 0.02));
+}
+
+INSTANTIATE_TEST_SUITE_P(AllFilters, AFilterSampler,
+                         testing::Values(FilterType::box, FilterType::gaussian, FilterType::mitchell, FilterType::blackman_harris));
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
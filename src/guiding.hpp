@@ -0,0 +1,313 @@
+#pragma once
+
+#include <aabb.hpp>
+#include <common.hpp>
+#include <vec3.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Path guiding after Müller et al. ("Practical Path Guiding for Efficient
+// Light-Transport Simulation"): a binary tree over space whose leaves hold
+// quadtrees over directions. The quadtrees learn where incident radiance
+// comes from, and scattering samples directions from them as well as from
+// the material.
+
+namespace ns_guiding {
+    // equal area map of the unit sphere to the unit square, (cos theta, phi)
+    inline std::array<double, 2> to_square(vec3 const & direction) {
+        auto const cos_theta = std::clamp(direction.z, -1.0, 1.0);
+        auto phi = std::atan2(direction.y, direction.x);
+        if (phi < 0.0)
+            phi += 2.0 * pi;
+        return {std::min(0.5 * (cos_theta + 1.0), std::nextafter(1.0, 0.0)),
+                std::min(phi / (2.0 * pi), std::nextafter(1.0, 0.0))};
+    }
+
+    inline vec3 from_square(std::array<double, 2> const & uv) {
+        auto const cos_theta = 2.0 * uv[0] - 1.0;
+        auto const sin_theta = std::sqrt(std::max(0.0, 1.0 - cos_theta * cos_theta));
+        auto const phi = 2.0 * pi * uv[1];
+        return vec3{sin_theta * std::cos(phi), sin_theta * std::sin(phi), cos_theta};
+    }
+
+    // quadrant of `uv` in the unit square, and `uv` rescaled to that quadrant
+    inline std::size_t quadrant(std::array<double, 2> & uv) {
+        std::size_t result = 0;
+        for (std::size_t dim = 0; dim < 2; ++dim) {
+            auto const upper = uv[dim] >= 0.5;
+            uv[dim] = 2.0 * uv[dim] - (upper ? 1.0 : 0.0);
+            result += upper ? (dim + 1) : 0;
+        }
+        return result;
+    }
+}
+
+//-------------------------------------------------------------------quadtree
+// Density over the directions, piecewise constant on the cells of a
+// quadtree over the square of `ns_guiding::to_square`. Every node stores the
+// energy of its four quadrants, 0 marks quadrants without children.
+class QuadtreeDistribution {
+public:
+    struct Node {
+        std::array<double, 4> energy{};
+        std::array<std::uint32_t, 4> children{};
+    };
+
+    QuadtreeDistribution() : nodes_(1) {}
+    explicit QuadtreeDistribution(std::vector<Node> nodes) : nodes_{std::move(nodes)} {}
+
+    // true until radiance was recorded, the density is uniform then
+    bool empty() const { return total(0) <= 0.0; }
+
+    std::vector<Node> const & nodes() const { return nodes_; }
+
+    // per solid angle
+    double pdf(vec3 const & direction) const {
+        auto uv = ns_guiding::to_square(direction);
+        double density = 1.0;
+        for (std::uint32_t index = 0;;) {
+            auto const & node = nodes_[index];
+            auto const node_total = total(index);
+            if (node_total <= 0.0)
+                break;
+            auto const q = ns_guiding::quadrant(uv);
+            density *= 4.0 * node.energy[q] / node_total;
+            if (node.children[q] == 0)
+                break;
+            index = node.children[q];
+        }
+        return density / (4.0 * pi);
+    }
+
+    vec3 sample(std::array<double, 2> u) const {
+        std::array<double, 2> origin{0.0, 0.0};
+        double size = 1.0;
+        for (std::uint32_t index = 0;;) {
+            auto const & e = nodes_[index].energy;
+            auto const node_total = total(index);
+            if (node_total <= 0.0)
+                break;
+            // the column of quadrants first, then the quadrant within it
+            auto const left = (e[0] + e[2]) / node_total;
+            std::size_t const column = u[0] < left ? 0 : 1;
+            u[0] = column == 0 ? u[0] / left : (u[0] - left) / (1.0 - left);
+            auto const column_total = e[column] + e[column + 2];
+            auto const lower = column_total > 0.0 ? e[column] / column_total : 0.5;
+            std::size_t const row = u[1] < lower ? 0 : 1;
+            u[1] = row == 0 ? u[1] / lower : (u[1] - lower) / (1.0 - lower);
+            u = {std::clamp(u[0], 0.0, 1.0), std::clamp(u[1], 0.0, 1.0)};
+
+            size *= 0.5;
+            origin[0] += column * size;
+            origin[1] += row * size;
+            auto const child = nodes_[index].children[column + 2 * row];
+            if (child == 0)
+                break;
+            index = child;
+        }
+        return ns_guiding::from_square({origin[0] + size * u[0], origin[1] + size * u[1]});
+    }
+
+    // Structure for the next recording: quadrants holding more than
+    // `threshold` of the total energy are subdivided, the others collapsed.
+    QuadtreeDistribution refined(double const threshold, int const max_depth) const {
+        std::vector<Node> result;
+        auto const root_total = total(0);
+        if (root_total <= 0.0)
+            return QuadtreeDistribution{};
+        refine(result, 0, nodes_[0].energy, root_total, threshold, max_depth, 1);
+        return QuadtreeDistribution{std::move(result)};
+    }
+
+private:
+    double total(std::uint32_t const index) const {
+        auto const & e = nodes_[index].energy;
+        return e[0] + e[1] + e[2] + e[3];
+    }
+
+    // `index` is the corresponding node of this tree or 0 if there is none
+    std::uint32_t refine(std::vector<Node> & result,
+                         std::uint32_t const index,
+                         std::array<double, 4> const & energy,
+                         double const root_total,
+                         double const threshold,
+                         int const max_depth,
+                         int const depth) const {
+        auto const new_index = static_cast<std::uint32_t>(result.size());
+        result.push_back(Node{energy, {}});
+        for (std::size_t q = 0; q < 4; ++q) {
+            if (depth >= max_depth || energy[q] <= threshold * root_total)
+                continue;
+            auto const child = (depth == 1 || index != 0) ? nodes_[index].children[q] : 0u;
+            auto const child_energy = child != 0 ? nodes_[child].energy
+                                                 : std::array<double, 4>{energy[q] / 4.0, energy[q] / 4.0,
+                                                                         energy[q] / 4.0, energy[q] / 4.0};
+            auto const new_child = refine(result, child, child_energy, root_total, threshold, max_depth, depth + 1);
+            result[new_index].children[q] = new_child;
+        }
+        return new_index;
+    }
+
+    std::vector<Node> nodes_;
+};
+
+// Sums the radiance recorded per quadrant of a quadtree, from any number
+// of threads at once.
+class QuadtreeRecorder {
+public:
+    explicit QuadtreeRecorder(QuadtreeDistribution const & structure)
+        : children_(structure.nodes().size())
+        , energy_(std::make_unique<std::atomic<double>[]>(4 * structure.nodes().size())) {
+        for (std::size_t ii = 0; ii < children_.size(); ++ii)
+            children_[ii] = structure.nodes()[ii].children;
+    }
+
+    // `value` estimates the radiance arriving from `direction` divided by the
+    // density it was sampled with
+    void record(vec3 const & direction, double const value) {
+        auto uv = ns_guiding::to_square(direction);
+        for (std::uint32_t index = 0;;) {
+            auto const q = ns_guiding::quadrant(uv);
+            atomic_add(energy_[4 * index + q], value);
+            if (children_[index][q] == 0)
+                break;
+            index = children_[index][q];
+        }
+    }
+
+    QuadtreeDistribution distribution() const {
+        std::vector<QuadtreeDistribution::Node> nodes(children_.size());
+        for (std::size_t ii = 0; ii < nodes.size(); ++ii) {
+            nodes[ii].children = children_[ii];
+            for (std::size_t q = 0; q < 4; ++q)
+                nodes[ii].energy[q] = energy_[4 * ii + q].load(std::memory_order_relaxed);
+        }
+        return QuadtreeDistribution{std::move(nodes)};
+    }
+
+private:
+    std::vector<std::array<std::uint32_t, 4>> children_;
+    std::unique_ptr<std::atomic<double>[]> energy_;
+};
+
+//-------------------------------------------------------------------path guide
+// The spatial binary tree. Rendering threads may call `distribution` and
+// `record` concurrently; `refine` runs between passes, when no thread
+// renders. Each pass samples from what the previous passes recorded.
+class PathGuide {
+public:
+    explicit PathGuide(Aabb const & bounds);
+
+    QuadtreeDistribution const & distribution(point3 const & p) const { return leaves_[leaf(p)]->sampling; }
+
+    void record(point3 const & p, vec3 const & direction, double const value) {
+        auto & leaf_data = *leaves_[leaf(p)];
+        leaf_data.training->record(direction, value);
+        leaf_data.records.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // The recorded radiance becomes the sampling distribution. Leaves with
+    // more than `spatial_threshold` records are split in halves, recursively,
+    // and the quadtrees are refined for the next pass.
+    void refine();
+
+    std::size_t number_of_leaves() const { return leaves_.size(); }
+
+    inline static constexpr std::uint32_t spatial_threshold{4000};
+    inline static constexpr double directional_threshold{0.01};
+    inline static constexpr int max_directional_depth{16};
+
+private:
+    struct Leaf {
+        explicit Leaf(QuadtreeDistribution const & sampling_distribution)
+            : sampling{sampling_distribution}
+            , training{std::make_unique<QuadtreeRecorder>(sampling.refined(directional_threshold, max_directional_depth))} {}
+
+        QuadtreeDistribution sampling;
+        std::unique_ptr<QuadtreeRecorder> training;
+        std::atomic<std::uint32_t> records{0};
+    };
+
+    struct Node {
+        vec3 min, max;
+        std::uint32_t children[2]{0, 0};  // inner nodes only
+        std::int32_t leaf{-1};            // index into `leaves_` for leaves
+        int axis{0};
+    };
+
+    std::size_t leaf(point3 const & p) const {
+        std::uint32_t index = 0;
+        while (nodes_[index].leaf < 0) {
+            auto const & node = nodes_[index];
+            auto const split = 0.5 * (node.min[node.axis] + node.max[node.axis]);
+            index = node.children[p[node.axis] < split ? 0 : 1];
+        }
+        return static_cast<std::size_t>(nodes_[index].leaf);
+    }
+
+    std::vector<Node> nodes_;
+    std::vector<std::unique_ptr<Leaf>> leaves_;
+};
+
+inline PathGuide::PathGuide(Aabb const & bounds) {
+    Node root;
+    root.min = bounds.min();
+    root.max = bounds.max();
+    root.leaf = 0;
+    nodes_.push_back(root);
+    leaves_.push_back(std::make_unique<Leaf>(QuadtreeDistribution{}));
+}
+
+inline void PathGuide::refine() {
+    for (auto & leaf_data : leaves_) {
+        auto const trained = leaf_data->training->distribution();
+        // keep the previous distribution where nothing was recorded
+        if (!trained.empty())
+            leaf_data->sampling = trained;
+        leaf_data->training = std::make_unique<QuadtreeRecorder>(
+            leaf_data->sampling.refined(directional_threshold, max_directional_depth));
+    }
+
+    // split until every leaf is expected to get at most `spatial_threshold`
+    // records, assuming the records of a leaf fall evenly in both halves
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> pending;  // node and records
+    for (std::uint32_t ii = 0; ii < nodes_.size(); ++ii)
+        if (nodes_[ii].leaf >= 0)
+            pending.emplace_back(ii, leaves_[nodes_[ii].leaf]->records.exchange(0));
+    while (!pending.empty()) {
+        auto const [index, records] = pending.back();
+        pending.pop_back();
+        if (records <= spatial_threshold)
+            continue;
+
+        // along the longest axis, both halves start from the distribution of the parent
+        auto const extent = nodes_[index].max - nodes_[index].min;
+        auto const axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+        auto const split = 0.5 * (nodes_[index].min[axis] + nodes_[index].max[axis]);
+        auto const & parent = *leaves_[nodes_[index].leaf];
+        for (int side = 0; side < 2; ++side) {
+            Node child;
+            child.min = nodes_[index].min;
+            child.max = nodes_[index].max;
+            (side == 0 ? child.max : child.min)[axis] = split;
+            if (side == 0) {
+                child.leaf = nodes_[index].leaf;
+            } else {
+                child.leaf = static_cast<std::int32_t>(leaves_.size());
+                leaves_.push_back(std::make_unique<Leaf>(parent.sampling));
+            }
+            nodes_[index].children[side] = static_cast<std::uint32_t>(nodes_.size());
+            pending.emplace_back(static_cast<std::uint32_t>(nodes_.size()), records / 2);
+            nodes_.push_back(child);
+        }
+        nodes_[index].axis = axis;
+        nodes_[index].leaf = -1;
+    }
+}
@@ -0,0 +1,144 @@
+#include <guiding.hpp>
+
+#include <aabb.hpp>
+#include <common.hpp>
+#include <vec3.hpp>
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <array>
+#include <cmath>
+
+
+using testing::DoubleNear;
+using testing::Eq;
+using testing::Gt;
+using testing::Test;
+
+
+struct AQuadtreeDistribution : Test {
+public:
+    AQuadtreeDistribution() {
+        // a few rounds of learning a light around `peak` over a dim background
+        for (int round = 0; round < 4; ++round) {
+            QuadtreeRecorder recorder{distribution.refined(0.01, 16)};
+            for (int ii = 0; ii < 2000; ++ii) {
+                recorder.record(random_unit_vector(), 0.1);
+                recorder.record(unit_vector(peak + 0.1 * random_in_unit_sphere()), 1.0);
+            }
+            distribution = recorder.distribution();
+        }
+    }
+
+    // of `distribution` over the cells of an n x n grid on the square
+    double integral(int const n) const {
+        double result = 0.0;
+        for (int i = 0; i < n; ++i)
+            for (int j = 0; j < n; ++j)
+                result += distribution.pdf(ns_guiding::from_square({(i + 0.5) / n, (j + 0.5) / n}));
+        return result * 4.0 * pi / (n * n);
+    }
+
+    vec3 const peak = unit_vector(vec3{1.0, 2.0, 0.5});
+    QuadtreeDistribution distribution;
+};
+
+TEST(ASquareMapping, round_trips_directions) {
+    for (int ii = 0; ii < 100; ++ii) {
+        auto const direction = random_unit_vector();
+        auto const mapped = ns_guiding::from_square(ns_guiding::to_square(direction));
+        EXPECT_THAT((mapped - direction).length(), DoubleNear(0.0, 1e-9));
+    }
+}
+
+TEST_F(AQuadtreeDistribution, is_uniform_while_empty) {
+    QuadtreeDistribution const empty;
+    EXPECT_TRUE(empty.empty());
+    EXPECT_THAT(empty.pdf(peak), DoubleNear(1.0 / (4.0 * pi), 1e-12));
+    EXPECT_FALSE(distribution.empty());
+}
+
+TEST_F(AQuadtreeDistribution, integrates_to_one) {
+    EXPECT_THAT(integral(512), DoubleNear(1.0, 1e-3));
+}
+
+TEST_F(AQuadtreeDistribution, concentrates_on_the_recorded_radiance) {
+    EXPECT_THAT(distribution.nodes().size(), Gt(5u));
+    EXPECT_THAT(distribution.pdf(peak), Gt(10.0 * distribution.pdf(-peak)));
+}
+
+TEST_F(AQuadtreeDistribution, samples_according_to_its_pdf) {
+    // frequencies of the samples in the cells of a 4 x 4 grid on the square
+    int const n = 4;
+    int const samples = 100000;
+    std::array<double, n * n> counts{};
+    for (int ii = 0; ii < samples; ++ii) {
+        auto const uv = ns_guiding::to_square(distribution.sample(random_2d()));
+        counts[static_cast<int>(uv[0] * n) + n * static_cast<int>(uv[1] * n)] += 1.0 / samples;
+    }
+
+    for (int i = 0; i < n; ++i)
+        for (int j = 0; j < n; ++j) {
+            double expected = 0.0;
+            int const m = 64;  // integration points per cell and dimension
+            for (int a = 0; a < m; ++a)
+                for (int b = 0; b < m; ++b)
+                    expected += distribution.pdf(ns_guiding::from_square({(i + (a + 0.5) / m) / n,
+                                                                          (j + (b + 0.5) / m) / n}));
+            expected *= 4.0 * pi / (n * n * m * m);
+            EXPECT_THAT(counts[i + n * j], DoubleNear(expected, 0.01));
+        }
+}
+
+TEST_F(AQuadtreeDistribution, refines_only_quadrants_with_enough_energy) {
+    QuadtreeDistribution::Node root;
+    root.energy = {1.0, 0.0, 0.0, 0.0};
+    // the energy of new children is split evenly, a quarter each is below the threshold
+    auto const refined = QuadtreeDistribution{{root}}.refined(0.3, 16);
+    ASSERT_THAT(refined.nodes().size(), Eq(2u));
+    EXPECT_THAT(refined.nodes()[0].children, Eq(std::array<std::uint32_t, 4>{1, 0, 0, 0}));
+    EXPECT_THAT(refined.nodes()[1].children, Eq(std::array<std::uint32_t, 4>{0, 0, 0, 0}));
+    EXPECT_THAT(refined.nodes()[1].energy[0], DoubleNear(0.25, 1e-12));
+
+    // down to the maximum depth with a lower threshold
+    EXPECT_THAT(QuadtreeDistribution{{root}}.refined(0.01, 2).nodes().size(), Eq(2u));
+}
+
+
+struct APathGuide : Test {
+public:
+    PathGuide guide{Aabb{AabbBounds{vec3{-1.0, -1.0, -1.0}, vec3{1.0, 1.0, 1.0}}}};
+    vec3 const up{0.0, 0.0, 1.0};
+    double const uniform_pdf = 1.0 / (4.0 * pi);
+};
+
+TEST_F(APathGuide, learns_the_recorded_directions_after_refinement) {
+    point3 const p{0.5, 0.5, 0.5};
+    EXPECT_TRUE(guide.distribution(p).empty());
+    for (int ii = 0; ii < 1000; ++ii)
+        guide.record(p, up, 1.0);
+    EXPECT_TRUE(guide.distribution(p).empty());
+
+    guide.refine();
+    EXPECT_THAT(guide.distribution(p).pdf(up), Gt(2.0 * uniform_pdf));
+}
+
+TEST_F(APathGuide, splits_regions_with_many_records) {
+    for (std::uint32_t ii = 0; ii <= PathGuide::spatial_threshold; ++ii)
+        guide.record(point3{-0.5, 0.5, 0.5}, up, 1.0);
+    guide.refine();
+    EXPECT_THAT(guide.number_of_leaves(), Eq(2u));
+
+    // both halves start from what was learned
+    EXPECT_THAT(guide.distribution(point3{0.5, 0.5, 0.5}).pdf(up), Gt(2.0 * uniform_pdf));
+
+    guide.refine();
+    EXPECT_THAT(guide.number_of_leaves(), Eq(2u));
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -4,21 +4,27 @@
 #include <ray.hpp>
 #include <texture.hpp>
 
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 #include <limits>
 #include <memory>
+#include <optional>
 #include <string>
+#include <utility>
+#include <vector>
 
 
 class MaterialI;
+struct HittableI;
 
-enum class FaceSide {front, back, miss /*indicates a miss HitRecord*/};
+enum class FaceSide {front, back, medium /*scattering inside a medium*/, miss /*indicates a miss HitRecord*/};
 
 std::string toString(FaceSide const side) {
     switch(side) {
         case FaceSide::front: return "front";
         case FaceSide::back:  return "back";
+        case FaceSide::medium: return "medium";
         case FaceSide::miss:  return "miss";
     }
     return "INVALID SIDE";
@@ -28,12 +34,17 @@ struct HitRecord {
     point3 p;
     vec3 normal;
     std::shared_ptr<MaterialI> material_ptr;
-    double t;
+    double t{0.0};
     TextureCoordinates2d uv;
-    FaceSide side;
+    FaceSide side{FaceSide::front};
+    HittableI const * object{nullptr};  // primitive (or medium) that produced the record
+    double uv_scale{0.0};               // change of `uv` per unit of length on the surface, 0 if unknown
+    double footprint{0.0};              // width of the ray cone of the path at `p`, 0 for point sampling
 
     explicit operator bool() const { return side != FaceSide::miss; }
 
+    Footprint texture_footprint() const { return Footprint{footprint, footprint * uv_scale}; }
+
     static HitRecord miss() {
         return HitRecord{{}, {}, nullptr, std::numeric_limits<double>::quiet_NaN(), {}, FaceSide::miss};
     }
@@ -61,7 +72,117 @@ bool operator!=(HitRecord const & lhs, HitRecord const & rhs) {
     return !(lhs == rhs);
 }
 
+// Rays traversed together, such as the camera rays of neighbouring pixels.
+// `hits` holds the closest hit of each ray within (t_min, infinity) found so far.
+struct RayPacket {
+    std::vector<Ray> rays;
+    std::vector<HitRecord> hits;
+    double t_min{1e-3};
+    PacketBounds bounds;
+    double t_max_bound{infinity};  // no ray needs hits beyond
+
+    void clear() {
+        rays.clear();
+        hits.clear();
+    }
+
+    void add(Ray const & ray) {
+        rays.push_back(ray);
+        hits.push_back(HitRecord::miss());
+    }
+
+    double t_max(std::size_t const index) const { return hits[index] ? hits[index].t : infinity; }
+
+    // call after adding the rays, before the traversal
+    void prepare() {
+        t_max_bound = infinity;
+        bounds = PacketBounds{};
+        if (rays.empty())
+            return;
+        bounds.coherent = true;
+        bounds.origin_min = bounds.origin_max = rays.front().o;
+        bounds.inverse_direction_min = bounds.inverse_direction_max = vec3{1.0 / rays.front().d.x,
+                                                                           1.0 / rays.front().d.y,
+                                                                           1.0 / rays.front().d.z};
+        for (auto const & ray : rays) {
+            vec3 const inverse_direction{1.0 / ray.d.x, 1.0 / ray.d.y, 1.0 / ray.d.z};
+            for (std::size_t dim = 0; dim < 3; ++dim)
+                bounds.coherent = bounds.coherent && ray.d[dim] != 0.0
+                                  && (ray.d[dim] > 0.0) == (rays.front().d[dim] > 0.0);
+            bounds.origin_min = min_components(bounds.origin_min, ray.o);
+            bounds.origin_max = max_components(bounds.origin_max, ray.o);
+            bounds.inverse_direction_min = min_components(bounds.inverse_direction_min, inverse_direction);
+            bounds.inverse_direction_max = max_components(bounds.inverse_direction_max, inverse_direction);
+        }
+    }
+
+    void update_t_max_bound() {
+        t_max_bound = 0.0;
+        for (std::size_t ii = 0; ii < rays.size(); ++ii)
+            t_max_bound = std::max(t_max_bound, t_max(ii));
+    }
+};
+
+// A point on the surface of an object, drawn with area density `pdf`.
+struct SurfaceSample {
+    HitRecord record;  // position, outward normal, uv and material at the sampled point
+    double pdf;        // with respect to surface area
+};
+
 struct HittableI {
     virtual HitRecord hit(Ray const & r, double t_min, double t_max) const = 0;
     virtual Aabb bounding_box(TimeInterval times) const = 0;
-};
\ No newline at end of file
+
+    // Ray parameters at which the ray enters and leaves the object.
+    // Meant for convex objects, which a ray passes at most once. The default
+    // searches for two consecutive hits; convex shapes override it with a
+    // single query.
+    virtual std::optional<TimeInterval> intersect_interval(Ray const & r) const;
+
+    // Unbiased estimate of the fraction of light passing along the ray
+    // within (t_min, t_max), for shadow rays. The default is 0 if the object
+    // is hit and 1 otherwise; media estimate it without terminating.
+    virtual double transmittance(Ray const & r, double t_min, double t_max) const;
+
+    // Uniformly distributed point on the surface, used to sample lights.
+    // Objects that cannot be sampled return a zero pdf.
+    virtual SurfaceSample sample_surface() const { return {HitRecord::miss(), 0.0}; }
+
+    // Point on the surface to light `reference` with. Objects may prefer the
+    // part visible from `reference`; the pdf is still per area.
+    virtual SurfaceSample sample_surface_from(point3 const & reference) const { return sample_surface(); }
+
+    // area density of sample_surface() returning the point of `rec`
+    virtual double surface_pdf(HitRecord const & rec) const { return 0.0; }
+
+    // area density of sample_surface_from(reference) returning the point of `rec`
+    virtual double surface_pdf_from(point3 const & reference, HitRecord const & rec) const { return 0.0; }
+
+    // Updates the hits of `packet` with closer hits of this object. The
+    // default intersects the rays one by one; hierarchies cull their
+    // subtrees for the whole packet.
+    virtual void hit_packet(RayPacket & packet) const;
+};
+
+inline void HittableI::hit_packet(RayPacket & packet) const {
+    for (std::size_t ii = 0; ii < packet.rays.size(); ++ii)
+        if (auto rec = hit(packet.rays[ii], packet.t_min, packet.t_max(ii)))
+            packet.hits[ii] = std::move(rec);
+    packet.update_t_max_bound();
+}
+
+inline double HittableI::transmittance(Ray const & r, double const t_min, double const t_max) const {
+    return hit(r, t_min, t_max) ? 0.0 : 1.0;
+}
+
+inline std::optional<TimeInterval> HittableI::intersect_interval(Ray const & r) const {
+    auto const entry = hit(r, -infinity, infinity);
+    if (!entry)
+        return std::nullopt;
+
+    auto const exit = hit(r, entry.t + 0.0001, infinity);
+    if (!exit)
+        return std::nullopt;
+
+    return TimeInterval{entry.t, exit.t};
+}
\ No newline at end of file
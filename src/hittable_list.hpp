@@ -29,6 +29,50 @@ struct HittableList : HittableI {
 
     Aabb bounding_box(TimeInterval times) const override;
 
+    // product over the objects, 0 as soon as one of them blocks the ray
+    double transmittance(Ray const & r, double t_min, double t_max) const override {
+        double result = 1.0;
+        for (auto const & object : objects) {
+            result *= object->transmittance(r, t_min, t_max);
+            if (result <= 0.0)
+                return 0.0;
+        }
+        return result;
+    }
+
+    // picks one of the objects uniformly
+    SurfaceSample sample_surface() const override {
+        if (objects.empty())
+            return HittableI::sample_surface();
+        auto sample = objects[random_int(0, static_cast<int>(objects.size()) - 1)]->sample_surface();
+        sample.pdf /= objects.size();
+        return sample;
+    }
+
+    // `rec` needs to be a hit of one of the objects
+    double surface_pdf(HitRecord const & rec) const override {
+        for (auto const & object : objects)
+            if (object.get() == rec.object)
+                return object->surface_pdf(rec) / objects.size();
+        return 0.0;
+    }
+
+    SurfaceSample sample_surface_from(point3 const & reference) const override {
+        if (objects.empty())
+            return HittableI::sample_surface_from(reference);
+        auto sample = objects[random_int(0, static_cast<int>(objects.size()) - 1)]->sample_surface_from(reference);
+        sample.pdf /= objects.size();
+        return sample;
+    }
+
+    // `rec` needs to be a hit of one of the objects
+    double surface_pdf_from(point3 const & reference, HitRecord const & rec) const override {
+        for (auto const & object : objects)
+            if (object.get() == rec.object)
+                return object->surface_pdf_from(reference, rec) / objects.size();
+        return 0.0;
+    }
+
     // data
     std::vector<std::shared_ptr<HittableI>> objects;
 };
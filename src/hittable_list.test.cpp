@@ -1,11 +1,13 @@
 #include <hittable_list.hpp>
 
 #include <hit.hpp>
+#include <sphere.hpp>
 
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
 
 
+using testing::DoubleEq;
 using testing::Eq;
 
 
@@ -85,6 +87,16 @@ TEST(HittableList, has_bounding_box) {
     EXPECT_THAT(hl.bounding_box(TimeInterval{}).max(), Eq(aabb_position1));
 }
 
+TEST(HittableList, has_no_surface_samples_when_empty) {
+    EXPECT_THAT(HittableList{}.sample_surface().pdf, Eq(0.0));
+}
+
+TEST(HittableList, divides_surface_pdf_by_number_of_objects) {
+    HittableList const hl{{std::make_shared<Sphere>(point3{0.0}, 1.0),
+                           std::make_shared<Sphere>(point3{5.0}, 1.0)}};
+    EXPECT_THAT(hl.sample_surface().pdf, DoubleEq(1.0 / (8.0 * pi)));
+}
+
 
 int main(int argc, char **argv)
 {
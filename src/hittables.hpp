@@ -1,5 +1,6 @@
 #pragma once
 
+#include <distance_sampling.hpp>
 #include <hit.hpp>
 #include <hittable_list.hpp>
 #include <material.hpp>
@@ -8,29 +9,45 @@
 
 #include <algorithm>
 #include <memory>
+#include <optional>
 #include <ranges>
 
 
-std::shared_ptr<HittableList> box(point3 const & corner1,
-                                  point3 const & corner2,
-                                  std::shared_ptr<MaterialI> material) {
-    auto result = std::make_shared<HittableList>();
-
-    auto const min = min_components(corner1, corner2);
-    auto const max = max_components(corner1, corner2);
+// An axis-aligned box made of six quads.
+// The quads are used for shading; ray entry and exit are found with a single
+// slab test.
+class Box : public HittableList {
+public:
+    Box(point3 const & corner1, point3 const & corner2, std::shared_ptr<MaterialI> material)
+        : aabb_{AabbBounds{min_components(corner1, corner2), max_components(corner1, corner2)}} {
+        auto const min = aabb_.min();
+        auto const max = aabb_.max();
+
+        auto const dx = vec3(max.x - min.x, 0, 0);
+        auto const dy = vec3(0, max.y - min.y, 0);
+        auto const dz = vec3(0, 0, max.z - min.z);
+
+        add(std::make_shared<Quad>(point3(min.x, min.y, max.z),  dx,  dy, material)); // front
+        add(std::make_shared<Quad>(point3(max.x, min.y, max.z), -dz,  dy, material)); // right
+        add(std::make_shared<Quad>(point3(max.x, min.y, min.z), -dx,  dy, material)); // back
+        add(std::make_shared<Quad>(point3(min.x, min.y, min.z),  dz,  dy, material)); // left
+        add(std::make_shared<Quad>(point3(min.x, max.y, max.z),  dx, -dz, material)); // top
+        add(std::make_shared<Quad>(point3(min.x, min.y, min.z),  dx,  dz, material)); // bottom
+    }
 
-    auto const dx = vec3(max.x - min.x, 0, 0);
-    auto const dy = vec3(0, max.y - min.y, 0);
-    auto const dz = vec3(0, 0, max.z - min.z);
+    // HittableI
+    std::optional<TimeInterval> intersect_interval(Ray const & r) const override {
+        return aabb_.intersect_interval(r);
+    }
 
-    result->add(std::make_shared<Quad>(point3(min.x, min.y, max.z),  dx,  dy, material)); // front
-    result->add(std::make_shared<Quad>(point3(max.x, min.y, max.z), -dz,  dy, material)); // right
-    result->add(std::make_shared<Quad>(point3(max.x, min.y, min.z), -dx,  dy, material)); // back
-    result->add(std::make_shared<Quad>(point3(min.x, min.y, min.z),  dz,  dy, material)); // left
-    result->add(std::make_shared<Quad>(point3(min.x, max.y, max.z),  dx, -dz, material)); // top
-    result->add(std::make_shared<Quad>(point3(min.x, min.y, min.z),  dx,  dz, material)); // bottom
+private:
+    Aabb aabb_;
+};
 
-    return result;
+std::shared_ptr<Box> box(point3 const & corner1,
+                         point3 const & corner2,
+                         std::shared_ptr<MaterialI> material) {
+    return std::make_shared<Box>(corner1, corner2, material);
 }
 
 class Translated : public HittableI {
@@ -45,6 +62,12 @@ public:
     // HittableI
     HitRecord hit(Ray const & r, double t_min, double t_max) const override;
     Aabb bounding_box(TimeInterval times) const override{ return aabb_; };
+    std::optional<TimeInterval> intersect_interval(Ray const & r) const override {
+        return hittable_->intersect_interval(Ray{r.o - translation_, r.d, r.t});
+    }
+    double transmittance(Ray const & r, double t_min, double t_max) const override {
+        return hittable_->transmittance(Ray{r.o - translation_, r.d, r.t}, t_min, t_max);
+    }
 
 private:
     std::shared_ptr<HittableI> hittable_;
@@ -70,6 +93,12 @@ public:
     // HittableI
     HitRecord hit(Ray const & r, double t_min, double t_max) const override;
     Aabb bounding_box(TimeInterval times) const override{ return aabb_; };
+    std::optional<TimeInterval> intersect_interval(Ray const & r) const override {
+        return hittable_->intersect_interval(Ray{rotate_inverse_y(r.o), rotate_inverse_y(r.d), r.t});
+    }
+    double transmittance(Ray const & r, double t_min, double t_max) const override {
+        return hittable_->transmittance(Ray{rotate_inverse_y(r.o), rotate_inverse_y(r.d), r.t}, t_min, t_max);
+    }
 private:
 
     vec3 rotate_y(vec3 const & vec) const {
@@ -113,47 +142,129 @@ class ConstantMedium : public HittableI {
 public:
     ConstantMedium(std::shared_ptr<HittableI> boundary, double const density, std::shared_ptr<TextureI> texture)
         : boundary_{boundary}
+        , density_{density}
         , neg_inv_density_{-1.0 / density}
+        , albedo_{texture}
         , phase_function_{std::make_shared<Isotropic>(texture)} {}
 
     ConstantMedium(std::shared_ptr<HittableI> boundary, double const density, color const color)
-        : boundary_{boundary}
-        , neg_inv_density_{-1.0 / density}
-        , phase_function_{std::make_shared<Isotropic>(color)} {}
+        : ConstantMedium{boundary, density, std::make_shared<SolidColor>(color)} {}
 
     // HittableI
     HitRecord hit(Ray const & ray, double t_min, double t_max) const override {
-        HitRecord hit_record1;
-        if (!(hit_record1 = boundary_->hit(ray, -infinity, infinity)))
+        auto const interval = boundary_->intersect_interval(ray);
+        if (!interval)
             return HitRecord::miss();
 
-        HitRecord hit_record2;
-        if (!(hit_record2 = boundary_->hit(ray, hit_record1.t + 0.0001, infinity)))
-            return HitRecord::miss();
-
-        hit_record1.t = std::clamp(hit_record1.t, t_min, t_max);
-        hit_record2.t = std::clamp(hit_record2.t, t_min, t_max);
+        auto const t_entry = std::clamp(interval->min, t_min, t_max);
+        auto const t_exit = std::clamp(interval->max, t_min, t_max);
 
         auto const ray_length = ray.direction().length();
-        auto const distance_inside_boundary = (hit_record2.t - hit_record1.t) * ray_length;
+        auto const distance_inside_boundary = (t_exit - t_entry) * ray_length;
         auto const hit_distance = neg_inv_density_ * std::log(random_double());
 
         if (hit_distance > distance_inside_boundary)
             return HitRecord::miss();
 
         HitRecord result{};
-        result.t = hit_record1.t + hit_distance / ray_length;
+        result.t = t_entry + hit_distance / ray_length;
         result.p = ray.at(result.t);
+        result.side = FaceSide::medium;
         result.material_ptr = phase_function_;
+        result.object = this;
         return result;
     }
 
     Aabb bounding_box(TimeInterval times) const override{ return boundary_->bounding_box(times); };
 
+    // exact, from the length of the ray inside the boundary
+    double transmittance(Ray const & ray, double t_min, double t_max) const override {
+        auto const interval = boundary_->intersect_interval(ray);
+        if (!interval)
+            return 1.0;
 
+        auto const t_entry = std::clamp(interval->min, t_min, t_max);
+        auto const t_exit = std::clamp(interval->max, t_min, t_max);
+        return std::exp(-density_ * (t_exit - t_entry) * ray.direction().length());
+    }
+
+    // Light from `lights` scattered once inside the medium towards the ray
+    // origin, along the part of the ray within [t_min, t_max].
+    //
+    // `t_max` is the first event along the ray as returned by `world`, i.e.
+    // the closest surface or a scattering event sampled by transmittance.
+    // Since the ray reaches t with probability T(t), integrating the
+    // in-scattered light up to that event *without* the transmittance factor
+    // is an unbiased estimate of the attenuated integral. Radiance of the next
+    // path vertex after a scattering event in this medium must then not
+    // include emission from `lights` anymore.
+    //
+    // The distance is sampled twice, equiangularly around a point sampled on
+    // the lights and proportional to the transmittance, and the two samples
+    // are combined with the power heuristic.
+    color in_scattered_light(Ray const & ray,
+                             double const t_min,
+                             double const t_max,
+                             HittableI const & lights,
+                             HittableI const & world) const {
+        auto const interval = boundary_->intersect_interval(ray);
+        if (!interval)
+            return color{0.0};
+
+        auto const t_entry = std::clamp(interval->min, t_min, t_max);
+        auto const t_exit = std::clamp(interval->max, t_min, t_max);
+        if (t_exit <= t_entry)
+            return color{0.0};
+
+        auto const light = lights.sample_surface();
+        if (light.pdf <= 0.0)
+            return color{0.0};
+
+        auto const sigma = density_ * ray.d.length();  // extinction per unit of t
+        auto const equiangular = sample_equiangular(ray, light.record.p, t_entry, t_exit, random_double());
+        auto const exponential = sample_exponential(sigma, t_entry, t_exit, random_double());
+
+        auto const equiangular_weight = power_heuristic(equiangular.pdf,
+                                                        exponential_pdf(sigma, t_entry, t_exit, equiangular.t));
+        auto const exponential_weight = power_heuristic(exponential.pdf,
+                                                        equiangular_pdf(ray, light.record.p, t_entry, t_exit, exponential.t));
+
+        return equiangular_weight * direct_light(ray, equiangular, light, world)
+             + exponential_weight * direct_light(ray, exponential, light, world);
+    }
 
 private:
+    // single sample estimate of sigma * L_direct at ray(distance.t)
+    color direct_light(Ray const & ray,
+                       DistanceSample const & distance,
+                       SurfaceSample const & light,
+                       HittableI const & world) const {
+        if (distance.pdf <= 0.0)
+            return color{0.0};
+
+        point3 const p = ray.at(distance.t);
+        vec3 const to_light = light.record.p - p;
+        auto const distance_squared = to_light.length_squared();
+        auto const cos_light = std::abs(dot(light.record.normal, to_light)) / std::sqrt(distance_squared);
+        if (cos_light <= 0.0)
+            return color{0.0};
+
+        // media along the shadow ray attenuate it by their estimated transmittance
+        Ray const shadow_ray{p, to_light, ray.time()};
+        auto const visibility = world.transmittance(shadow_ray, 1e-4, 1.0 - 1e-4);
+        if (visibility <= 0.0)
+            return color{0.0};
+
+        auto const emitted = light.record.material_ptr->scatter(shadow_ray, light.record).emitted;
+        auto const phase = 1.0 / (4.0 * pi);
+        auto const sigma = density_ * ray.d.length();
+        return visibility * sigma * phase * cos_light / (distance_squared * light.pdf * distance.pdf)
+             * albedo_->value(TextureCoordinates2d{}, p) * emitted;
+    }
+
     std::shared_ptr<HittableI> boundary_;
+    double const density_;
     double const neg_inv_density_;
+    std::shared_ptr<TextureI> albedo_;
     std::shared_ptr<MaterialI> phase_function_;
-};
\ No newline at end of file
+};
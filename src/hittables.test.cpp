@@ -2,11 +2,14 @@
 
 #include <quad.hpp>
 #include <sphere.hpp>  // unnecessary
+#include <hittable_list.hpp>
 #include <material.hpp>
 
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
 
+#include <cmath>
+
 using testing::DoubleNear;
 using testing::Eq;
 using testing::Test;
@@ -92,10 +95,108 @@ TEST_F(ARotatedY, can_be_missed) {
     EXPECT_FALSE(rotated.hit(missing_ray, 0.0, infinity));
 }
 
-// struct AConstantMedium : Test {
-//
-// };
+struct ABox : Test {
+    point3 const corner1{-1.0, -2.0, -3.0};
+    point3 const corner2{1.0, 2.0, 3.0};
+    std::shared_ptr<Box> const the_box = box(corner1, corner2, std::make_shared<MockMaterial>());
+    Ray const ray{point3{-5.0, 0.5, 0.5}, vec3{2.0, 0.0, 0.0}};
+};
+
+TEST_F(ABox, consists_of_six_quads) {
+    EXPECT_THAT(the_box->objects.size(), Eq(6u));
+}
+
+TEST_F(ABox, intersect_interval_matches_two_hits) {
+    auto const interval = the_box->intersect_interval(ray);
+    ASSERT_TRUE(interval);
+    EXPECT_THAT(interval->min, DoubleNear(the_box->hit(ray, -infinity, infinity).t, 1e-12));
+    EXPECT_THAT(interval->max, DoubleNear(the_box->hit(ray, interval->min + 1e-4, infinity).t, 1e-12));
+}
+
+TEST_F(ABox, intersect_interval_is_forwarded_by_transformations) {
+    vec3 const translation{1.0, 0.0, 0.0};
+    auto const rotated = std::make_shared<RotatedY>(the_box, 90.0);
+    Translated const transformed{rotated, translation};
+    auto const interval = transformed.intersect_interval(Ray{ray.o + translation, ray.d});
+    ASSERT_TRUE(interval);
+    EXPECT_THAT(interval->min, DoubleNear(1.0, 1e-12));
+    EXPECT_THAT(interval->max, DoubleNear(4.0, 1e-12));
+}
 
+struct AConstantMedium : Test {
+    std::shared_ptr<HittableI> const boundary = std::make_shared<Sphere>(point3{0.0}, 1.0);
+    ConstantMedium const medium{boundary, 1e6, color{1.0}};
+    Ray const ray{point3{0.0, 0.0, 5.0}, vec3{0.0, 0.0, -2.0}};
+};
+
+TEST_F(AConstantMedium, scatters_inside_the_boundary) {
+    auto const hit_record = medium.hit(ray, 0.0, infinity);
+    ASSERT_TRUE(hit_record);
+    EXPECT_THAT(hit_record.t, DoubleNear(2.0, 1e-3));
+}
+
+TEST_F(AConstantMedium, scatters_inside_the_ray_interval_when_starting_inside) {
+    auto const hit_record = medium.hit(ray, 2.5, infinity);
+    ASSERT_TRUE(hit_record);
+    EXPECT_THAT(hit_record.t, DoubleNear(2.5, 1e-3));
+}
+
+TEST_F(AConstantMedium, can_be_missed) {
+    EXPECT_FALSE(medium.hit(Ray{point3{0.0, 2.0, 5.0}, vec3{0.0, 0.0, -1.0}}, 0.0, infinity));
+}
+
+TEST_F(AConstantMedium, marks_scattering_events) {
+    auto const hit_record = medium.hit(ray, 0.0, infinity);
+    EXPECT_THAT(hit_record.side, Eq(FaceSide::medium));
+    EXPECT_THAT(hit_record.object, Eq(&medium));
+}
+
+TEST_F(AConstantMedium, transmits_exponentially_along_the_inside) {
+    ConstantMedium const thin_medium{boundary, 0.5, color{1.0}};
+    EXPECT_THAT(thin_medium.transmittance(ray, 0.0, infinity), DoubleNear(std::exp(-0.5 * 2.0), 1e-12));
+    EXPECT_THAT(thin_medium.transmittance(ray, 0.0, 2.0), DoubleNear(1.0, 1e-12));
+}
+
+struct AThinMediumAndALight : Test {
+    double const sigma = 0.1;
+    double const light_size = 0.01;
+    std::shared_ptr<HittableI> const light = std::make_shared<Quad>(point3{0.5 - light_size / 2, 1.0, -light_size / 2},
+                                                                    vec3{light_size, 0.0, 0.0},
+                                                                    vec3{0.0, 0.0, light_size},
+                                                                    std::make_shared<DiffuseLight>(color{1.0}));
+    HittableList const lights{light};
+    ConstantMedium const medium{std::make_shared<Sphere>(point3{0.0}, 100.0), sigma, color{1.0}};
+    Ray const ray{point3{0.0}, vec3{1.0, 0.0, 0.0}};
+};
+
+TEST_F(AThinMediumAndALight, estimates_single_scattering) {
+    // sigma / (4 pi) * cos / d^2 * area, integrated over t in [0, 1]
+    double expected = 0.0;
+    int const steps = 10000;
+    for (int ii = 0; ii < steps; ++ii) {
+        auto const t = (ii + 0.5) / steps;
+        auto const distance_squared = (t - 0.5) * (t - 0.5) + 1.0;
+        expected += sigma / (4.0 * pi) / std::pow(distance_squared, 1.5) * light_size * light_size / steps;
+    }
+
+    int const n = 20000;
+    double mean = 0.0;
+    for (int ii = 0; ii < n; ++ii)
+        mean += medium.in_scattered_light(ray, 0.0, 1.0, lights, lights).x / n;
+    EXPECT_THAT(mean, DoubleNear(expected, 0.02 * expected));
+}
+
+TEST_F(AThinMediumAndALight, is_dark_when_the_light_is_occluded) {
+    HittableList world{light};
+    world.add(std::make_shared<Sphere>(point3{0.5, 0.5, 0.0}, 0.45));
+    EXPECT_THAT(medium.in_scattered_light(Ray{point3{0.45, 0.0, 0.0}, vec3{0.1, 0.0, 0.0}}, 0.0, 1.0, lights, world),
+                Eq(color{0.0}));
+}
+
+TEST_F(AThinMediumAndALight, is_dark_outside_of_the_boundary) {
+    EXPECT_THAT(medium.in_scattered_light(Ray{point3{200.0, 0.0, 0.0}, vec3{1.0, 0.0, 0.0}}, 0.0, 1.0, lights, lights),
+                Eq(color{0.0}));
+}
 
 
 int main(int argc, char ** argv) {
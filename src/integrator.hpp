@@ -0,0 +1,526 @@
+#pragma once
+
+#include <color.hpp>
+#include <common.hpp>
+#include <environment.hpp>
+#include <guiding.hpp>
+#include <hit.hpp>
+#include <light_bvh.hpp>
+#include <radiance_cache.hpp>
+#include <ray.hpp>
+#include <scenes.hpp>
+#include <spectrum.hpp>
+#include <vec3.hpp>
+
+#include <algorithm>
+#include <array>
+#include <optional>
+
+namespace ns_integrator {
+    // bounces before Russian roulette may terminate a path
+    inline constexpr int roulette_start_depth{3};
+
+    // upper bound of the survival probability, so that paths with a
+    // throughput near one still terminate eventually
+    inline constexpr double max_survival_probability{0.95};
+
+    // share of the directions sampled from the path guide where it applies
+    inline constexpr double guiding_fraction{0.5};
+
+    // scattering events of a path whose incident radiance trains the guide
+    inline constexpr std::size_t max_guided_vertices{16};
+
+    // share of the paths that ignore the radiance cache and train it
+    inline constexpr double cache_training_fraction{0.125};
+
+    // diffuse events of a path whose reflected radiance trains the cache
+    inline constexpr std::size_t max_cached_vertices{8};
+
+    // spread angle that the ray cone of a path widens to at a non-specular
+    // event, whose lobe averages the detail at the next hit at least as much
+    inline constexpr double scattering_spread{0.1};
+
+    inline double max_component(color const & c) { return std::max({c.x, c.y, c.z}); }
+    inline double max_component(SampledSpectrum const & s) { return s.max_component(); }
+
+    // Footprint of a path for texture filtering, a cone that starts with the
+    // spread of the camera rays and widens at non-specular events (ray cones,
+    // Akenine-Möller et al., "Texture Level of Detail Strategies for
+    // Real-Time Ray Tracing"), ignoring the curvature of the surfaces.
+    struct RayCone {
+        double width{0.0};
+        double spread{0.0};
+
+        // width at the hit `rec` of `ray`
+        double advance(Ray const & ray, HitRecord const & rec) {
+            width += spread * rec.t * ray.d.length();
+            return width;
+        }
+
+        void scatter(bool const specular) {
+            if (!specular)
+                spread = std::max(spread, scattering_spread);
+        }
+    };
+
+    // Direction from `guide` for the scattering event `rec`. Surfaces scatter
+    // to the side of their normal only, so directions below are mirrored.
+    inline vec3 sample_guide(HitRecord const & rec, QuadtreeDistribution const & guide) {
+        auto const direction = guide.sample(random_2d());
+        auto const cos_theta = dot(direction, rec.normal);
+        if (rec.side == FaceSide::medium || cos_theta >= 0.0)
+            return direction;
+        return direction - 2.0 * cos_theta * rec.normal;
+    }
+
+    // density of `sample_guide`
+    inline double guide_pdf(HitRecord const & rec, vec3 const & wi, QuadtreeDistribution const & guide) {
+        auto const direction = unit_vector(wi);
+        if (rec.side == FaceSide::medium)
+            return guide.pdf(direction);
+        auto const cos_theta = dot(direction, rec.normal);
+        if (cos_theta <= 0.0)
+            return 0.0;
+        return guide.pdf(direction) + guide.pdf(direction - 2.0 * cos_theta * rec.normal);
+    }
+
+    // density of scattering towards `wi` at `rec`, with the material alone or
+    // mixed with the `guide` distribution
+    inline double scattering_pdf(HitRecord const & rec,
+                                 vec3 const & wi,
+                                 vec3 const & wo,
+                                 QuadtreeDistribution const * guide) {
+        auto const material_pdf = rec.material_ptr->pdf(rec, wi, wo);
+        if (!guide)
+            return material_pdf;
+        return guiding_fraction * guide_pdf(rec, wi, *guide) + (1.0 - guiding_fraction) * material_pdf;
+    }
+
+    inline bool contains(HittableList const & list, HittableI const * object) {
+        return std::any_of(std::begin(list.objects), std::end(list.objects),
+                           [object](auto const & element) { return element.get() == object; });
+    }
+
+    inline bool contains(LightBvh const & lights, HittableI const * object) { return lights.contains(object); }
+
+    // true if `object` is one of the media whose direct lighting is estimated
+    // by `in_scattered_light`
+    inline bool is_listed_medium(Scene const & scene, HittableI const * object) {
+        return std::any_of(std::begin(scene.media), std::end(scene.media),
+                           [object](auto const & medium) { return medium.get() == object; });
+    }
+
+    // Russian roulette after the scattering event at `depth`. Returns false if
+    // the path terminates, otherwise reweights `throughput`, a color or a
+    // sampled spectrum.
+    template <class Throughput>
+    inline bool survives_roulette(int const depth, Throughput & throughput) {
+        if (depth + 1 < roulette_start_depth)
+            return true;
+        auto const survival = std::min(max_component(throughput), max_survival_probability);
+        if (random_double() >= survival)
+            return false;
+        throughput = throughput * (1.0 / survival);
+        return true;
+    }
+
+    // power heuristic weight of reaching the light hit in `rec` by material
+    // sampling with `material_pdf` at `previous_p`, against sampling `lights`
+    inline double emission_weight(HittableI const & lights,
+                                  point3 const & previous_p,
+                                  double const material_pdf,
+                                  HitRecord const & rec) {
+        vec3 const to_light = rec.p - previous_p;
+        auto const cos_light = std::abs(dot(rec.normal, to_light)) / to_light.length();
+        auto const light_pdf = cos_light > 0.0 ? lights.surface_pdf_from(previous_p, rec)
+                                                 * to_light.length_squared() / cos_light
+                                               : 0.0;
+        return power_heuristic(material_pdf, light_pdf);
+    }
+
+    // The previous scattering event of a path, as far as the emission hit by
+    // the ray leaving it depends on it.
+    struct PreviousEvent {
+        bool lights_sampled{false};  // `scene.lights` were sampled at the event
+        bool medium_event{false};    // in one of `scene.media`
+        point3 p{0.0};
+        double pdf{0.0};             // scattering pdf of the ray leaving the event, if lights were sampled
+
+        // Weight of the emission of the hit `rec` of the ray leaving the
+        // event. Lights of `lights` are weighted with the power heuristic
+        // against their light sample after surface events, and do not count
+        // after medium events, where `in_scattered_light` sampled them.
+        double emission_weight(LightBvh const & lights, HitRecord const & rec) const {
+            if (!lights_sampled || !contains(lights, rec.object))
+                return 1.0;
+            if (medium_event)
+                return 0.0;
+            return ns_integrator::emission_weight(lights, p, pdf, rec);
+        }
+    };
+}
+
+// A point sampled on the lights for a scattering event. `contribution` is
+// the light scattered towards the viewer if `ray` reaches the light
+// unoccluded within (1e-3, t_max), the product of the weighted scattering
+// over the pdf and the emitted light.
+struct ShadowRay {
+    Ray ray;
+    double t_max;
+    color contribution;
+    color scattering;
+    color emitted;
+};
+
+// Samples a point on `lights` for the scattering event `rec`. The sample is
+// weighted with the power heuristic against sampling the same direction with
+// the material, mixed with `guide` if it is given.
+inline std::optional<ShadowRay> sample_light(HitRecord const & rec,
+                                             vec3 const & wo,
+                                             double const time,
+                                             HittableI const & lights,
+                                             QuadtreeDistribution const * guide = nullptr) {
+    auto const light = lights.sample_surface_from(rec.p);
+    if (light.pdf <= 0.0)
+        return std::nullopt;
+
+    vec3 const to_light = light.record.p - rec.p;
+    auto const distance = to_light.length();
+    vec3 const wi = to_light / distance;
+    auto const cos_light = std::abs(dot(light.record.normal, wi));
+    auto const f = rec.material_ptr->eval(rec, wi, wo);
+    if (cos_light <= 0.0 || f == color{0.0, 0.0, 0.0})
+        return std::nullopt;
+
+    Ray const shadow_ray{rec.p, wi, time};
+    auto const emitted = light.record.material_ptr->scatter(shadow_ray, light.record).emitted;
+    auto const light_pdf = light.pdf * distance * distance / cos_light;  // per solid angle
+    auto const weight = power_heuristic(light_pdf, ns_integrator::scattering_pdf(rec, wi, wo, guide));
+    auto const scattering = weight / light_pdf * f;
+    return ShadowRay{shadow_ray, distance - 1e-3, scattering * emitted, scattering, emitted};
+}
+
+// Single sample estimate of the light from `lights` scattered at `rec`
+// towards `wo`, with a shadow ray through `world`. Media along the shadow
+// ray attenuate it by their estimated transmittance.
+inline color sample_direct_light(HitRecord const & rec,
+                                 vec3 const & wo,
+                                 double const time,
+                                 HittableI const & world,
+                                 HittableI const & lights,
+                                 QuadtreeDistribution const * guide = nullptr) {
+    auto const shadow = sample_light(rec, wo, time, lights, guide);
+    if (!shadow)
+        return color{0.0, 0.0, 0.0};
+    return world.transmittance(shadow->ray, 1e-3, shadow->t_max) * shadow->contribution;
+}
+
+// Single sample estimate of the light from `environment` scattered at `rec`
+// towards `wo`, weighted with the power heuristic like `sample_light`. The
+// shadow ray has to leave `world`.
+inline color sample_environment(HitRecord const & rec,
+                                vec3 const & wo,
+                                double const time,
+                                HittableI const & world,
+                                EnvironmentMap const & environment,
+                                QuadtreeDistribution const * guide = nullptr) {
+    auto const sample = environment.sample(random_2d());
+    if (sample.pdf <= 0.0)
+        return color{0.0, 0.0, 0.0};
+    auto const f = rec.material_ptr->eval(rec, sample.direction, wo);
+    if (f == color{0.0, 0.0, 0.0})
+        return color{0.0, 0.0, 0.0};
+    auto const visibility = world.transmittance(Ray{rec.p, sample.direction, time}, 1e-3, infinity);
+    if (visibility <= 0.0)
+        return color{0.0, 0.0, 0.0};
+    auto const weight = power_heuristic(sample.pdf, ns_integrator::scattering_pdf(rec, sample.direction, wo, guide));
+    return visibility * weight / sample.pdf * f * sample.radiance;
+}
+
+// Radiance arriving along `ray` from `world`, which holds the objects of
+// `scene` (possibly in an acceleration structure). Paths are followed
+// iteratively for at most `max_depth` scattering events. After
+// `roulette_start_depth` of them, a path survives each event with a
+// probability proportional to its throughput and is reweighted accordingly.
+//
+// Light from `scene.lights` is sampled explicitly at every non-specular
+// scattering event and along the segments through `scene.media`. Hitting
+// one of these lights right after a surface event is weighted against the
+// light sample with the power heuristic, and right after a medium event it
+// does not count again. The same holds for `scene.environment` and the
+// rays that escape `world`.
+//
+// With `scene.caustics`, non-specular surface events add the caustics from
+// the photon map, and `scene.lights` reached from them through specular
+// events only do not count again.
+//
+// With a `guide`, non-specular events sample `guiding_fraction` of their
+// directions from its distribution at the event instead of from the
+// material, and the indirect radiance found along the first
+// `max_guided_vertices` scattered rays is recorded in the guide.
+//
+// With a radiance `cache`, paths end at the first diffuse event after a
+// non-specular one whose cell holds enough records, with the cached light
+// reflected there. Paths that do not end in the cache record the light
+// reflected at their first `max_cached_vertices` diffuse events, and so do
+// `cache_training_fraction` of the paths, which never look it up.
+//
+// `first_hit` is the hit of `ray` with `world` within (1e-3, infinity), e.g.
+// from a packet traversal of camera rays.
+inline color ray_color(Ray const & ray,
+                       HitRecord const & first_hit,
+                       HittableI const & world,
+                       Scene const & scene,
+                       int const max_depth,
+                       PathGuide * guide = nullptr,
+                       RadianceCache * cache = nullptr) {
+    color result{0.0, 0.0, 0.0};
+    color throughput{1.0, 1.0, 1.0};
+    Ray current{ray};
+    ns_integrator::PreviousEvent previous;
+    bool environment_sampled = false;
+    // true if the caustics were estimated at the last non-specular event,
+    // and if the path has been specular since
+    bool caustics_estimated = false;
+    bool specular_since_caustics = false;
+    ns_integrator::RayCone cone{0.0, scene.pixel_spread};
+
+    // The radiance arriving along `wi` at `p` is the growth of `result` after
+    // the event, divided by the throughput along `wi`. Light hit right after
+    // the event does not count, its light sample covers it.
+    struct GuidedVertex {
+        point3 p;
+        vec3 wi;
+        double pdf;
+        color throughput;
+        color result;
+    };
+    std::array<GuidedVertex, ns_integrator::max_guided_vertices> vertices;
+    std::size_t number_of_vertices = 0;
+    bool previous_recorded = false;  // the previous event is the last vertex
+
+    // The light reflected at `p` is the growth of `result` after the
+    // emission at the event, divided by the throughput up to it.
+    struct CachedVertex {
+        point3 p;
+        vec3 normal;
+        color weight;  // throughput times albedo
+        color result;
+    };
+    std::array<CachedVertex, ns_integrator::max_cached_vertices> cached_vertices;
+    std::size_t number_of_cached_vertices = 0;
+    bool const use_cache = cache && random_double() >= ns_integrator::cache_training_fraction;
+    bool ended_in_cache = false;
+    bool previous_non_specular = false;  // any event before was non-specular
+
+    for (int depth = 0; depth < max_depth; ++depth) {
+        HitRecord rec = depth == 0 ? first_hit : world.hit(current, 1e-3, infinity);
+        if (rec)
+            rec.footprint = cone.advance(current, rec);
+        // light sampled at this event is reached after depth + 1 events
+        bool const sample_lights = !scene.lights.objects.empty() && depth + 1 < max_depth;
+
+        if (sample_lights)
+            for (auto const & medium : scene.media)
+                result += throughput * medium->in_scattered_light(current, 1e-3, rec ? rec.t : infinity, scene.lights, world);
+
+        if (!rec) {
+            auto const background = throughput * scene.background_color(current);
+            if (!environment_sampled)
+                result += background;
+            else {
+                auto const weighted = power_heuristic(previous.pdf, scene.environment->pdf(current.d)) * background;
+                result += weighted;
+                if (previous_recorded)
+                    vertices[number_of_vertices - 1].result += weighted;
+            }
+            break;
+        }
+
+        auto const scatter_info = rec.material_ptr->scatter(current, rec);
+        bool const listed_light = ns_integrator::contains(scene.lights, rec.object);
+        // caustic paths are counted by the photon map
+        if (!specular_since_caustics || !listed_light) {
+            auto const weighted = previous.emission_weight(scene.lights, rec) * throughput * scatter_info.emitted;
+            result += weighted;
+            if (previous_recorded && previous.lights_sampled && listed_light)
+                vertices[number_of_vertices - 1].result += weighted;
+        }
+        previous_recorded = false;
+        if (!scatter_info)
+            break;
+
+        if (cache && rec.material_ptr->is_diffuse()) {
+            if (use_cache && previous_non_specular)
+                if (auto const cached = cache->lookup(rec.p, rec.normal)) {
+                    result += throughput * scatter_info.attenuation * *cached;
+                    ended_in_cache = true;
+                    break;
+                }
+            if (number_of_cached_vertices < cached_vertices.size())
+                cached_vertices[number_of_cached_vertices++] = CachedVertex{rec.p, rec.normal, throughput * scatter_info.attenuation, result};
+        }
+        previous_non_specular = previous_non_specular || !rec.material_ptr->is_specular();
+
+        QuadtreeDistribution const * distribution = nullptr;
+        if (guide && !rec.material_ptr->is_specular()) {
+            distribution = &guide->distribution(rec.p);
+            if (distribution->empty())
+                distribution = nullptr;
+        }
+
+        // the direct lighting of scattering events in `scene.media` was
+        // estimated by `in_scattered_light` already
+        bool const medium_event = ns_integrator::is_listed_medium(scene, rec.object);
+        bool const lights_sampled = sample_lights && (medium_event || !rec.material_ptr->is_specular());
+        if (lights_sampled && !medium_event)
+            result += throughput * sample_direct_light(rec, -current.d, current.time(), world, scene.lights, distribution);
+        environment_sampled = scene.environment && depth + 1 < max_depth && !medium_event && !rec.material_ptr->is_specular();
+        if (environment_sampled)
+            result += throughput * sample_environment(rec, -current.d, current.time(), world, *scene.environment, distribution);
+        if (medium_event || !rec.material_ptr->is_specular()) {
+            // the light of a caustic is reached after a specular event at
+            // least, i.e. after depth + 2 events
+            caustics_estimated = scene.caustics && depth + 2 < max_depth && !medium_event;
+            specular_since_caustics = false;
+            if (caustics_estimated)
+                result += throughput * scene.caustics->radiance(rec, -current.d);
+        } else
+            specular_since_caustics = caustics_estimated;
+
+        Ray scattered_ray = scatter_info.scattered_ray;
+        color attenuation = scatter_info.attenuation;
+        double pdf = 0.0;
+        if (distribution) {
+            if (random_double() < ns_integrator::guiding_fraction)
+                scattered_ray = Ray{rec.p, ns_integrator::sample_guide(rec, *distribution), current.time()};
+            pdf = ns_integrator::scattering_pdf(rec, scattered_ray.d, -current.d, distribution);
+            if (pdf <= 0.0)
+                break;
+            attenuation = rec.material_ptr->eval(rec, scattered_ray.d, -current.d) / pdf;
+        }
+
+        previous = ns_integrator::PreviousEvent{lights_sampled, medium_event, rec.p, 0.0};
+        if ((lights_sampled || environment_sampled) && !medium_event)
+            previous.pdf = distribution ? pdf : rec.material_ptr->pdf(rec, scattered_ray.d, -current.d);
+
+        throughput = throughput * attenuation;
+        if (!ns_integrator::survives_roulette(depth, throughput))
+            break;
+        cone.scatter(rec.material_ptr->is_specular());
+
+        if (guide && !rec.material_ptr->is_specular() && number_of_vertices < vertices.size()) {
+            // material pdf for the first pass, when there is no distribution yet
+            if (!distribution)
+                pdf = rec.material_ptr->pdf(rec, scattered_ray.d, -current.d);
+            if (pdf > 0.0) {
+                vertices[number_of_vertices++] = GuidedVertex{rec.p, unit_vector(scattered_ray.d), pdf, throughput, result};
+                previous_recorded = true;
+            }
+        }
+
+        current = scattered_ray;
+    }
+
+    for (std::size_t ii = 0; ii < number_of_vertices; ++ii) {
+        auto const & vertex = vertices[ii];
+        auto const radiance = result - vertex.result;
+        double sum = 0.0;
+        int channels = 0;
+        for (int c = 0; c < 3; ++c)
+            if (vertex.throughput[c] > 0.0) {
+                sum += radiance[c] / vertex.throughput[c];
+                ++channels;
+            }
+        if (channels > 0)
+            guide->record(vertex.p, vertex.wi, sum / channels / vertex.pdf);
+    }
+
+    for (std::size_t ii = 0; ii < number_of_cached_vertices && !ended_in_cache; ++ii) {
+        auto const & vertex = cached_vertices[ii];
+        auto const reflected = result - vertex.result;
+        color value{0.0, 0.0, 0.0};
+        for (int c = 0; c < 3; ++c)
+            if (vertex.weight[c] > 0.0)
+                value[c] = reflected[c] / vertex.weight[c];
+        cache->record(vertex.p, vertex.normal, value);
+    }
+
+    return result;
+}
+
+inline color ray_color(Ray const & ray,
+                       HittableI const & world,
+                       Scene const & scene,
+                       int const max_depth,
+                       PathGuide * guide = nullptr,
+                       RadianceCache * cache = nullptr) {
+    return ray_color(ray, world.hit(ray, 1e-3, infinity), world, scene, max_depth, guide, cache);
+}
+
+// Radiance arriving along `ray` like `ray_color`, traced for a hero
+// wavelength and the wavelengths spaced evenly from it at once, and
+// converted to linear sRGB. Colors of materials, lights and the background
+// are upsampled to spectra. A dispersive event scatters the hero wavelength
+// only and ends the others.
+//
+// Light from `scene.lights` and `scene.media` is sampled as in `ray_color`;
+// the environment, the caustics, guiding and radiance caching are not.
+inline color spectral_ray_color(Ray const & ray,
+                                HittableI const & world,
+                                Scene const & scene,
+                                int const max_depth) {
+    auto wavelengths = SampledWavelengths::sample(random_double());
+    SampledSpectrum result{0.0};
+    SampledSpectrum throughput{1.0};
+    Ray current{ray};
+    ns_integrator::PreviousEvent previous;
+    ns_integrator::RayCone cone{0.0, scene.pixel_spread};
+
+    for (int depth = 0; depth < max_depth; ++depth) {
+        HitRecord rec = world.hit(current, 1e-3, infinity);
+        if (rec)
+            rec.footprint = cone.advance(current, rec);
+        bool const sample_lights = !scene.lights.objects.empty() && depth + 1 < max_depth;
+
+        if (sample_lights)
+            for (auto const & medium : scene.media)
+                result += throughput * wavelengths.upsample(medium->in_scattered_light(current, 1e-3, rec ? rec.t : infinity,
+                                                                                       scene.lights, world));
+
+        if (!rec) {
+            result += throughput * wavelengths.upsample(scene.background_color(current));
+            break;
+        }
+
+        auto const scatter_info = rec.material_ptr->scatter_wavelength(current, rec, wavelengths.hero());
+        result += previous.emission_weight(scene.lights, rec) * throughput * wavelengths.upsample(scatter_info.emitted);
+        if (!scatter_info)
+            break;
+        if (rec.material_ptr->is_dispersive())
+            wavelengths.terminate_secondary(throughput);
+
+        bool const medium_event = ns_integrator::is_listed_medium(scene, rec.object);
+        bool const lights_sampled = sample_lights && (medium_event || !rec.material_ptr->is_specular());
+        if (lights_sampled && !medium_event) {
+            auto const shadow = sample_light(rec, -current.d, current.time(), scene.lights);
+            if (shadow)
+                result += world.transmittance(shadow->ray, 1e-3, shadow->t_max)
+                        * throughput * wavelengths.upsample(shadow->scattering) * wavelengths.upsample(shadow->emitted);
+        }
+
+        auto const & scattered_ray = scatter_info.scattered_ray;
+        previous = ns_integrator::PreviousEvent{lights_sampled, medium_event, rec.p, 0.0};
+        if (lights_sampled && !medium_event)
+            previous.pdf = rec.material_ptr->pdf(rec, scattered_ray.d, -current.d);
+
+        throughput *= wavelengths.upsample(scatter_info.attenuation);
+        if (!ns_integrator::survives_roulette(depth, throughput))
+            break;
+        cone.scatter(rec.material_ptr->is_specular());
+
+        current = scattered_ray;
+    }
+
+    return wavelengths.to_rgb(result);
+}
@@ -0,0 +1,335 @@
+#include <integrator.hpp>
+
+#include <hittable_list.hpp>
+#include <material.hpp>
+#include <quad.hpp>
+#include <sphere.hpp>
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <cmath>
+#include <memory>
+#include <vector>
+
+
+using testing::DoubleNear;
+using testing::Eq;
+using testing::Test;
+
+
+// emits `emitted` and scatters uniformly to the side of the normal with `albedo`
+struct GlowingMaterial : MaterialI {
+    GlowingMaterial(double const emitted, double const albedo) : emitted{emitted}, albedo{albedo} {}
+
+    ScatterInfo scatter(Ray const & ray_in, HitRecord const & hit_rec) const override {
+        return ScatterInfo{Ray{hit_rec.p, random_in_hemisphere(hit_rec.normal)}, color{albedo}, color{emitted}};
+    }
+
+    double emitted;
+    double albedo;
+};
+
+Scene scene_of(HittableList const & world, color const background, HittableList const & lights = {}) {
+    return Scene{world,
+                 [background](Ray const &) { return background; },
+                 Camera{},
+                 lights,
+                 {}};
+}
+
+TEST(ray_color, returns_background_on_miss) {
+    auto const scene = scene_of(HittableList{}, color{0.1, 0.2, 0.3});
+    EXPECT_THAT(ray_color(Ray{point3{0.0}, vec3{1.0, 0.0, 0.0}}, scene.world, scene, 10), Eq(color{0.1, 0.2, 0.3}));
+}
+
+TEST(ray_color, is_black_without_bounces) {
+    auto const scene = scene_of(HittableList{}, color{1.0});
+    EXPECT_THAT(ray_color(Ray{point3{0.0}, vec3{1.0, 0.0, 0.0}}, scene.world, scene, 0), Eq(color{0.0}));
+}
+
+TEST(ray_color, returns_emission_of_first_hit_for_depth_one) {
+    auto const scene = scene_of(HittableList{std::make_shared<Sphere>(point3{0.0}, 1.0, std::make_shared<GlowingMaterial>(2.0, 0.5))},
+                                color{0.0});
+    EXPECT_THAT(ray_color(Ray{point3{0.0}, vec3{1.0, 0.0, 0.0}}, scene.world, scene, 1), Eq(color{2.0}));
+}
+
+struct AGlowingFurnace : Test {
+    // from inside, every path bounces forever: L = emitted / (1 - albedo)
+    double const emitted = 1.0;
+    double const albedo = 0.8;
+    Scene const scene = scene_of(HittableList{std::make_shared<Sphere>(point3{0.0}, 1.0,
+                                                                       std::make_shared<GlowingMaterial>(emitted, albedo))},
+                                 color{0.0});
+};
+
+TEST_F(AGlowingFurnace, converges_to_the_infinite_bounce_solution) {
+    int const n = 20000;
+    double mean = 0.0;
+    for (int ii = 0; ii < n; ++ii)
+        mean += ray_color(Ray{point3{0.0}, random_unit_vector()}, scene.world, scene, 1000).x / n;
+    EXPECT_THAT(mean, DoubleNear(emitted / (1.0 - albedo), 0.1));
+}
+
+TEST_F(AGlowingFurnace, is_unbiased_for_a_fixed_depth) {
+    // sum of the first `depth` terms of the geometric series
+    int const depth = 10;
+    double expected = 0.0;
+    for (int ii = 0; ii < depth; ++ii)
+        expected += emitted * std::pow(albedo, ii);
+
+    int const n = 20000;
+    double mean = 0.0;
+    for (int ii = 0; ii < n; ++ii)
+        mean += ray_color(Ray{point3{0.0}, random_unit_vector()}, scene.world, scene, depth).x / n;
+    EXPECT_THAT(mean, DoubleNear(expected, 0.05));
+}
+
+TEST(ray_color, keeps_unlisted_emitters_after_medium_events) {
+    // A scattering medium without absorption inside of a shell that emits 1
+    // is lit by the shell only, which is not one of the sampled lights. The
+    // dark light outside merely turns on light sampling.
+    auto const medium = std::make_shared<ConstantMedium>(std::make_shared<Sphere>(point3{0.0}, 0.9), 2.0, color{1.0});
+    HittableList world{std::make_shared<Sphere>(point3{0.0}, 1.0, std::make_shared<DiffuseLight>(color{1.0}))};
+    world.add(medium);
+    HittableList const lights{std::make_shared<Quad>(point3{5.0}, vec3{1.0, 0.0, 0.0}, vec3{0.0, 0.0, 1.0},
+                                                     std::make_shared<DiffuseLight>(color{0.0}))};
+    world.add(lights.objects.front());
+    auto scene = scene_of(world, color{0.0}, lights);
+    scene.media.push_back(medium);
+
+    int const n = 10000;
+    double mean = 0.0;
+    for (int ii = 0; ii < n; ++ii)
+        mean += ray_color(Ray{point3{0.0}, random_unit_vector()}, scene.world, scene, 1000).x / n;
+    EXPECT_THAT(mean, DoubleNear(1.0, 0.05));
+}
+
+struct AFloorBelowALight : Test {
+    double const albedo = 0.5;
+    double const radiance = 4.0;
+    std::shared_ptr<HittableI> const floor = std::make_shared<Quad>(point3{-50.0, 0.0, -50.0}, vec3{0.0, 0.0, 100.0}, vec3{100.0, 0.0, 0.0},
+                                                                    std::make_shared<lambertian>(color{albedo}));
+    std::shared_ptr<HittableI> light(double const size) const {
+        return std::make_shared<Quad>(point3{-size / 2, 1.0, -size / 2}, vec3{size, 0.0, 0.0}, vec3{0.0, 0.0, size},
+                                      std::make_shared<DiffuseLight>(color{radiance}));
+    }
+    HitRecord floor_hit() const { return floor->hit(Ray{point3{0.0, 1.0, 1.0}, vec3{0.0, -1.0, -1.0}}, 0.0, infinity); }
+};
+
+TEST_F(AFloorBelowALight, samples_light_on_the_floor) {
+    // a small light straight above: albedo / pi * radiance * area / height^2
+    double const size = 0.01;
+    HittableList const lights{light(size)};
+    HittableList world{floor};
+    world.add(lights.objects.front());
+    auto const rec = floor_hit();
+    double mean = 0.0;
+    int const n = 1000;
+    for (int ii = 0; ii < n; ++ii)
+        mean += sample_direct_light(rec, vec3{0.0, 1.0, 1.0}, 0.0, world, lights).x / n;
+    EXPECT_THAT(mean, DoubleNear(albedo / pi * radiance * size * size, 1e-3 * albedo / pi * radiance * size * size));
+}
+
+TEST_F(AFloorBelowALight, is_dark_in_shadow) {
+    HittableList const lights{light(0.01)};
+    HittableList world{floor};
+    world.add(lights.objects.front());
+    world.add(std::make_shared<Sphere>(point3{0.0, 0.5, 0.0}, 0.1));
+    EXPECT_THAT(sample_direct_light(floor_hit(), vec3{0.0, 1.0, 1.0}, 0.0, world, lights), Eq(color{0.0}));
+}
+
+TEST_F(AFloorBelowALight, matches_the_estimate_without_light_sampling) {
+    HittableList world{floor};
+    world.add(light(1.0));
+    auto const with_lights = scene_of(world, color{0.0}, HittableList{world.objects.back()});
+    auto const without_lights = scene_of(world, color{0.0});
+    Ray const ray{point3{0.0, 0.5, 0.5}, vec3{0.0, -1.0, -1.0}};
+
+    int const n = 40000;
+    double mean_with = 0.0, mean_without = 0.0;
+    for (int ii = 0; ii < n; ++ii) {
+        mean_with += ray_color(ray, world, with_lights, 4).x / n;
+        mean_without += ray_color(ray, world, without_lights, 4).x / n;
+    }
+    EXPECT_THAT(mean_with, DoubleNear(mean_without, 0.05 * mean_without));
+}
+
+TEST_F(AFloorBelowALight, matches_the_estimate_without_light_sampling_when_glossy) {
+    auto const glossy_floor = std::make_shared<Quad>(point3{-50.0, 0.0, -50.0}, vec3{0.0, 0.0, 100.0}, vec3{100.0, 0.0, 0.0},
+                                                     std::make_shared<metal>(color{albedo}, 0.3));
+    HittableList world{glossy_floor};
+    world.add(light(0.5));
+    auto const with_lights = scene_of(world, color{0.0}, HittableList{world.objects.back()});
+    auto const without_lights = scene_of(world, color{0.0});
+    Ray const ray{point3{0.0, 0.5, 0.5}, vec3{0.0, -1.0, -1.0}};
+
+    int const n = 40000;
+    double mean_with = 0.0, mean_without = 0.0;
+    for (int ii = 0; ii < n; ++ii) {
+        mean_with += ray_color(ray, world, with_lights, 4).x / n;
+        mean_without += ray_color(ray, world, without_lights, 4).x / n;
+    }
+    EXPECT_THAT(mean_with, DoubleNear(mean_without, 0.05 * mean_without));
+}
+
+TEST_F(AFloorBelowALight, matches_the_estimate_without_guiding) {
+    // a wall next to the light, lit by it and lighting the floor
+    HittableList world{floor};
+    world.add(std::make_shared<Quad>(point3{1.0, 0.0, -50.0}, vec3{0.0, 0.0, 100.0}, vec3{0.0, 5.0, 0.0},
+                                     std::make_shared<lambertian>(color{albedo})));
+    world.add(light(1.0));
+    auto const scene = scene_of(world, color{0.0}, HittableList{world.objects.back()});
+    Ray const ray{point3{0.0, 0.5, 0.5}, vec3{0.0, -1.0, -1.0}};
+
+    PathGuide guide{Aabb{AabbBounds{vec3{-50.0, -1.0, -50.0}, vec3{50.0, 5.0, 50.0}}}};
+    for (int pass = 0; pass < 3; ++pass) {
+        for (int ii = 0; ii < 10000; ++ii)
+            ray_color(ray, world, scene, 4, &guide);
+        guide.refine();
+    }
+    ASSERT_FALSE(guide.distribution(point3{0.0, 0.0, 0.0}).empty());
+
+    int const n = 40000;
+    double mean_guided = 0.0, mean = 0.0;
+    for (int ii = 0; ii < n; ++ii) {
+        mean_guided += ray_color(ray, world, scene, 4, &guide).x / n;
+        mean += ray_color(ray, world, scene, 4).x / n;
+    }
+    EXPECT_THAT(mean_guided, DoubleNear(mean, 0.05 * mean));
+}
+
+TEST_F(AFloorBelowALight, matches_the_estimate_without_environment_sampling) {
+    // a sun over the floor in a dim sky, next to a wall
+    std::vector<color> pixels(16 * 8, color{0.2});
+    pixels[2 * 16 + 3] = color{50.0};
+    auto const environment = std::make_shared<EnvironmentMap const>(16, 8, std::move(pixels));
+    HittableList world{floor};
+    world.add(std::make_shared<Quad>(point3{1.0, 0.0, -50.0}, vec3{0.0, 0.0, 100.0}, vec3{0.0, 5.0, 0.0},
+                                     std::make_shared<lambertian>(color{albedo})));
+    auto const background = [environment](Ray const & ray) { return environment->radiance(ray.d); };
+    Scene const with_environment{world, background, Camera{}, HittableList{}, {}, environment};
+    Scene const without_environment{world, background, Camera{}, HittableList{}, {}};
+    Ray const ray{point3{0.0, 0.5, 0.5}, vec3{0.0, -1.0, -1.0}};
+
+    int const n = 200000;  // escaping towards the sun is rare without sampling it
+    double mean_with = 0.0, mean_without = 0.0;
+    for (int ii = 0; ii < n; ++ii) {
+        mean_with += ray_color(ray, world, with_environment, 4).x / n;
+        mean_without += ray_color(ray, world, without_environment, 4).x / n;
+    }
+    EXPECT_THAT(mean_with, DoubleNear(mean_without, 0.05 * mean_without));
+}
+
+TEST_F(AFloorBelowALight, matches_the_estimate_without_caustic_photons) {
+    // a mirror above the light casts its image onto the floor
+    HittableList world{floor};
+    world.add(std::make_shared<Quad>(point3{-50.0, 2.0, -50.0}, vec3{100.0, 0.0, 0.0}, vec3{0.0, 0.0, 100.0},
+                                     std::make_shared<metal>(color{1.0}, 0.0)));
+    world.add(light(1.0));
+    HittableList const lights{world.objects.back()};
+    auto const without_photons = scene_of(world, color{0.0}, lights);
+    auto with_photons = without_photons;
+    with_photons.caustics = std::make_shared<PhotonMap const>(trace_caustics(world, lights, 100000, 0.3));
+    Ray const ray{point3{2.0, 0.5, 0.5}, vec3{0.0, -1.0, -1.0}};
+
+    int const n = 50000;
+    double mean_with = 0.0, mean_without = 0.0;
+    for (int ii = 0; ii < n; ++ii) {
+        mean_with += ray_color(ray, world, with_photons, 4).x / n;
+        mean_without += ray_color(ray, world, without_photons, 4).x / n;
+    }
+    EXPECT_THAT(mean_with, DoubleNear(mean_without, 0.1 * mean_without));
+}
+
+TEST_F(AFloorBelowALight, matches_the_estimate_without_a_radiance_cache) {
+    // a wall next to the light, lit by it and lighting the floor
+    HittableList world{floor};
+    world.add(std::make_shared<Quad>(point3{1.0, 0.0, -50.0}, vec3{0.0, 0.0, 100.0}, vec3{0.0, 5.0, 0.0},
+                                     std::make_shared<lambertian>(color{albedo})));
+    world.add(light(1.0));
+    auto const scene = scene_of(world, color{0.0}, HittableList{world.objects.back()});
+    Ray const ray{point3{0.0, 0.5, 0.5}, vec3{0.0, -1.0, -1.0}};
+
+    RadianceCache cache{0.1};
+    for (int ii = 0; ii < 100000; ++ii)
+        ray_color(Ray{point3{random_double(-2.0, 1.0), 0.5, 1.0}, vec3{random_double(-1.0, 1.0), -1.0, random_double(-2.0, 0.0)}},
+                  world, scene, 4, nullptr, &cache);
+    ASSERT_THAT(cache.number_of_cells(), testing::Gt(100u));
+
+    int const n = 40000;
+    double mean_cached = 0.0, mean = 0.0;
+    for (int ii = 0; ii < n; ++ii) {
+        mean_cached += ray_color(ray, world, scene, 4, nullptr, &cache).x / n;
+        mean += ray_color(ray, world, scene, 4).x / n;
+    }
+    EXPECT_THAT(mean_cached, DoubleNear(mean, 0.05 * mean));
+}
+
+TEST(ARayCone, widens_with_the_distance_and_at_non_specular_events) {
+    ns_integrator::RayCone cone{0.0, 0.01};
+    HitRecord rec;
+    rec.t = 5.0;
+    EXPECT_THAT(cone.advance(Ray{point3{0.0}, vec3{0.0, 2.0, 0.0}}, rec), DoubleNear(0.1, 1e-12));
+    cone.scatter(true);
+    EXPECT_THAT(cone.spread, Eq(0.01));
+    cone.scatter(false);
+    EXPECT_THAT(cone.spread, Eq(ns_integrator::scattering_spread));
+    EXPECT_THAT(cone.advance(Ray{point3{0.0}, vec3{1.0, 0.0, 0.0}}, rec), DoubleNear(0.1 + 5.0 * ns_integrator::scattering_spread, 1e-12));
+}
+
+TEST(spectral_ray_color, returns_background_on_miss) {
+    auto const scene = scene_of(HittableList{}, color{0.5});
+    int const n = 10000;
+    color mean{0.0};
+    for (int ii = 0; ii < n; ++ii)
+        mean += spectral_ray_color(Ray{point3{0.0}, vec3{1.0, 0.0, 0.0}}, scene.world, scene, 10) / n;
+    for (int c = 0; c < 3; ++c)
+        EXPECT_THAT(mean[c], DoubleNear(0.5, 0.01));
+}
+
+TEST_F(AFloorBelowALight, matches_the_rgb_estimate_when_spectral) {
+    HittableList world{floor};
+    world.add(light(1.0));
+    auto const scene = scene_of(world, color{0.0}, HittableList{world.objects.back()});
+    Ray const ray{point3{0.0, 0.5, 0.5}, vec3{0.0, -1.0, -1.0}};
+
+    int const n = 40000;
+    color mean_spectral{0.0}, mean{0.0};
+    for (int ii = 0; ii < n; ++ii) {
+        mean_spectral += spectral_ray_color(ray, world, scene, 4) / n;
+        mean += ray_color(ray, world, scene, 4) / n;
+    }
+    for (int c = 0; c < 3; ++c)
+        EXPECT_THAT(mean_spectral[c], DoubleNear(mean[c], 0.05 * mean[c]));
+}
+
+TEST_F(AFloorBelowALight, keeps_the_light_through_dispersive_glass) {
+    // a dispersive sphere between the floor and the viewer
+    HittableList world{floor};
+    world.add(light(1.0));
+    auto const lights = HittableList{world.objects.back()};
+    world.add(std::make_shared<Sphere>(point3{0.0, 0.3, 0.3}, 0.2, std::make_shared<dielectric>(1.5, 0.02)));
+    auto const scene = scene_of(world, color{0.0}, lights);
+    Ray const ray{point3{0.0, 0.5, 0.5}, vec3{0.0, -1.0, -1.0}};
+
+    HittableList plain_world{floor};
+    plain_world.add(lights.objects.front());
+    plain_world.add(std::make_shared<Sphere>(point3{0.0, 0.3, 0.3}, 0.2, std::make_shared<dielectric>(1.5)));
+    auto const plain_scene = scene_of(plain_world, color{0.0}, lights);
+
+    int const n = 40000;
+    double mean_dispersive = 0.0, mean = 0.0;
+    for (int ii = 0; ii < n; ++ii) {
+        mean_dispersive += luminance(spectral_ray_color(ray, world, scene, 8)) / n;
+        mean += luminance(ray_color(ray, plain_world, plain_scene, 8)) / n;
+    }
+    EXPECT_THAT(mean_dispersive, DoubleNear(mean, 0.05 * mean));
+}
+
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
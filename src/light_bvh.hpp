@@ -0,0 +1,295 @@
+#pragma once
+
+#include <aabb.hpp>
+#include <common.hpp>
+#include <hit.hpp>
+#include <hittable_list.hpp>
+#include <material.hpp>
+#include <vec3.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Cone of directions within the angle theta around `axis`. The default
+// holds all directions.
+struct DirectionCone {
+    vec3 axis{0.0, 0.0, 1.0};
+    double cos_theta{-1.0};
+};
+
+namespace ns_light_bvh {
+    inline double sin_from_cos(double const cos) { return std::sqrt(std::max(0.0, 1.0 - cos * cos)); }
+
+    // cos(max(a - b, 0)) and sin(max(a - b, 0)) of angles given by sine and cosine
+    inline double cos_difference_clamped(double const sin_a, double const cos_a, double const sin_b, double const cos_b) {
+        return cos_a > cos_b ? 1.0 : cos_a * cos_b + sin_a * sin_b;
+    }
+    inline double sin_difference_clamped(double const sin_a, double const cos_a, double const sin_b, double const cos_b) {
+        return cos_a > cos_b ? 0.0 : sin_a * cos_b - cos_a * sin_b;
+    }
+
+    // `v` rotated by `angle` around the unit vector `axis` (Rodrigues)
+    inline vec3 rotate(vec3 const & v, vec3 const & axis, double const angle) {
+        return std::cos(angle) * v + std::sin(angle) * cross(axis, v) + (1.0 - std::cos(angle)) * dot(axis, v) * axis;
+    }
+
+    // smallest cone around both `a` and `b`
+    inline DirectionCone merge(DirectionCone const & a, DirectionCone const & b) {
+        auto const theta_a = std::acos(std::clamp(a.cos_theta, -1.0, 1.0));
+        auto const theta_b = std::acos(std::clamp(b.cos_theta, -1.0, 1.0));
+        auto const theta_d = std::acos(std::clamp(dot(a.axis, b.axis), -1.0, 1.0));
+        if (std::min(theta_d + theta_b, pi) <= theta_a)
+            return a;
+        if (std::min(theta_d + theta_a, pi) <= theta_b)
+            return b;
+
+        auto const theta = 0.5 * (theta_a + theta_d + theta_b);
+        auto const rotation_axis = cross(a.axis, b.axis);
+        if (theta >= pi || rotation_axis.length_squared() == 0.0)
+            return DirectionCone{};
+        return DirectionCone{rotate(a.axis, unit_vector(rotation_axis), theta - theta_a), std::cos(theta)};
+    }
+
+    inline double brightness(color const & c) { return (c.x + c.y + c.z) / 3.0; }
+}
+
+// What the light hierarchy knows about the emitters below a node. The
+// emitters of this renderer are diffuse and two-sided, they emit up to 90
+// degrees around either side of their normals.
+struct LightBounds {
+    Aabb box;
+    double power;            // emitted brightness times area
+    DirectionCone normals;
+
+    // Estimated light from the emitters reaching `p`, up to a common factor
+    // (Conty Estevez and Kulla, "Importance Sampling of Many Lights with
+    // Adaptive Tree Splitting"): the power over the squared distance, times
+    // a bound of the cosine at the emitters.
+    double importance(point3 const & p) const {
+        point3 const center = 0.5 * (box.min() + box.max());
+        auto const half_diagonal = 0.5 * (box.max() - box.min());
+        auto const distance_squared = std::max((p - center).length_squared(), half_diagonal.length_squared());
+        // inside the bounding sphere, all directions may reach p
+        if ((p - center).length_squared() <= half_diagonal.length_squared())
+            return power / distance_squared;
+
+        // normals to p, from the axis of the cone of normals, with both sides emitting
+        vec3 const to_p = unit_vector(p - center);
+        auto const cos_w = std::abs(dot(normals.axis, to_p));
+        auto const sin_w = ns_light_bvh::sin_from_cos(cos_w);
+
+        // minus the angles of the cone and of the bounding sphere seen from p
+        auto const cos_b = std::sqrt(1.0 - half_diagonal.length_squared() / (p - center).length_squared());
+        auto const sin_b = ns_light_bvh::sin_from_cos(cos_b);
+        auto const cos_o = normals.cos_theta;
+        auto const sin_o = ns_light_bvh::sin_from_cos(cos_o);
+        auto const cos_x = ns_light_bvh::cos_difference_clamped(sin_w, cos_w, sin_o, cos_o);
+        auto const sin_x = ns_light_bvh::sin_difference_clamped(sin_w, cos_w, sin_o, cos_o);
+        auto const cos_bound = ns_light_bvh::cos_difference_clamped(sin_x, cos_x, sin_b, cos_b);
+        if (cos_bound <= 0.0)
+            return 0.0;
+        return power * cos_bound / distance_squared;
+    }
+
+    // estimated from samples of the surface of `light`
+    static LightBounds of(HittableI const & light);
+    static LightBounds merge(LightBounds const & a, LightBounds const & b) {
+        return LightBounds{surrounding_box(a.box, b.box), a.power + b.power, ns_light_bvh::merge(a.normals, b.normals)};
+    }
+};
+
+inline LightBounds LightBounds::of(HittableI const & light) {
+    static constexpr int samples = 16;
+    LightBounds result{light.bounding_box(TimeInterval{0.0, 1.0}), 0.0, DirectionCone{}};
+    bool planar = true;
+    for (int ii = 0; ii < samples; ++ii) {
+        auto const sample = light.sample_surface();
+        if (sample.pdf <= 0.0)
+            return result;
+        auto const emitted = sample.record.material_ptr->scatter(Ray{sample.record.p, sample.record.normal}, sample.record).emitted;
+        result.power += ns_light_bvh::brightness(emitted) / sample.pdf / samples;
+        if (ii == 0)
+            result.normals = DirectionCone{unit_vector(sample.record.normal), 1.0};
+        planar = planar && dot(result.normals.axis, unit_vector(sample.record.normal)) > 1.0 - 1e-9;
+    }
+    if (!planar)
+        result.normals = DirectionCone{};
+    return result;
+}
+
+// The emitters of a scene in a bounding volume hierarchy of LightBounds, to
+// sample one of many lights by its estimated contribution. Sampling descends
+// from the root, choosing between the children in proportion to their
+// importance for the reference point, and the pdf retraces that path, so
+// both take time logarithmic in the number of lights. Without a reference
+// point, lights are chosen by their power.
+//
+// `objects` must not change after construction.
+struct LightBvh : HittableList {
+    LightBvh() = default;
+    LightBvh(HittableList const & lights);
+
+    // HittableI
+    SurfaceSample sample_surface() const override;
+    double surface_pdf(HitRecord const & rec) const override;
+    SurfaceSample sample_surface_from(point3 const & reference) const override;
+    double surface_pdf_from(point3 const & reference, HitRecord const & rec) const override;
+
+    bool contains(HittableI const * object) const { return trails_.count(object) > 0; }
+
+    // probability of choosing the light `object` for `reference`
+    double pmf(point3 const & reference, HittableI const * object) const;
+
+private:
+    struct Node {
+        LightBounds bounds;
+        std::uint32_t child_or_light;  // index of the second child, the first follows the node
+        bool leaf;
+    };
+
+    std::uint32_t build(std::vector<std::uint32_t>::iterator first,
+                        std::vector<std::uint32_t>::iterator last,
+                        std::vector<LightBounds> const & bounds,
+                        std::uint64_t trail,
+                        int depth);
+
+    template <typename Importance>
+    std::optional<std::pair<std::uint32_t, double>> select(Importance const & importance) const;
+
+    template <typename Importance>
+    double retrace(HittableI const * object, Importance const & importance) const;
+
+    std::vector<Node> nodes_;
+    // per light, the branches from the root to its leaf, the first in the lowest bit
+    std::unordered_map<HittableI const *, std::uint64_t> trails_;
+};
+
+inline LightBvh::LightBvh(HittableList const & lights) : HittableList{lights} {
+    // lights that emit nothing are never chosen
+    std::vector<LightBounds> bounds;
+    std::vector<std::uint32_t> indices;
+    for (std::uint32_t ii = 0; ii < objects.size(); ++ii) {
+        bounds.push_back(LightBounds::of(*objects[ii]));
+        if (bounds.back().power > 0.0)
+            indices.push_back(ii);
+    }
+    if (!indices.empty())
+        build(std::begin(indices), std::end(indices), bounds, 0, 0);
+}
+
+inline std::uint32_t LightBvh::build(std::vector<std::uint32_t>::iterator const first,
+                                     std::vector<std::uint32_t>::iterator const last,
+                                     std::vector<LightBounds> const & bounds,
+                                     std::uint64_t const trail,
+                                     int const depth) {
+    auto const index = static_cast<std::uint32_t>(nodes_.size());
+    if (last - first == 1) {
+        nodes_.push_back(Node{bounds[*first], *first, true});
+        trails_[objects[*first].get()] = trail;
+        return index;
+    }
+
+    // split at the median along the longest axis of the box centers
+    auto const center = [&bounds](std::uint32_t const light) {
+        return 0.5 * (bounds[light].box.min() + bounds[light].box.max());
+    };
+    vec3 low = center(*first), high = low;
+    for (auto it = first; it != last; ++it)
+        for (std::size_t axis = 0; axis < 3; ++axis) {
+            low[axis] = std::min(low[axis], center(*it)[axis]);
+            high[axis] = std::max(high[axis], center(*it)[axis]);
+        }
+    auto const extent = high - low;
+    auto const axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+    auto const middle = first + (last - first) / 2;
+    std::nth_element(first, middle, last, [&center, axis](std::uint32_t const a, std::uint32_t const b) {
+        return center(a)[axis] < center(b)[axis];
+    });
+
+    nodes_.push_back(Node{bounds[*first], 0, false});  // completed below
+    build(first, middle, bounds, trail, depth + 1);
+    auto const second = build(middle, last, bounds, trail | (std::uint64_t{1} << depth), depth + 1);
+    nodes_[index] = Node{LightBounds::merge(nodes_[index + 1].bounds, nodes_[second].bounds), second, false};
+    return index;
+}
+
+template <typename Importance>
+std::optional<std::pair<std::uint32_t, double>> LightBvh::select(Importance const & importance) const {
+    if (nodes_.empty())
+        return std::nullopt;
+    double pmf = 1.0;
+    std::uint32_t index = 0;
+    while (!nodes_[index].leaf) {
+        auto const first = importance(nodes_[index + 1].bounds);
+        auto const second = importance(nodes_[nodes_[index].child_or_light].bounds);
+        if (first + second <= 0.0)
+            return std::nullopt;
+        auto const p_first = first / (first + second);
+        bool const take_first = random_double() < p_first;
+        pmf *= take_first ? p_first : 1.0 - p_first;
+        index = take_first ? index + 1 : nodes_[index].child_or_light;
+    }
+    if (importance(nodes_[index].bounds) <= 0.0)
+        return std::nullopt;
+    return std::pair{nodes_[index].child_or_light, pmf};
+}
+
+template <typename Importance>
+double LightBvh::retrace(HittableI const * const object, Importance const & importance) const {
+    auto const trail = trails_.find(object);
+    if (trail == std::end(trails_))
+        return 0.0;
+    double pmf = 1.0;
+    std::uint32_t index = 0;
+    for (int depth = 0; !nodes_[index].leaf; ++depth) {
+        auto const first = importance(nodes_[index + 1].bounds);
+        auto const second = importance(nodes_[nodes_[index].child_or_light].bounds);
+        if (first + second <= 0.0)
+            return 0.0;
+        bool const take_first = ((trail->second >> depth) & 1) == 0;
+        pmf *= (take_first ? first : second) / (first + second);
+        index = take_first ? index + 1 : nodes_[index].child_or_light;
+    }
+    return importance(nodes_[index].bounds) > 0.0 ? pmf : 0.0;
+}
+
+inline double LightBvh::pmf(point3 const & reference, HittableI const * const object) const {
+    return retrace(object, [&reference](LightBounds const & bounds) { return bounds.importance(reference); });
+}
+
+inline SurfaceSample LightBvh::sample_surface() const {
+    auto const selected = select([](LightBounds const & bounds) { return bounds.power; });
+    if (!selected)
+        return HittableI::sample_surface();
+    auto sample = objects[selected->first]->sample_surface();
+    sample.pdf *= selected->second;
+    return sample;
+}
+
+inline double LightBvh::surface_pdf(HitRecord const & rec) const {
+    auto const pmf = retrace(rec.object, [](LightBounds const & bounds) { return bounds.power; });
+    if (pmf <= 0.0)
+        return 0.0;
+    return pmf * rec.object->surface_pdf(rec);
+}
+
+inline SurfaceSample LightBvh::sample_surface_from(point3 const & reference) const {
+    auto const selected = select([&reference](LightBounds const & bounds) { return bounds.importance(reference); });
+    if (!selected)
+        return HittableI::sample_surface();
+    auto sample = objects[selected->first]->sample_surface_from(reference);
+    sample.pdf *= selected->second;
+    return sample;
+}
+
+inline double LightBvh::surface_pdf_from(point3 const & reference, HitRecord const & rec) const {
+    auto const pmf = this->pmf(reference, rec.object);
+    if (pmf <= 0.0)
+        return 0.0;
+    return pmf * rec.object->surface_pdf_from(reference, rec);
+}
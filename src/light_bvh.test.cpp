@@ -0,0 +1,134 @@
+#include <light_bvh.hpp>
+
+#include <hittable_list.hpp>
+#include <material.hpp>
+#include <quad.hpp>
+#include <sphere.hpp>
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <cmath>
+#include <map>
+#include <memory>
+
+
+using testing::DoubleNear;
+using testing::Eq;
+using testing::Gt;
+using testing::Lt;
+using testing::Test;
+
+
+TEST(ADirectionCone, merges_to_a_cone_around_both) {
+    DirectionCone const a{vec3{1.0, 0.0, 0.0}, std::cos(0.1)};
+    DirectionCone const b{vec3{0.0, 1.0, 0.0}, std::cos(0.2)};
+    auto const merged = ns_light_bvh::merge(a, b);
+    EXPECT_THAT(merged.cos_theta, DoubleNear(std::cos(0.5 * (0.1 + pi / 2.0 + 0.2)), 1e-12));
+    // the outermost directions of both cones are on the boundary
+    EXPECT_THAT(dot(merged.axis, vec3{std::cos(-0.1), std::sin(-0.1), 0.0}), DoubleNear(merged.cos_theta, 1e-12));
+    EXPECT_THAT(dot(merged.axis, vec3{std::sin(-0.2), std::cos(-0.2), 0.0}), DoubleNear(merged.cos_theta, 1e-12));
+}
+
+TEST(ADirectionCone, merges_opposite_directions_to_the_sphere) {
+    auto const merged = ns_light_bvh::merge(DirectionCone{vec3{1.0, 0.0, 0.0}, 1.0}, DirectionCone{vec3{-1.0, 0.0, 0.0}, 1.0});
+    EXPECT_THAT(merged.cos_theta, Eq(-1.0));
+}
+
+
+struct ALightBvh : Test {
+public:
+    ALightBvh() {
+        // a row of quads facing down, brighter to the right
+        for (int ii = 0; ii < 20; ++ii)
+            lights.add(std::make_shared<Quad>(point3{2.0 * ii, 1.0, 0.0}, vec3{1.0, 0.0, 0.0}, vec3{0.0, 0.0, 1.0},
+                                              std::make_shared<DiffuseLight>(color{1.0 + ii})));
+        lights.add(std::make_shared<Sphere>(point3{0.0, 5.0, 0.0}, 1.0, std::make_shared<DiffuseLight>(color{4.0})));
+    }
+
+    HittableList lights;
+};
+
+TEST_F(ALightBvh, chooses_every_light_with_a_total_probability_of_one) {
+    LightBvh const bvh{lights};
+    for (auto const & reference : {point3{0.0, 0.0, 0.0}, point3{17.0, -3.0, 2.0}, point3{0.5, 1.0, 0.5}}) {
+        double sum = 0.0;
+        for (auto const & light : lights.objects)
+            sum += bvh.pmf(reference, light.get());
+        EXPECT_THAT(sum, DoubleNear(1.0, 1e-12));
+    }
+}
+
+TEST_F(ALightBvh, chooses_lights_according_to_its_pmf) {
+    LightBvh const bvh{lights};
+    point3 const reference{10.0, 0.0, 0.5};
+    int const n = 100000;
+    std::map<HittableI const *, double> frequencies;
+    for (int ii = 0; ii < n; ++ii)
+        frequencies[bvh.sample_surface_from(reference).record.object] += 1.0 / n;
+    for (auto const & light : lights.objects)
+        EXPECT_THAT(frequencies[light.get()], DoubleNear(bvh.pmf(reference, light.get()), 0.01));
+}
+
+TEST_F(ALightBvh, prefers_near_lights) {
+    LightBvh const bvh{lights};
+    point3 const reference{0.5, 0.0, 0.5};
+    EXPECT_THAT(bvh.pmf(reference, lights.objects[0].get()), Gt(10.0 * bvh.pmf(reference, lights.objects[19].get())));
+}
+
+TEST_F(ALightBvh, estimates_little_light_from_emitters_seen_edge_on) {
+    // only the angle of the bounding sphere around the quad is left
+    auto const bounds = LightBounds::of(*lights.objects[0]);
+    EXPECT_THAT(bounds.importance(point3{-20.0, 1.0, 0.5}), Lt(0.05 * bounds.importance(point3{0.5, -20.0, 0.5})));
+    EXPECT_THAT(bounds.importance(point3{0.5, 21.0, 0.5}), DoubleNear(bounds.importance(point3{0.5, -19.0, 0.5}), 1e-12));
+}
+
+TEST_F(ALightBvh, returns_the_pdf_of_its_samples) {
+    LightBvh const bvh{lights};
+    point3 const reference{3.0, -2.0, 0.0};
+    for (int ii = 0; ii < 100; ++ii) {
+        auto const sample = bvh.sample_surface_from(reference);
+        ASSERT_THAT(sample.pdf, Gt(0.0));
+        EXPECT_THAT(bvh.surface_pdf_from(reference, sample.record), DoubleNear(sample.pdf, 1e-9 * sample.pdf));
+    }
+}
+
+TEST_F(ALightBvh, chooses_by_power_without_a_reference) {
+    LightBvh const bvh{lights};
+    int const n = 100000;
+    int brightest = 0, darkest = 0;
+    for (int ii = 0; ii < n; ++ii) {
+        auto const object = bvh.sample_surface().record.object;
+        brightest += object == lights.objects[19].get();
+        darkest += object == lights.objects[0].get();
+    }
+    EXPECT_THAT(static_cast<double>(brightest) / darkest, DoubleNear(20.0, 2.0));
+}
+
+TEST_F(ALightBvh, returns_the_pdf_of_its_samples_without_a_reference) {
+    LightBvh const bvh{lights};
+    for (int ii = 0; ii < 100; ++ii) {
+        auto const sample = bvh.sample_surface();
+        ASSERT_THAT(sample.pdf, Gt(0.0));
+        EXPECT_THAT(bvh.surface_pdf(sample.record), DoubleNear(sample.pdf, 1e-9 * sample.pdf));
+    }
+}
+
+TEST_F(ALightBvh, contains_its_lights_only) {
+    LightBvh const bvh{lights};
+    EXPECT_TRUE(bvh.contains(lights.objects.front().get()));
+    Sphere const other{point3{0.0}, 1.0};
+    EXPECT_FALSE(bvh.contains(&other));
+}
+
+TEST(AnEmptyLightBvh, samples_nothing) {
+    LightBvh const bvh{HittableList{}};
+    EXPECT_THAT(bvh.sample_surface_from(point3{0.0}).pdf, Eq(0.0));
+    EXPECT_THAT(bvh.sample_surface().pdf, Eq(0.0));
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
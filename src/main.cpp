@@ -1,124 +1,449 @@
+#include <adaptive_sampling.hpp>
+#include <bdpt.hpp>
 #include <bvh.hpp>
 #include <color.hpp>
 #include <counter.hpp>
+#include <denoiser.hpp>
+#include <filter.hpp>
+#include <guiding.hpp>
+#include <integrator.hpp>
+#include <metropolis.hpp>
+#include <photon_map.hpp>
+#include <progressive.hpp>
+#include <radiance_cache.hpp>
+#include <sampler.hpp>
 #include <ray.hpp>
 #include <scenes.hpp>
 #include <vec3.hpp>
+#include <wavefront.hpp>
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
 #include <iostream>
 #include <memory>
+#include <optional>
 #include <thread>
 
 
 auto const aspect_ratio = AspectRatio{3.0 / 2.0};
 
+// `path` traces one path at a time per thread, `wavefront` all paths of a row
+// at once, `bidirectional` connects camera and light subpaths, which finds
+// light that arrives through small or hidden openings, e.g. in cornell_box,
+// and `metropolis` mutates the random numbers of the paths of `path` in
+// Markov chains, which keep exploring light that arrives through rare paths
+// once they have found it, e.g. in final_scene. It runs
+// `samples_per_pixel` mutations per pixel on average. `spectral` traces
+// paths for four wavelengths at once, which shows the dispersion of glass.
+enum class Engine { path, wavefront, bidirectional, metropolis, spectral };
+auto const engine = Engine::path;
 
-color ray_color(Ray const & r,
-                HittableI const & world,
-                int depth,
-                BackgroundFunction const & background_color) {
-    if (depth <= 0)
-        return color{0.0, 0.0, 0.0};
-
-    HitRecord rec = world.hit(r, 1e-3, infinity);
-    if (rec) {
-        auto const scatter_info = rec.material_ptr->scatter(r, rec);
-        if (scatter_info)
-            return scatter_info.emitted + scatter_info.attenuation * ray_color(scatter_info.scattered_ray,
-                                                                               world,
-                                                                               depth - 1,
-                                                                               background_color);
-        return scatter_info.emitted;
-    }
+// pixels per packet of camera rays in the `path` engine
+std::size_t const packet_width = 64;
+
+// Images with fewer rows than `tasks_per_thread` per thread are rendered in
+// tasks of a share of the samples of a row, so that small previews with many
+// samples per pixel keep all cores busy until the end.
+std::size_t const tasks_per_thread = 8;
+
+// The `path` engine stops sampling pixels whose error, in units of the gamma
+// corrected output, falls below this target and spends their share of the
+// samples on noisier pixels of the row. With 0, every pixel gets
+// `samples_per_pixel` samples.
+double const target_display_error = 0.02;
+// most samples the `path` engine spends on a pixel, in units of `samples_per_pixel`
+int const max_adaptive_samples = 4;
+
+
+// Progressive rendering accumulates passes of `samples_per_pass` samples
+// over the whole image. It stops after `samples_per_pixel` samples or before
+// a pass that would end after `time_budget`, measured from the start of the
+// program, and writes the image accumulated so far.
+bool const progressive = false;
+auto const time_budget = std::chrono::seconds{10};
+std::size_t const samples_per_pass = 4;
+
+// source of the random numbers of the paths of the `path` engine; the
+// other engines always draw independent numbers
+auto const sampler_type = SamplerType::sobol;
+
+// Reconstruction filter of the pixels. The camera rays of a pixel are
+// distributed like it around the pixel center and weighted with its sign,
+// so that each sample stays in its pixel; `box` jitters them within the
+// pixel. The Gaussian is the smoothest, Mitchell the sharpest. Both are
+// noisier than `box` at the same number of samples per pixel.
+auto const filter_type = FilterType::box;
+
+
+// Denoises the image with the first-hit features collected by the `path`
+// engine, so that few samples per pixel suffice. Blurs detail that the
+// features miss, so the default output stays the path traced estimate.
+bool const denoise = false;
+
+
+// Learns where indirect light comes from while the `path` engine renders,
+// in passes of 1, 2, 4, ... samples per pixel, and samples half of the
+// scattered directions accordingly. Each pass uses what the previous ones
+// learned. It pays off where light arrives through few, narrow paths; in the
+// bundled scenes the light samples find most of it already.
+bool const path_guiding = false;
+
+
+// Estimates the caustics of the `path` engine from photons that the lights
+// cast through specular surfaces, gathered within `caustic_radius`. Trades
+// a bias that grows with the radius and the time to trace the photons
+// before the first pixel for less noise in the caustics.
+bool const caustic_photons = false;
+std::size_t const number_of_caustic_photons = 1000000;
+double const caustic_radius = 4.0;
+
+
+// Ends the paths of the `path` engine in a cache of the light reflected by
+// diffuse surfaces, averaged over cells of `radiance_cache_cell_size`, which
+// a share of the paths keeps training. Trades a bias that grows with the
+// cells for shorter paths. Renders in passes of 1, 2, 4, ... samples per
+// pixel like `path_guiding`, so that the first ones fill the cache.
+bool const radiance_caching = false;
+double const radiance_cache_cell_size = 10.0;
 
-    // background
-    return background_color(r);
-}
 
 std::mutex CERR_MUTEX;
+std::mutex RESULT_MUTEX;
 
-void render_rows(Counter& rows,
+// adds the first hit `rec` of a camera ray to the sums of the feature buffers
+void add_features(Ray const & ray, HitRecord const & rec, Scene const & scene,
+                  color & albedo, vec3 & normal, double & depth) {
+    if (!rec) {
+        albedo += scene.background_color(ray);
+        return;
+    }
+    auto const scatter_info = rec.material_ptr->scatter(ray, rec);
+    albedo += scatter_info ? scatter_info.attenuation : scatter_info.emitted;
+    if (rec.side != FaceSide::medium)
+        normal += rec.normal;
+    depth += rec.t * ray.d.length();
+}
+
+void render_rows(RowSampleTasks& tasks,
                  int const image_height,
                  int const image_width,
                  int const samples_per_pixel,
                  int const max_depth,
                  Scene const scene,
-                 std::vector<std::vector<color>>& result_image) {
+                 std::vector<std::vector<color>>& result_image,
+                 std::vector<std::vector<std::uint32_t>>& sample_indices,
+                 FeatureBuffers * features,
+                 PathGuide * guide,
+                 RadianceCache * cache,
+                 SplatFilm& film) {
         auto const world = BvhNode(scene.world, TimeInterval{0.0, 1.0});
         auto const camera = scene.camera;
+        WavefrontIntegrator wavefront{world, scene, max_depth};
+        BidirectionalIntegrator bidirectional{world, scene, max_depth, film};
+        FilterSampler const filter{*make_filter(filter_type)};
+        std::vector<Ray> rays;
+        std::vector<double> weights;  // filter weights of `rays` or of the rays in `packet`
+        RayPacket packet;
+        std::vector<int> pixels;  // of the rays in `packet`
+        auto const sampler = make_sampler(sampler_type, samples_per_pixel);
+        // sums over the samples of the pixels of a row, collected for `features`
+        std::vector<color> albedos(image_width);
+        std::vector<vec3> normals(image_width);
+        std::vector<double> depths(image_width);
+        // sums over the samples of a task, added to `result_image` at its end
+        std::vector<color> row_sums(image_width);
+        // of the next sample of every pixel of a task
+        std::vector<std::uint32_t> indices(image_width);
 
-        while(auto next_row = rows.next())
+        while(auto next_task = tasks.next())
         {
-            int j = image_height - static_cast<int>(next_row.value()) - 1;
+            auto const row = next_task->row;
+            int const samples = static_cast<int>(next_task->samples);
+            int j = image_height - static_cast<int>(row) - 1;
 
-            {
+            if (next_task->share == 0) {
                 std::lock_guard lock{CERR_MUTEX};
                 std::cerr << "\rScanlines remaining: " << j << ' ' << std::flush;
             }
 
-            for (int i = 0; i < image_width; ++i)
-            {
-                color pixel_color{0.0, 0.0, 0.0};
-                for (int s = 0; s < samples_per_pixel; ++s) {
-                    auto w = (i + random_double()) / (image_width - 1);
-                    auto h = (j + random_double()) / (image_height - 1);
-                    Ray r = camera.get_ray(w, h);
-                    pixel_color += ray_color(r, world, max_depth, scene.background_color);
+            if (engine == Engine::wavefront) {
+                rays.clear();
+                weights.clear();
+                for (int i = 0; i < image_width; ++i)
+                    for (int s = 0; s < samples; ++s) {
+                        auto const offset = filter.sample(random_2d());
+                        auto w = (i + 0.5 + offset.x) / (image_width - 1);
+                        auto h = (j + 0.5 + offset.y) / (image_height - 1);
+                        rays.push_back(camera.get_ray(w, h));
+                        weights.push_back(offset.weight);
+                    }
+
+                auto const & estimates = wavefront.trace(rays);
+                for (int i = 0; i < image_width; ++i) {
+                    color pixel_color{0.0, 0.0, 0.0};
+                    for (int s = 0; s < samples; ++s)
+                        pixel_color += weights[i * samples + s] * estimates[i * samples + s];
+                    row_sums[i] = pixel_color;
+                }
+            }
+
+            else if (engine == Engine::bidirectional) {
+                for (int i = 0; i < image_width; ++i) {
+                    color pixel_color{0.0, 0.0, 0.0};
+                    for (int s = 0; s < samples; ++s) {
+                        auto const offset = filter.sample(random_2d());
+                        auto w = (i + 0.5 + offset.x) / (image_width - 1);
+                        auto h = (j + 0.5 + offset.y) / (image_height - 1);
+                        pixel_color += offset.weight * bidirectional.sample(camera.get_ray(w, h));
+                    }
+                    row_sums[i] = pixel_color;
+                }
+            }
+
+            else if (engine == Engine::spectral) {
+                for (int i = 0; i < image_width; ++i) {
+                    color pixel_color{0.0, 0.0, 0.0};
+                    for (int s = 0; s < samples; ++s) {
+                        auto const offset = filter.sample(random_2d());
+                        auto w = (i + 0.5 + offset.x) / (image_width - 1);
+                        auto h = (j + 0.5 + offset.y) / (image_height - 1);
+                        pixel_color += offset.weight * spectral_ray_color(camera.get_ray(w, h), world, scene, max_depth);
+                    }
+                    row_sums[i] = pixel_color;
+                }
+            }
+
+            else {
+                // Passes of one sample for every pixel the sampler keeps active. The
+                // camera rays of up to `packet_width` active pixels traverse the BVH together.
+                // The paths draw their random numbers from `sampler`, which is
+                // restarted after the camera ray for the rest of a path. The
+                // packet traversal, e.g. the free flights through media, and
+                // the features draw independent numbers outside its scope, so
+                // that they do not reuse the dimensions of a pixel sample. The
+                // shares of a row take disjoint ranges of sample indices, of
+                // the most samples the adaptive sampler may spend on a share.
+                // Their mean has the target error if each share has the
+                // target error times the square root of their number.
+                AdaptiveSampler adaptive{AdaptiveSamplingSettings{std::min(16, samples),
+                                                                  max_adaptive_samples * static_cast<int>(tasks.max_samples()),
+                                                                  target_display_error * std::sqrt(tasks.shares_per_row())}};
+                auto const first_index = static_cast<std::uint32_t>(next_task->share * max_adaptive_samples * tasks.max_samples());
+                for (int i = 0; i < image_width; ++i)
+                    indices[i] = sample_indices[row][i] + first_index;
+                adaptive.reset(image_width, static_cast<long>(image_width) * samples);
+                if (features) {
+                    std::fill(std::begin(albedos), std::end(albedos), color{0.0, 0.0, 0.0});
+                    std::fill(std::begin(normals), std::end(normals), vec3{0.0, 0.0, 0.0});
+                    std::fill(std::begin(depths), std::end(depths), 0.0);
                 }
+                while (!adaptive.done())
+                    for (int i = 0; i < image_width;) {
+                        packet.clear();
+                        pixels.clear();
+                        weights.clear();
+                        for (; i < image_width && pixels.size() < packet_width; ++i)
+                            if (adaptive.active(i)) {
+                                ScopedRandomSource const source{*sampler};
+                                sampler->start_pixel_sample(i, j, indices[i]);
+                                auto const offset = filter.sample(random_2d());
+                                auto w = (i + 0.5 + offset.x) / (image_width - 1);
+                                auto h = (j + 0.5 + offset.y) / (image_height - 1);
+                                packet.add(camera.get_ray(w, h));
+                                pixels.push_back(i);
+                                weights.push_back(offset.weight);
+                            }
+                        if (pixels.empty())
+                            continue;
+                        packet.prepare();
+                        world.hit_packet(packet);
 
-                result_image[next_row.value()][i] = pixel_color;
+                        for (std::size_t k = 0; k < pixels.size(); ++k) {
+                            if (features)
+                                add_features(packet.rays[k], packet.hits[k], scene, albedos[pixels[k]], normals[pixels[k]], depths[pixels[k]]);
+                            ScopedRandomSource const source{*sampler};
+                            sampler->start_pixel_sample(pixels[k], j, indices[pixels[k]]++, 1 + Camera::random_dimensions);
+                            adaptive.add(pixels[k], weights[k] * ray_color(packet.rays[k], packet.hits[k], world, scene, max_depth, guide, cache));
+                        }
+                    }
+
+                // scaled to the sum of the samples of the task; the features
+                // are those of the first share of the row
+                for (int i = 0; i < image_width; ++i) {
+                    row_sums[i] = adaptive.estimate(i).mean() * samples;
+                    if (!features || next_task->share != 0)
+                        continue;
+                    auto const pixel = row * image_width + i;
+                    auto const count = std::max(adaptive.estimate(i).count(), 1);
+                    features->albedo[pixel] = albedos[i] / count;
+                    features->normal[pixel] = normals[i] / count;
+                    features->depth[pixel] = depths[i] / count;
+                }
+                // a whole row continues its sequence of samples
+                if (tasks.shares_per_row() == 1)
+                    std::copy(std::begin(indices), std::end(indices), std::begin(sample_indices[row]));
             }
+
+            std::lock_guard lock{RESULT_MUTEX};
+            for (int i = 0; i < image_width; ++i)
+                result_image[row][i] += row_sums[i];
         }
 }
 
 
+// renders `samples_per_pixel` samples of every pixel into `result`, on all cores
+void render(Scene const & scene,
+            std::size_t const image_height,
+            std::size_t const image_width,
+            std::size_t const samples_per_pixel,
+            std::size_t const max_depth,
+            std::vector<std::vector<color>>& result,
+            std::vector<std::vector<std::uint32_t>>& sample_indices,
+            FeatureBuffers * features,
+            PathGuide * guide,
+            RadianceCache * cache) {
+    auto const number_of_threads = std::max(2u, std::thread::hardware_concurrency());
+    RowSampleTasks tasks{image_height,
+                         samples_per_pixel,
+                         RowSampleTasks::shares_per_row(image_height, samples_per_pixel, number_of_threads, tasks_per_thread)};
+    for (auto & row : result)
+        std::fill(std::begin(row), std::end(row), color{0.0, 0.0, 0.0});
+    // light tracing of the `bidirectional` engine
+    SplatFilm film{image_width, image_height};
+    std::vector<std::thread> threads(number_of_threads - 1);
+    for (auto & thread : threads)
+        thread = std::thread{render_rows,
+                             std::ref(tasks),
+                             image_height,
+                             image_width,
+                             samples_per_pixel,
+                             max_depth,
+                             scene,
+                             std::ref(result),
+                             std::ref(sample_indices),
+                             features,
+                             guide,
+                             cache,
+                             std::ref(film)};
+    render_rows(tasks,
+                image_height,
+                image_width,
+                samples_per_pixel,
+                max_depth,
+                scene,
+                std::ref(result),
+                sample_indices,
+                features,
+                guide,
+                cache,
+                film);
+
+    for (auto & thread : threads)
+        thread.join();
+
+    // past the sample indices of all shares of split rows
+    if (tasks.shares_per_row() > 1)
+        for (auto & row : sample_indices)
+            for (auto & index : row)
+                index += static_cast<std::uint32_t>(tasks.shares_per_row() * max_adaptive_samples * tasks.max_samples());
+
+    for (std::size_t j = 0; j < image_height; ++j)
+        for (std::size_t i = 0; i < image_width; ++i)
+            result[j][i] += film.pixel(i, image_height - 1 - j);
+}
+
+
 int main() {
+    auto const start = PassScheduler::Clock::now();
+
     // Image
     std::size_t const image_width = 300;
     std::size_t const image_height = static_cast<int>(image_width / aspect_ratio.value());
     std::size_t const samples_per_pixel = 50;
-    std::size_t const max_depth = 5;
+    std::size_t const max_depth = 50;
 
-    auto const scene = create_scene(SceneID::final_scene, aspect_ratio);
+    auto scene = create_scene(SceneID::final_scene, aspect_ratio);
+    // textures are filtered over the footprints of the pixels
+    scene.pixel_spread = scene.camera.pixel_spread(image_height);
+    if (caustic_photons && engine == Engine::path)
+        scene.caustics = std::make_shared<PhotonMap const>(trace_caustics(BvhNode(scene.world, TimeInterval{0.0, 1.0}),
+                                                                          scene.lights,
+                                                                          number_of_caustic_photons,
+                                                                          caustic_radius));
 
     std::vector<std::vector<color>> result(image_height, std::vector<color>(image_width));
+    // of the next sample of every pixel
+    std::vector<std::vector<std::uint32_t>> sample_indices(image_height, std::vector<std::uint32_t>(image_width, 0));
+    std::optional<FeatureBuffers> features;
+    if (denoise && engine == Engine::path)
+        features.emplace(image_width, image_height);
+    auto * const features_ptr = features ? &*features : nullptr;
+    std::optional<PathGuide> guide;
+    if (path_guiding && engine == Engine::path)
+        guide.emplace(scene.world.bounding_box(TimeInterval{0.0, 1.0}));
+    auto * const guide_ptr = guide ? &*guide : nullptr;
+    std::optional<RadianceCache> cache;
+    if (radiance_caching && engine == Engine::path)
+        cache.emplace(radiance_cache_cell_size);
+    auto * const cache_ptr = cache ? &*cache : nullptr;
 
     // Render
     std::cout << "P3\n" << image_width << ' ' << image_height << "\n255\n";
 
     if (true) {
-        Counter rows{image_height};
-        auto const number_of_threads = std::max(2u, std::thread::hardware_concurrency());
-        std::vector<std::thread> threads(number_of_threads - 1);
-        for (auto & thread : threads)
-            thread = std::thread{render_rows,
-                                 std::ref(rows),
-                                 image_height,
-                                 image_width,
-                                 samples_per_pixel,
-                                 max_depth,
-                                 scene,
-                                 std::ref(result)};
-        render_rows(rows,
-                    image_height,
-                    image_width,
-                    samples_per_pixel,
-                    max_depth,
-                    scene,
-                    std::ref(result));
-
-        for (auto & thread : threads)
-            thread.join();
+        std::size_t samples_taken = samples_per_pixel;
+        if (engine == Engine::metropolis) {
+            result = render_metropolis(BvhNode(scene.world, TimeInterval{0.0, 1.0}), scene, image_width, image_height, samples_per_pixel, max_depth);
+            // scaled to a sum of samples like those of `render`
+            for (auto & row : result)
+                for (auto & pixel : row)
+                    pixel = pixel * static_cast<double>(samples_taken);
+        }
+        else if (!progressive && !guide_ptr && !cache_ptr)
+            render(scene, image_height, image_width, samples_per_pixel, max_depth, result, sample_indices, features_ptr, nullptr, nullptr);
+        else {
+            // without `progressive`, all `samples_per_pixel` samples are rendered
+            std::chrono::seconds const budget = progressive ? time_budget : std::chrono::hours{24 * 365};
+            auto const deadline = start + budget;
+            PassScheduler scheduler = guide_ptr || cache_ptr ? PassScheduler{samples_per_pixel, 1, deadline, 2.0}
+                                                             : PassScheduler{samples_per_pixel, samples_per_pass, deadline};
+            std::vector<std::vector<color>> pass(image_height, std::vector<color>(image_width));
+            for (auto & row : result)
+                std::fill(std::begin(row), std::end(row), color{0.0, 0.0, 0.0});
+            while (auto const samples = scheduler.next_pass(PassScheduler::Clock::now())) {
+                render(scene, image_height, image_width, samples, max_depth, pass, sample_indices, features_ptr, guide_ptr, cache_ptr);
+                if (guide)
+                    guide->refine();
+                for (std::size_t j = 0; j < image_height; ++j)
+                    for (std::size_t i = 0; i < image_width; ++i)
+                        result[j][i] += pass[j][i];
+                scheduler.end_pass(PassScheduler::Clock::now());
+            }
+            samples_taken = scheduler.samples_taken();
+            std::cerr << "\nSamples per pixel: " << samples_taken;
+        }
 
+        std::vector<color> image;
         for (auto const & row : result)
-            for (auto const & pixel : row) {
-                write_color(std::cout,
-                            pixel,
-                            samples_per_pixel,
-                            ns_color::WritePretty{false},
-                            ns_color::GammaCorrection{true});
-                std::cout << " ";
-            }
+            for (auto const & pixel : row)
+                image.push_back(pixel / static_cast<double>(samples_taken));
+        if (features)
+            image = Denoiser{}(image, *features);
+        // spectral estimates of dark, saturated colors and the negative lobes
+        // of the filter can fall below zero
+        for (auto & pixel : image)
+            pixel = max_components(pixel, color{0.0, 0.0, 0.0});
+
+        for (auto const & pixel : image) {
+            write_color(std::cout,
+                        pixel,
+                        1,
+                        ns_color::WritePretty{false},
+                        ns_color::GammaCorrection{true});
+            std::cout << " ";
+        }
     }
     else {
         Perlin noise{};
@@ -151,5 +476,6 @@ int main() {
     }
 
 
-    std:: cerr << "\nDone.\n";
+    auto const seconds = std::chrono::duration<double>(PassScheduler::Clock::now() - start).count();
+    std:: cerr << "\nDone in " << seconds << " s.\n";
 }
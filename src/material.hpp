@@ -4,6 +4,9 @@
 #include <hit.hpp>
 #include <ray.hpp>
 
+#include <algorithm>
+#include <cmath>
+
 
 struct ScatterInfo {
     color attenuation;
@@ -29,6 +32,36 @@ struct ScatterInfo {
 
 struct MaterialI {
     virtual ScatterInfo scatter(Ray const & ray_in, HitRecord const & hit_rec) const = 0;
+
+    // `scatter` for light of a single `wavelength` in nm, which only
+    // dispersive materials depend on
+    virtual ScatterInfo scatter_wavelength(Ray const & ray_in, HitRecord const & hit_rec, double wavelength) const {
+        return scatter(ray_in, hit_rec);
+    }
+
+    // true for materials that scatter wavelengths into different directions
+    virtual bool is_dispersive() const { return false; }
+
+    // true for materials whose surfaces are lights
+    virtual bool is_emissive() const { return false; }
+
+    // Scattered radiance towards `wo` per unit of radiance arriving from `wi`
+    // and per solid angle, i.e. the BSDF times the cosine at the surface. Both
+    // directions point away from the hit point.
+    virtual color eval(HitRecord const & hit_rec, vec3 const & wi, vec3 const & wo) const { return color{0.0}; }
+
+    // Solid angle density of `scatter` choosing the direction `wi` for light
+    // leaving towards `wo`. Zero for discrete directions.
+    virtual double pdf(HitRecord const & hit_rec, vec3 const & wi, vec3 const & wo) const { return 0.0; }
+
+    // true for materials that scatter into discrete directions only, which
+    // cannot be lit by sampling points on lights
+    virtual bool is_specular() const { return true; }
+
+    // true for materials that reflect the same radiance into every direction,
+    // the cosine weighted incident radiance over pi times the attenuation of
+    // `scatter`
+    virtual bool is_diffuse() const { return false; }
 };
 
 //--------------------------------------------------------------------lambertian
@@ -45,10 +78,26 @@ public:
 
         ScatterInfo result{};
         result.scattered_ray = Ray{hit_rec.p, scatter_direction, ray_in.time()};
-        result.attenuation = albedo_->value(hit_rec.uv, hit_rec.p);
+        result.attenuation = albedo_->filtered_value(hit_rec.uv, hit_rec.p, hit_rec.texture_footprint());
         return result;
     }
 
+    color eval(HitRecord const & hit_rec, vec3 const & wi, vec3 const & wo) const override {
+        auto const cos_theta = dot(hit_rec.normal, unit_vector(wi));
+        if (cos_theta <= 0.0)
+            return color{0.0};
+        return cos_theta / pi * albedo_->filtered_value(hit_rec.uv, hit_rec.p, hit_rec.texture_footprint());
+    }
+
+    // cosine weighted, as normal + random_unit_vector()
+    double pdf(HitRecord const & hit_rec, vec3 const & wi, vec3 const & wo) const override {
+        return std::max(dot(hit_rec.normal, unit_vector(wi)), 0.0) / pi;
+    }
+
+    bool is_specular() const override { return false; }
+
+    bool is_diffuse() const override { return true; }
+
 private:
     std::shared_ptr<TextureI> albedo_;
 };
@@ -62,7 +111,7 @@ public:
 
     // MaterialI
     ScatterInfo scatter(Ray const & ray_in, HitRecord const & hit_rec) const override {
-        auto const scatter_direction = unit_vector(  reflect(ray_in.d, hit_rec.normal)
+        auto const scatter_direction = unit_vector(  reflect(unit_vector(ray_in.d), hit_rec.normal)
                                                    + fuzz_ * random_in_unit_sphere());
 
         ScatterInfo result{};
@@ -71,6 +120,31 @@ public:
         return result;
     }
 
+    // the attenuation of `scatter` is the albedo, hence eval = albedo * pdf
+    color eval(HitRecord const & hit_rec, vec3 const & wi, vec3 const & wo) const override {
+        return pdf(hit_rec, wi, wo) * albedo_;
+    }
+
+    // Directions through the ball of radius fuzz around the unit reflection
+    // vector r. Their density is the ball volume along the direction,
+    // (rho2^3 - rho1^3) / 3, over the ball volume 4/3 pi fuzz^3.
+    double pdf(HitRecord const & hit_rec, vec3 const & wi, vec3 const & wo) const override {
+        if (is_specular())
+            return 0.0;
+        vec3 const r = reflect(unit_vector(-wo), hit_rec.normal);
+        auto const b = dot(unit_vector(wi), r);
+        auto const discriminant = b * b - 1.0 + fuzz_ * fuzz_;
+        if (discriminant < 0.0)
+            return 0.0;
+        auto const rho2 = b + std::sqrt(discriminant);
+        auto const rho1 = std::max(b - std::sqrt(discriminant), 0.0);
+        if (rho2 <= 0.0)
+            return 0.0;
+        return (rho2 * rho2 * rho2 - rho1 * rho1 * rho1) / (4.0 * pi * fuzz_ * fuzz_ * fuzz_);
+    }
+
+    bool is_specular() const override { return fuzz_ == 0.0; }
+
 private:
     color albedo_;
     double fuzz_;
@@ -79,12 +153,36 @@ private:
 //--------------------------------------------------------------------dielectric
 class dielectric : public MaterialI {
 public:
-    explicit constexpr dielectric(double index_of_refraction) : etaT_{index_of_refraction} {}
-
-    // MaterialI
+    // `index_of_refraction` at the sodium D line (589.3 nm), which RGB
+    // rendering uses for all light. `dispersion` is the B coefficient in um^2
+    // of Cauchy's equation n = A + B / wavelength^2, e.g. 0.0042 for crown
+    // and 0.01 for flint glass.
+    explicit constexpr dielectric(double index_of_refraction, double dispersion = 0.0)
+        : etaT_{index_of_refraction}, dispersion_{dispersion} {}
+
+    // MaterialI, specular with the zero eval and pdf of the interface
     ScatterInfo scatter(Ray const & ray_in, HitRecord const & hit_rec) const override {
+        return scatter_with(ray_in, hit_rec, etaT_);
+    }
+
+    ScatterInfo scatter_wavelength(Ray const & ray_in, HitRecord const & hit_rec, double const wavelength) const override {
+        return scatter_with(ray_in, hit_rec, index_of_refraction(wavelength));
+    }
+
+    bool is_dispersive() const override { return dispersion_ != 0.0; }
+
+    double index_of_refraction(double const wavelength) const {
+        auto const micrometers = wavelength / 1000.0;
+        return etaT_ + dispersion_ * (1.0 / (micrometers * micrometers) - 1.0 / (0.5893 * 0.5893));
+    }
+
+private:
+    double etaT_;
+    double dispersion_;
+
+    ScatterInfo scatter_with(Ray const & ray_in, HitRecord const & hit_rec, double const etaT) const {
         constexpr double etaI = 1.0; // assume that the other material is air
-        double const refraction_ratio = hit_rec.side == FaceSide::front ? (etaI / etaT_) : etaT_ / etaI;
+        double const refraction_ratio = hit_rec.side == FaceSide::front ? (etaI / etaT) : etaT / etaI;
 
         vec3 const unit_direction = unit_vector(ray_in.d);
         double cos_theta = std::fmin(dot(-unit_direction, hit_rec.normal), 1.0);
@@ -101,9 +199,6 @@ public:
         return result;
     }
 
-private:
-    double etaT_;
-
     static double reflectance(double const cos, double const ref_index) {
         auto const r0 = (1 - ref_index) / (1 + ref_index);
         auto const r0_squared = r0 * r0;
@@ -120,9 +215,12 @@ public:
     // MaterialI
     ScatterInfo scatter(Ray const & ray_in, HitRecord const & hit_rec) const override {
         ScatterInfo result{ScatterInfo::miss()};
-        result.emitted = emitter_->value(hit_rec.uv, hit_rec.p);
+        result.emitted = emitter_->filtered_value(hit_rec.uv, hit_rec.p, hit_rec.texture_footprint());
         return result;
     }
+
+    bool is_emissive() const override { return true; }
+
 private:
     std::shared_ptr<TextureI> emitter_;
 };
@@ -137,10 +235,18 @@ public:
     virtual ScatterInfo scatter(Ray const & ray_in, HitRecord const & hit_rec) const override {
         ScatterInfo result{};
         result.scattered_ray = Ray(hit_rec.p, random_unit_vector(), ray_in.t);
-        result.attenuation = albedo_->value(hit_rec.uv, hit_rec.p);
+        result.attenuation = albedo_->filtered_value(hit_rec.uv, hit_rec.p, hit_rec.texture_footprint());
         return result;
     }
 
+    color eval(HitRecord const & hit_rec, vec3 const & wi, vec3 const & wo) const override {
+        return 1.0 / (4.0 * pi) * albedo_->filtered_value(hit_rec.uv, hit_rec.p, hit_rec.texture_footprint());
+    }
+
+    double pdf(HitRecord const & hit_rec, vec3 const & wi, vec3 const & wo) const override { return 1.0 / (4.0 * pi); }
+
+    bool is_specular() const override { return false; }
+
 private:
     std::shared_ptr<TextureI> albedo_;
 };
\ No newline at end of file
@@ -7,11 +7,13 @@
 #include <gmock/gmock.h>
 
 #include <algorithm>
+#include <cmath>
 #include <memory>
 #include <typeinfo>
 
 
 using ::testing::DoubleEq;
+using ::testing::DoubleNear;
 using ::testing::Eq;
 using ::testing::Ge;
 using ::testing::Gt;
@@ -91,6 +93,45 @@ TEST_F(a_lambertian_material, stores_the_correct_hit_time) {
     EXPECT_THAT(scatter_info.scattered_ray.time(), Eq(hit_time));
 };
 
+// Monte Carlo estimate of the integral of `pdf` over all directions
+template <typename Pdf>
+double integrate_over_sphere(Pdf const & pdf) {
+    int const n = 200000;
+    double result = 0.0;
+    for (int ii = 0; ii < n; ++ii)
+        result += 4.0 * pi * pdf(random_unit_vector()) / n;
+    return result;
+}
+
+// mean of 1 / pdf over scattered directions, which is the solid angle the pdf is nonzero in
+template <typename Material>
+double mean_inverse_pdf(Material const & material, Ray const & ray, HitRecord const & hit_record) {
+    int const n = 20000;
+    double result = 0.0;
+    for (int ii = 0; ii < n; ++ii)
+        result += 1.0 / material.pdf(hit_record, material.scatter(ray, hit_record).scattered_ray.d, -ray.d) / n;
+    return result;
+}
+
+TEST_F(a_lambertian_material, has_normalized_pdf) {
+    EXPECT_THAT(integrate_over_sphere([this](vec3 const & wi) { return material.pdf(a_hit_record, wi, -a_ray.d); }),
+                DoubleNear(1.0, 0.02));
+}
+
+TEST_F(a_lambertian_material, has_pdf_of_its_scattered_directions) {
+    EXPECT_THAT(mean_inverse_pdf(material, a_ray, a_hit_record), DoubleNear(2.0 * pi, 0.1));
+}
+
+TEST_F(a_lambertian_material, evaluates_albedo_over_pi_times_cosine) {
+    vec3 const wi{0.0, 0.6, 0.8};
+    EXPECT_THAT(material.eval(a_hit_record, wi, -a_ray.d), Eq(0.8 / pi * albedo));
+    EXPECT_THAT(material.eval(a_hit_record, -wi, -a_ray.d), Eq(color{0.0}));
+}
+
+TEST_F(a_lambertian_material, is_not_specular) {
+    EXPECT_FALSE(material.is_specular());
+}
+
 struct a_metal_material : Test {
     color const  albedo{0.8, 0.85, 0.9};
     metal const material{albedo};
@@ -110,6 +151,11 @@ TEST_F(a_metal_material, stores_the_correct_hit_time) {
     EXPECT_THAT(scatter_info.scattered_ray.time(), Eq(hit_time));
 };
 
+TEST_F(a_metal_material, is_specular) {
+    EXPECT_TRUE(material.is_specular());
+    EXPECT_THAT(material.pdf(a_hit_record, unit_vector(reflect(a_ray.d, a_hit_record.normal)), -a_ray.d), Eq(0.0));
+}
+
 
 struct a_fuzzy_metal_material : Test {
     color const  albedo{0.8, 0.85, 0.9};
@@ -129,6 +175,31 @@ TEST_F(a_fuzzy_metal_material, scatters_fuzzy) {
     EXPECT_THAT(deviation.length(), Lt(fuzz));
 }
 
+TEST(metal, has_normalized_pdf) {
+    metal const material{color{1.0}, 0.5};
+    HitRecord const hit_record{point3{0.0}, vec3{0.0, 0.0, 1.0}, nullptr, 0.0, {}, FaceSide::front};
+    EXPECT_THAT(integrate_over_sphere([&](vec3 const & wi) { return material.pdf(hit_record, wi, vec3{0.0, 0.6, 0.8}); }),
+                DoubleNear(1.0, 0.03));
+}
+
+TEST_F(a_fuzzy_metal_material, has_pdf_of_its_scattered_directions) {
+    // the scattered directions fill the cone around the reflection with sin(angle) = fuzz
+    EXPECT_THAT(mean_inverse_pdf(material, a_ray, a_hit_record),
+                DoubleNear(2.0 * pi * (1.0 - std::sqrt(1.0 - fuzz * fuzz)), 1e-3));
+}
+
+TEST_F(a_fuzzy_metal_material, evaluates_albedo_times_pdf) {
+    auto const wi = material.scatter(a_ray, a_hit_record).scattered_ray.d;
+    EXPECT_THAT(material.eval(a_hit_record, wi, -a_ray.d), Eq(material.pdf(a_hit_record, wi, -a_ray.d) * albedo));
+}
+
+TEST(metal, has_normalized_pdf_for_maximal_fuzz) {
+    metal const material{color{1.0}, 1.0};
+    HitRecord const hit_record{point3{0.0}, vec3{0.0, 0.0, 1.0}, nullptr, 0.0, {}, FaceSide::front};
+    EXPECT_THAT(integrate_over_sphere([&](vec3 const & wi) { return material.pdf(hit_record, wi, vec3{0.0, 0.6, 0.8}); }),
+                DoubleNear(1.0, 0.02));
+}
+
 struct a_dielectric_material : Test {
     color const  albedo{0.8, 0.85, 0.9};
     double const etaI{1.0}; // hard coded in dielectric
@@ -208,6 +279,26 @@ TEST_F(a_dielectric_material, stores_the_correct_hit_time) {
     EXPECT_THAT(scatter_info.scattered_ray.time(), Eq(hit_time));
 };
 
+TEST_F(a_dielectric_material, refracts_all_wavelengths_alike_without_dispersion) {
+    EXPECT_FALSE(material.is_dispersive());
+    EXPECT_THAT(material.index_of_refraction(400.0), DoubleEq(etaT));
+    EXPECT_THAT(material.index_of_refraction(700.0), DoubleEq(etaT));
+}
+
+TEST_F(a_dielectric_material, refracts_blue_light_more_with_dispersion) {
+    dielectric const flint{etaT, 0.01};
+    EXPECT_TRUE(flint.is_dispersive());
+    EXPECT_THAT(flint.index_of_refraction(589.3), DoubleNear(etaT, 1e-12));
+    EXPECT_THAT(flint.index_of_refraction(400.0) - flint.index_of_refraction(700.0), DoubleNear(0.01 * (1.0 / 0.16 - 1.0 / 0.49), 1e-12));
+
+    // the refracted direction follows the index of its wavelength, skipping
+    // reflections, which keep the sign of z
+    auto scatter_info = flint.scatter_wavelength(a_ray, a_hit_record, 400.0);
+    while (scatter_info.scattered_ray.d.z > 0.0)
+        scatter_info = flint.scatter_wavelength(a_ray, a_hit_record, 400.0);
+    EXPECT_THAT(flint.index_of_refraction(400.0) * scatter_info.scattered_ray.d.y, DoubleNear(etaI * a_ray.d.y, 1e-12));
+}
+
 struct ADiffuseLight : Test {
     color const  light_color{2.0, 2.0, 3.0};
     HitRecord const hit_record{};
@@ -243,6 +334,10 @@ TEST_F(AnIsotropicMaterial, returns_correct_attenuation) {
     EXPECT_THAT(scatter_info.attenuation, Eq(material_color));
 }
 
+TEST_F(AnIsotropicMaterial, has_uniform_pdf) {
+    EXPECT_THAT(material.pdf(hit_record, vec3{1.0, 0.0, 0.0}, vec3{0.0, 1.0, 0.0}), DoubleEq(1.0 / (4.0 * pi)));
+}
+
 
 int main(int argc, char **argv)
 {
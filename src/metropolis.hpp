@@ -0,0 +1,230 @@
+#pragma once
+
+#include <bdpt.hpp>
+#include <color.hpp>
+#include <common.hpp>
+#include <counter.hpp>
+#include <distribution.hpp>
+#include <hit.hpp>
+#include <integrator.hpp>
+#include <scenes.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <thread>
+#include <vector>
+
+// The random numbers of a path as a point in primary sample space, which a
+// Markov chain mutates (Kelemen et al., "A Simple and Robust Mutation
+// Strategy for the Metropolis Light Transport Algorithm"). Installed with
+// `ScopedRandomSource`, it hands the coordinates out one after the other to
+// whatever samples the path. An iteration either draws all coordinates anew
+// (large step) or perturbs each by a normal distribution of `sigma`, wrapped
+// around [0, 1). Coordinates are mutated lazily when a path first asks for
+// them, catching up on the small steps they missed, and `reject` restores
+// the state before the iteration.
+class MetropolisSampler : public RandomSourceI {
+public:
+    // the first iteration is a large step drawn from `seed`
+    MetropolisSampler(std::uint64_t const seed, double const sigma, double const large_step_probability)
+        : generator_{seed}, sigma_{sigma}, large_step_probability_{large_step_probability} {}
+
+    // Continues with the numbers of `seed` from here on, keeping the point.
+    // Chains that start from the same point mutate it differently this way.
+    void reseed(std::uint64_t const seed) { generator_.seed(seed); }
+
+    void start_iteration() {
+        ++iteration_;
+        large_step_ = uniform_(generator_) < large_step_probability_;
+        index_ = 0;
+    }
+
+    void accept() {
+        if (large_step_)
+            last_large_step_iteration_ = iteration_;
+    }
+
+    void reject() {
+        for (auto & x : coordinates_)
+            if (x.last_modification == iteration_) {
+                x.value = x.backup;
+                x.last_modification = x.backup_modification;
+            }
+        --iteration_;
+    }
+
+    // RandomSourceI
+    double get_1d() override {
+        // as if drawn at the last large step
+        if (index_ == coordinates_.size())
+            coordinates_.push_back(Coordinate{uniform_(generator_), last_large_step_iteration_});
+        auto & x = coordinates_[index_++];
+        mutate(x);
+        return x.value;
+    }
+    std::array<double, 2> get_2d() override { return {get_1d(), get_1d()}; }
+
+private:
+    struct Coordinate {
+        double value{0.0};
+        std::int64_t last_modification{0};
+        double backup{0.0};
+        std::int64_t backup_modification{0};
+    };
+
+    void mutate(Coordinate & x) {
+        // a large step since the last use replaces the value
+        if (x.last_modification < last_large_step_iteration_) {
+            x.value = uniform_(generator_);
+            x.last_modification = last_large_step_iteration_;
+        }
+        x.backup = x.value;
+        x.backup_modification = x.last_modification;
+        if (large_step_)
+            x.value = uniform_(generator_);
+        else {
+            auto const steps = static_cast<double>(iteration_ - x.last_modification);
+            x.value += normal_(generator_) * sigma_ * std::sqrt(steps);
+            x.value -= std::floor(x.value);
+        }
+        x.last_modification = iteration_;
+    }
+
+    std::mt19937_64 generator_;
+    std::uniform_real_distribution<double> uniform_{0.0, 1.0};
+    std::normal_distribution<double> normal_{0.0, 1.0};
+    double sigma_;
+    double large_step_probability_;
+    std::vector<Coordinate> coordinates_;
+    std::size_t index_{0};
+    std::int64_t iteration_{0};
+    std::int64_t last_large_step_iteration_{0};
+    bool large_step_{true};
+};
+
+struct MetropolisSettings {
+    std::size_t bootstrap_samples{100000};
+    std::size_t chains{1000};
+    double large_step_probability{0.3};
+    double sigma{0.01};
+};
+
+namespace ns_metropolis {
+    // paths per unit of work of a thread during the bootstrap
+    inline constexpr std::size_t batch_size{1024};
+
+    // A path of `ray_color` through the film position from the first two
+    // coordinates, uniform over the image of `film`.
+    struct PathSample {
+        double h, v;
+        color radiance;
+    };
+
+    inline PathSample sample_path(HittableI const & world, Scene const & scene, SplatFilm const & film, int const max_depth) {
+        auto const [u, v] = random_2d();
+        auto const h = u * film.width() / (film.width() - 1);
+        auto const w = v * film.height() / (film.height() - 1);
+        return {h, w, ray_color(scene.camera.get_ray(h, w), world, scene, max_depth)};
+    }
+
+    // target density of the chains, up to the normalization
+    inline double importance(color const & radiance) {
+        auto const l = luminance(radiance);
+        return std::isfinite(l) ? std::max(l, 0.0) : 0.0;
+    }
+
+    // calls `work(index)` for [0, count) in batches on all cores
+    template <typename Work>
+    void parallel_for(std::size_t const count, std::size_t const batch, Work const & work) {
+        Counter batches{(count + batch - 1) / batch};
+        auto const run = [&] {
+            while (auto const next = batches.next())
+                for (auto ii = next.value() * batch; ii < std::min(count, (next.value() + 1) * batch); ++ii)
+                    work(ii);
+        };
+        std::vector<std::thread> threads(std::max(1u, std::thread::hardware_concurrency()) - 1);
+        for (auto & thread : threads)
+            thread = std::thread{run};
+        run();
+        for (auto & thread : threads)
+            thread.join();
+    }
+}
+
+// Primary sample space Metropolis light transport over the paths of
+// `ray_color`, with `mutations_per_pixel` mutations per pixel on average.
+// The chains spend their time where the image is bright, which finds light
+// that arrives through rare paths once one of them has been found.
+//
+// The bootstrap estimates the mean importance over primary sample space,
+// which scales the image, from independent paths. Each of the chains starts
+// at one of them, chosen by importance so that the chains start in their
+// stationary distribution, and the chains run in parallel. The sampler of a
+// chain replays the path of its bootstrap sample and then continues with
+// numbers of its own, so that chains that start from the same bootstrap
+// sample diverge. Both the current and the proposed path of every mutation
+// are splatted, weighted with the acceptance probability.
+//
+// Returns the rows of the image from the top.
+inline std::vector<std::vector<color>> render_metropolis(HittableI const & world,
+                                                         Scene const & scene,
+                                                         std::size_t const width,
+                                                         std::size_t const height,
+                                                         std::size_t const mutations_per_pixel,
+                                                         int const max_depth,
+                                                         MetropolisSettings const & settings = {}) {
+    SplatFilm film{width, height};
+    std::vector<std::vector<color>> result(height, std::vector<color>(width));
+
+    std::vector<double> bootstrap_weights(settings.bootstrap_samples);
+    ns_metropolis::parallel_for(settings.bootstrap_samples, ns_metropolis::batch_size, [&](std::size_t const index) {
+        MetropolisSampler sampler{index, settings.sigma, settings.large_step_probability};
+        ScopedRandomSource const source{sampler};
+        bootstrap_weights[index] = ns_metropolis::importance(ns_metropolis::sample_path(world, scene, film, max_depth).radiance);
+    });
+    PiecewiseConstant1d const bootstrap{bootstrap_weights};
+    if (bootstrap.integral() <= 0.0)
+        return result;
+
+    auto const total_mutations = width * height * mutations_per_pixel;
+    ns_metropolis::parallel_for(settings.chains, 1, [&](std::size_t const chain) {
+        std::mt19937_64 generator{chain};
+        auto const index = bootstrap.sample(std::uniform_real_distribution<double>{0.0, 1.0}(generator)).index;
+        MetropolisSampler sampler{index, settings.sigma, settings.large_step_probability};
+        ScopedRandomSource const source{sampler};
+
+        auto current = ns_metropolis::sample_path(world, scene, film, max_depth);
+        // past the seeds of the bootstrap
+        sampler.reseed(settings.bootstrap_samples + chain);
+        auto current_importance = ns_metropolis::importance(current.radiance);
+        auto const mutations = total_mutations * (chain + 1) / settings.chains - total_mutations * chain / settings.chains;
+        for (std::size_t ii = 0; ii < mutations; ++ii) {
+            sampler.start_iteration();
+            auto const proposed = ns_metropolis::sample_path(world, scene, film, max_depth);
+            auto const proposed_importance = ns_metropolis::importance(proposed.radiance);
+            auto const acceptance = std::min(1.0, proposed_importance / current_importance);
+
+            if (acceptance > 0.0)
+                film.add(proposed.h, proposed.v, acceptance / proposed_importance * proposed.radiance);
+            film.add(current.h, current.v, (1.0 - acceptance) / current_importance * current.radiance);
+
+            if (std::uniform_real_distribution<double>{0.0, 1.0}(generator) < acceptance) {
+                sampler.accept();
+                current = proposed;
+                current_importance = proposed_importance;
+            } else
+                sampler.reject();
+        }
+    });
+
+    // the chains visit the film in proportion to the importance over its mean
+    auto const scale = bootstrap.integral() * width * height / total_mutations;
+    for (std::size_t row = 0; row < height; ++row)
+        for (std::size_t i = 0; i < width; ++i)
+            result[row][i] = scale * film.pixel(i, height - 1 - row);
+    return result;
+}
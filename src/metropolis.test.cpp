@@ -0,0 +1,151 @@
+#include <metropolis.hpp>
+
+#include <hittable_list.hpp>
+#include <material.hpp>
+#include <quad.hpp>
+#include <sphere.hpp>
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <cmath>
+#include <memory>
+#include <vector>
+
+
+using testing::DoubleNear;
+using testing::Eq;
+using testing::Gt;
+using testing::Lt;
+using testing::Ne;
+using testing::Test;
+
+
+std::vector<double> draw(MetropolisSampler & sampler, int const n) {
+    std::vector<double> result;
+    for (int ii = 0; ii < n; ++ii)
+        result.push_back(sampler.get_1d());
+    return result;
+}
+
+TEST(AMetropolisSampler, starts_from_the_same_point_for_the_same_seed) {
+    MetropolisSampler a{7, 0.01, 0.3}, b{7, 0.01, 0.3};
+    EXPECT_THAT(draw(a, 5), Eq(draw(b, 5)));
+}
+
+TEST(AMetropolisSampler, mutates_the_same_point_differently_after_a_reseed) {
+    MetropolisSampler a{7, 0.01, 0.3}, b{7, 0.01, 0.3};
+    ASSERT_THAT(draw(a, 5), Eq(draw(b, 5)));
+    a.reseed(1);
+    b.reseed(2);
+    a.start_iteration();
+    b.start_iteration();
+    EXPECT_THAT(draw(a, 5), Ne(draw(b, 5)));
+}
+
+// without a sigma, small steps keep the point and large steps move it
+TEST(AMetropolisSampler, restores_the_point_after_a_rejection) {
+    MetropolisSampler sampler{1, 0.0, 0.5};
+    auto const start = draw(sampler, 5);
+    int small_steps = 0;
+    for (int ii = 0; ii < 40; ++ii) {
+        sampler.start_iteration();
+        small_steps += draw(sampler, 5) == start;
+        sampler.reject();
+    }
+    EXPECT_THAT(small_steps, Gt(10));
+}
+
+TEST(AMetropolisSampler, keeps_accepted_points) {
+    MetropolisSampler sampler{2, 0.0, 0.5};
+    auto current = draw(sampler, 5);
+    int small_steps = 0;
+    for (int ii = 0; ii < 40; ++ii) {
+        sampler.start_iteration();
+        auto const proposed = draw(sampler, 5);
+        if (proposed == current)
+            ++small_steps;
+        // large steps are accepted every other time
+        if (proposed == current || ii % 2 == 0) {
+            sampler.accept();
+            current = proposed;
+        } else
+            sampler.reject();
+    }
+    EXPECT_THAT(small_steps, Gt(10));
+}
+
+TEST(AMetropolisSampler, perturbs_the_point_slightly_with_small_steps) {
+    MetropolisSampler sampler{3, 0.01, 0.0};
+    auto const start = draw(sampler, 100);
+    sampler.start_iteration();
+    auto const perturbed = draw(sampler, 100);
+    for (std::size_t ii = 0; ii < start.size(); ++ii) {
+        auto const distance = std::abs(perturbed[ii] - start[ii]);
+        EXPECT_THAT(std::min(distance, 1.0 - distance), Lt(0.1));
+    }
+}
+
+// a pinhole camera above a diffuse floor with a sphere on it, lit by a
+// quad light between them
+struct ARoomRenderedWithMetropolis : Test {
+    ARoomRenderedWithMetropolis() {
+        world.add(std::make_shared<Quad>(point3{-50.0, 0.0, -50.0}, vec3{0.0, 0.0, 100.0}, vec3{100.0, 0.0, 0.0},
+                                         std::make_shared<lambertian>(color{0.5})));
+        world.add(std::make_shared<Sphere>(point3{0.5, 0.5, 0.0}, 0.5, std::make_shared<lambertian>(color{0.8})));
+        lights.add(std::make_shared<Quad>(point3{-1.0, 1.5, -0.5}, vec3{1.0, 0.0, 0.0}, vec3{0.0, 0.0, 1.0},
+                                          std::make_shared<DiffuseLight>(color{4.0})));
+        world.add(lights.objects.front());
+    }
+
+    Scene scene() const {
+        return Scene{world,
+                     [](Ray const &) { return color{0.0}; },
+                     Camera{point3{0.0, 3.0, 0.5}, point3{0.0, 0.0, 0.0}, vec3{0.0, 1.0, 0.0}, FieldOfView{60.0}, AspectRatio{1.0}},
+                     lights,
+                     {}};
+    }
+
+    HittableList world;
+    HittableList lights;
+    std::size_t const width = 3;
+    std::size_t const height = 3;
+    int const max_depth = 4;
+};
+
+TEST_F(ARoomRenderedWithMetropolis, matches_the_path_tracer) {
+    auto const scene = this->scene();
+    int const n = 20000;
+    auto const image = render_metropolis(scene.world, scene, width, height, n, max_depth, MetropolisSettings{20000, 100});
+
+    double total = 0.0, expected_total = 0.0;
+    for (std::size_t row = 0; row < height; ++row)
+        for (std::size_t i = 0; i < width; ++i) {
+            auto const j = height - 1 - row;
+            double expected = 0.0;
+            for (int ii = 0; ii < n; ++ii) {
+                auto const ray = scene.camera.get_ray((i + random_double()) / (width - 1), (j + random_double()) / (height - 1));
+                expected += ray_color(ray, scene.world, scene, max_depth).x / n;
+            }
+            EXPECT_THAT(image[row][i].x, DoubleNear(expected, 0.1 * expected + 0.002)) << "pixel " << i << ", " << j;
+            total += image[row][i].x;
+            expected_total += expected;
+        }
+    EXPECT_THAT(total, DoubleNear(expected_total, 0.03 * expected_total));
+}
+
+TEST_F(ARoomRenderedWithMetropolis, is_black_without_light) {
+    world.objects.pop_back();
+    lights.objects.clear();
+    auto const scene = this->scene();
+    auto const image = render_metropolis(scene.world, scene, width, height, 10, max_depth, MetropolisSettings{1000, 10});
+    for (auto const & row : image)
+        for (auto const & pixel : row)
+            EXPECT_THAT(pixel, Eq(color{0.0}));
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -46,7 +46,7 @@ inline HitRecord MovingSphere::hit(Ray const & ray, double t_min, double t_max)
     auto sqrtd = sqrt(discriminant);
     auto root = (-h - sqrtd) / a;
     if(root < t_min || t_max < root) {
-        root = -h + sqrtd / a;
+        root = (-h + sqrtd) / a;
         if(root < t_min || t_max < root)
             return HitRecord::miss();
     }
@@ -57,6 +57,7 @@ inline HitRecord MovingSphere::hit(Ray const & ray, double t_min, double t_max)
     vec3 const outward_normal = (result.p - center(ray.t)) / r;
     result.set_face_normal(ray, outward_normal);
     result.material_ptr = material_ptr;
+    result.object = this;
     return result;
 }
 
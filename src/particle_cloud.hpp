@@ -0,0 +1,270 @@
+#pragma once
+
+#include <aabb.hpp>
+#include <hit.hpp>
+#include <material.hpp>
+#include <ray.hpp>
+#include <sphere.hpp>
+#include <vec3.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+// A large number of spheres sharing a single material.
+//
+// Compared to one `Sphere` per particle, the centers are stored as packed
+// floats in structure-of-arrays layout and the radius is either shared by all
+// particles or looked up through a one byte index into a small radius table.
+// An internal flat BVH over the particles replaces the `BvhNode` tree, and its
+// leaves are intersected in branch-free loops the compiler can vectorize.
+class ParticleCloud : public HittableI {
+public:
+    // all particles share `radius`
+    ParticleCloud(std::vector<point3> const & centers,
+                  double const radius,
+                  std::shared_ptr<MaterialI> material)
+        : ParticleCloud{centers, {}, {static_cast<float>(radius)}, material} {}
+
+    // particle i has the radius `radii[radius_indices[i]]`
+    ParticleCloud(std::vector<point3> const & centers,
+                  std::vector<std::uint8_t> radius_indices,
+                  std::vector<float> radii,
+                  std::shared_ptr<MaterialI> material);
+
+    std::size_t size() const { return x_.size(); }
+
+    point3 center(std::size_t const index) const { return point3{x_[index], y_[index], z_[index]}; }
+    double radius(std::size_t const index) const {
+        return radius_index_.empty() ? radii_.front() : radii_[radius_index_[index]];
+    }
+
+    // HittableI
+    HitRecord hit(Ray const & r, double t_min, double t_max) const override;
+    Aabb bounding_box(TimeInterval times) const override { return aabb_; }
+
+private:
+    struct Node {
+        std::array<float, 3> min, max;
+        std::uint32_t offset;  // leaf: first particle, inner node: index of the right child
+        std::uint16_t count;   // number of particles in a leaf, 0 for inner nodes
+        std::uint16_t axis;    // split axis of inner nodes; the left child follows its parent
+    };
+
+    inline static constexpr std::size_t max_leaf_size_{8};
+    inline static constexpr std::size_t max_depth_{64};
+
+    std::uint32_t build(std::vector<std::uint32_t> & indices,
+                        std::size_t begin,
+                        std::size_t end,
+                        std::vector<point3> const & centers,
+                        std::vector<double> const & radii);
+
+    // index and ray parameter of the closest particle of a leaf within (t_min, t_max), if any
+    void hit_leaf(Node const & leaf, Ray const & ray, double t_min, double & t_max, std::int64_t & closest) const;
+
+    static bool hit_node(Node const & node, point3 const & origin, vec3 const & inverse_direction,
+                         double t_min, double t_max);
+
+    std::vector<float> x_, y_, z_;
+    std::vector<std::uint8_t> radius_index_;  // empty if all particles share radii_.front()
+    std::vector<float> radii_;
+    std::vector<Node> nodes_;
+    std::shared_ptr<MaterialI> material_;
+    Aabb aabb_{AabbBounds{vec3{1.0}, vec3{-1.0}}};
+};
+
+inline ParticleCloud::ParticleCloud(std::vector<point3> const & centers,
+                                    std::vector<std::uint8_t> radius_indices,
+                                    std::vector<float> radii,
+                                    std::shared_ptr<MaterialI> material)
+    : radius_index_{std::move(radius_indices)}
+    , radii_{std::move(radii)}
+    , material_{material} {
+    if (radii_.empty())
+        throw std::invalid_argument("ParticleCloud requires at least one radius");
+    if (!radius_index_.empty() && radius_index_.size() != centers.size())
+        throw std::invalid_argument("ParticleCloud requires one radius index per particle");
+    if (centers.size() >= std::numeric_limits<std::uint32_t>::max())
+        throw std::invalid_argument("ParticleCloud supports less than 2^32 particles");
+    if (centers.empty())
+        return;
+
+    std::vector<double> particle_radii(centers.size());
+    for (std::size_t ii = 0; ii < centers.size(); ++ii)
+        particle_radii[ii] = radius_index_.empty() ? radii_.front() : radii_.at(radius_index_[ii]);
+
+    std::vector<std::uint32_t> indices(centers.size());
+    std::iota(std::begin(indices), std::end(indices), 0u);
+    nodes_.reserve(2 * centers.size() / max_leaf_size_ + 1);
+    build(indices, 0, indices.size(), centers, particle_radii);
+
+    // store the particles in leaf order, so that every leaf is a contiguous range
+    x_.resize(centers.size());
+    y_.resize(centers.size());
+    z_.resize(centers.size());
+    auto const original_radius_index = radius_index_;
+    for (std::size_t ii = 0; ii < indices.size(); ++ii) {
+        auto const & c = centers[indices[ii]];
+        x_[ii] = static_cast<float>(c.x);
+        y_[ii] = static_cast<float>(c.y);
+        z_[ii] = static_cast<float>(c.z);
+        if (!radius_index_.empty())
+            radius_index_[ii] = original_radius_index[indices[ii]];
+    }
+
+    auto const & root = nodes_.front();
+    aabb_ = Aabb{AabbBounds{vec3{root.min[0], root.min[1], root.min[2]},
+                            vec3{root.max[0], root.max[1], root.max[2]}}};
+}
+
+inline std::uint32_t ParticleCloud::build(std::vector<std::uint32_t> & indices,
+                                          std::size_t const begin,
+                                          std::size_t const end,
+                                          std::vector<point3> const & centers,
+                                          std::vector<double> const & radii) {
+    auto const node_index = static_cast<std::uint32_t>(nodes_.size());
+    nodes_.emplace_back();
+
+    vec3 min{infinity}, max{-infinity};
+    vec3 centroid_min{infinity}, centroid_max{-infinity};
+    for (std::size_t ii = begin; ii < end; ++ii) {
+        auto const & c = centers[indices[ii]];
+        min = min_components(min, c - vec3{radii[indices[ii]]});
+        max = max_components(max, c + vec3{radii[indices[ii]]});
+        centroid_min = min_components(centroid_min, c);
+        centroid_max = max_components(centroid_max, c);
+    }
+
+    Node node{};
+    for (std::size_t dim = 0; dim < 3; ++dim) {
+        // round outwards, so that the float bounds enclose the double precision spheres
+        node.min[dim] = std::nextafter(static_cast<float>(min[dim]), -std::numeric_limits<float>::infinity());
+        node.max[dim] = std::nextafter(static_cast<float>(max[dim]),  std::numeric_limits<float>::infinity());
+    }
+
+    if (end - begin <= max_leaf_size_) {
+        node.offset = static_cast<std::uint32_t>(begin);
+        node.count = static_cast<std::uint16_t>(end - begin);
+        nodes_[node_index] = node;
+        return node_index;
+    }
+
+    // median split along the largest extent of the particle centers
+    auto const extent = centroid_max - centroid_min;
+    auto const axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2)
+                                          : (extent.y > extent.z ? 1 : 2);
+    auto const middle = begin + (end - begin) / 2;
+    std::nth_element(std::begin(indices) + begin,
+                     std::begin(indices) + middle,
+                     std::begin(indices) + end,
+                     [&centers, axis](std::uint32_t const a, std::uint32_t const b) {
+                         return centers[a][axis] < centers[b][axis];
+                     });
+
+    build(indices, begin, middle, centers, radii);
+    node.offset = build(indices, middle, end, centers, radii);
+    node.count = 0;
+    node.axis = static_cast<std::uint16_t>(axis);
+    nodes_[node_index] = node;
+    return node_index;
+}
+
+inline bool ParticleCloud::hit_node(Node const & node,
+                                    point3 const & origin,
+                                    vec3 const & inverse_direction,
+                                    double t_min,
+                                    double t_max) {
+    for (std::size_t dim = 0; dim < 3; ++dim) {
+        auto t0 = (node.min[dim] - origin[dim]) * inverse_direction[dim];
+        auto t1 = (node.max[dim] - origin[dim]) * inverse_direction[dim];
+        if (inverse_direction[dim] < 0.0)
+            std::swap(t0, t1);
+        t_min = t0 > t_min ? t0 : t_min;
+        t_max = t1 < t_max ? t1 : t_max;
+        if (t_max < t_min)
+            return false;
+    }
+    return true;
+}
+
+inline void ParticleCloud::hit_leaf(Node const & leaf,
+                                    Ray const & ray,
+                                    double const t_min,
+                                    double & t_max,
+                                    std::int64_t & closest) const {
+    // The loop body is free of branches, so that it can be vectorized over the
+    // particles of the leaf. Misses are encoded as infinity.
+    std::array<double, max_leaf_size_> roots;
+    auto const a = ray.d.length_squared();
+    for (std::size_t ii = 0; ii < leaf.count; ++ii) {
+        auto const index = leaf.offset + ii;
+        auto const r = radius_index_.empty() ? radii_.front() : radii_[radius_index_[index]];
+        auto const ocx = ray.o.x - x_[index];
+        auto const ocy = ray.o.y - y_[index];
+        auto const ocz = ray.o.z - z_[index];
+        auto const h = ocx * ray.d.x + ocy * ray.d.y + ocz * ray.d.z;
+        auto const C = ocx * ocx + ocy * ocy + ocz * ocz - static_cast<double>(r) * r;
+        auto const discriminant = h * h - a * C;
+        auto const sqrtd = std::sqrt(std::max(discriminant, 0.0));
+        auto const near = (-h - sqrtd) / a;
+        auto const far = (-h + sqrtd) / a;
+        auto const root = near > t_min ? near : far;
+        roots[ii] = discriminant >= 0.0 && t_min < root && root < t_max ? root : infinity;
+    }
+
+    for (std::size_t ii = 0; ii < leaf.count; ++ii)
+        if (roots[ii] < t_max) {
+            t_max = roots[ii];
+            closest = leaf.offset + ii;
+        }
+}
+
+inline HitRecord ParticleCloud::hit(Ray const & ray, double t_min, double t_max) const {
+    if (nodes_.empty())
+        return HitRecord::miss();
+
+    vec3 const inverse_direction{1.0 / ray.d.x, 1.0 / ray.d.y, 1.0 / ray.d.z};
+    std::int64_t closest = -1;
+
+    std::array<std::uint32_t, max_depth_> stack;
+    std::size_t stack_size = 0;
+    stack[stack_size++] = 0;
+    while (stack_size > 0) {
+        auto const & node = nodes_[stack[--stack_size]];
+        if (!hit_node(node, ray.o, inverse_direction, t_min, t_max))
+            continue;
+
+        if (node.count > 0) {
+            hit_leaf(node, ray, t_min, t_max, closest);
+            continue;
+        }
+
+        // visit the child closer to the ray origin first
+        auto const left = static_cast<std::uint32_t>(&node - nodes_.data()) + 1;
+        auto const right = node.offset;
+        bool const left_first = ray.d[node.axis] >= 0.0;
+        stack[stack_size++] = left_first ? right : left;
+        stack[stack_size++] = left_first ? left : right;
+    }
+
+    if (closest < 0)
+        return HitRecord::miss();
+
+    auto const index = static_cast<std::size_t>(closest);
+    HitRecord result;
+    result.t = t_max;
+    result.p = ray.at(result.t);
+    vec3 const outward_normal = (result.p - center(index)) / radius(index);
+    result.set_face_normal(ray, outward_normal);
+    result.uv = Sphere::get_uv(outward_normal);
+    result.material_ptr = material_;
+    result.object = this;
+    return result;
+}
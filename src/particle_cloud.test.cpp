@@ -0,0 +1,110 @@
+#include <particle_cloud.hpp>
+
+#include <hittable_list.hpp>
+#include <sphere.hpp>
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <memory>
+#include <vector>
+
+
+using testing::DoubleNear;
+using testing::Eq;
+using testing::Le;
+using testing::Test;
+
+
+TEST(ParticleCloud, can_be_constructed_with_shared_radius) {
+    ParticleCloud const cloud{{point3{0.0}, point3{1.0}}, 0.5, nullptr};
+    EXPECT_THAT(cloud.size(), Eq(2u));
+}
+
+TEST(ParticleCloud, can_be_constructed_with_indexed_radii) {
+    ParticleCloud const cloud{{point3{0.0}, point3{3.0}}, {1, 0}, {0.5f, 2.0f}, nullptr};
+    EXPECT_THAT(cloud.size(), Eq(2u));
+}
+
+TEST(ParticleCloud, requires_one_radius_index_per_particle) {
+    EXPECT_THROW((ParticleCloud{{point3{0.0}, point3{3.0}}, {1}, {0.5f, 2.0f}, nullptr}),
+                 std::invalid_argument);
+}
+
+TEST(ParticleCloud, can_be_empty) {
+    ParticleCloud const cloud{{}, 1.0, nullptr};
+    EXPECT_FALSE(cloud.hit(Ray{point3{0.0}, vec3{1.0, 0.0, 0.0}}, 0.0, infinity));
+}
+
+TEST(ParticleCloud, has_bounding_box_enclosing_all_particles) {
+    ParticleCloud const cloud{{point3{0.0}, point3{2.0, 3.0, 4.0}}, 0.5, nullptr};
+    auto const aabb = cloud.bounding_box(TimeInterval{});
+    EXPECT_THAT(aabb.min().x, Le(-0.5));
+    EXPECT_THAT(aabb.min().y, Le(-0.5));
+    EXPECT_THAT(aabb.min().z, Le(-0.5));
+    EXPECT_THAT(2.5, Le(aabb.max().x));
+    EXPECT_THAT(3.5, Le(aabb.max().y));
+    EXPECT_THAT(4.5, Le(aabb.max().z));
+}
+
+TEST(ParticleCloud, returns_the_closest_particle) {
+    ParticleCloud const cloud{{point3{0.0, 0.0, -10.0}, point3{0.0, 0.0, -5.0}}, 1.0, nullptr};
+    auto const hit_record = cloud.hit(Ray{point3{0.0}, vec3{0.0, 0.0, -1.0}}, 0.0, infinity);
+    EXPECT_TRUE(hit_record);
+    EXPECT_THAT(hit_record.t, DoubleNear(4.0, 1e-6));
+    EXPECT_THAT(hit_record.normal, Eq(vec3{0.0, 0.0, 1.0}));
+}
+
+TEST(ParticleCloud, uses_the_indexed_radius) {
+    ParticleCloud const cloud{{point3{0.0, 0.0, -10.0}}, {1}, {1.0f, 2.0f}, nullptr};
+    auto const hit_record = cloud.hit(Ray{point3{0.0}, vec3{0.0, 0.0, -1.0}}, 0.0, infinity);
+    EXPECT_THAT(hit_record.t, DoubleNear(8.0, 1e-6));
+}
+
+TEST(ParticleCloud, respects_the_ray_interval) {
+    ParticleCloud const cloud{{point3{0.0, 0.0, -10.0}}, 1.0, nullptr};
+    Ray const ray{point3{0.0}, vec3{0.0, 0.0, -1.0}};
+    EXPECT_FALSE(cloud.hit(ray, 0.0, 8.0));
+    EXPECT_THAT(cloud.hit(ray, 9.5, infinity).t, DoubleNear(11.0, 1e-6));
+}
+
+struct ManyParticles : Test {
+    std::vector<point3> centers = random_centers();
+    double const radius = 0.05;
+    ParticleCloud const cloud{centers, radius, nullptr};
+
+    static std::vector<point3> random_centers() {
+        std::vector<point3> result(1000);
+        for (auto & center : result)
+            center = point3::random(-1.0, 1.0);
+        return result;
+    }
+
+    HittableList spheres() const {
+        HittableList result;
+        for (auto const & center : centers)
+            result.add(std::make_shared<Sphere>(center, radius));
+        return result;
+    }
+};
+
+TEST_F(ManyParticles, hit_the_same_as_individual_spheres) {
+    auto const reference = spheres();
+    for (int ii = 0; ii < 500; ++ii) {
+        point3 const origin = 3.0 * random_unit_vector();
+        Ray const ray{origin, point3::random(-1.0, 1.0) - origin};
+        auto const expected = reference.hit(ray, 1e-3, infinity);
+        auto const actual = cloud.hit(ray, 1e-3, infinity);
+        ASSERT_THAT(bool{actual}, Eq(bool{expected}));
+        if (expected) {
+            EXPECT_THAT(actual.t, DoubleNear(expected.t, 1e-5));
+        }
+    }
+}
+
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
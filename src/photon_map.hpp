@@ -0,0 +1,184 @@
+#pragma once
+
+#include <color.hpp>
+#include <common.hpp>
+#include <counter.hpp>
+#include <hit.hpp>
+#include <material.hpp>
+#include <ray.hpp>
+#include <vec3.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// light arriving at a surface along `wi` (pointing away from the surface)
+struct Photon {
+    point3 p;
+    vec3 wi;
+    color power;
+};
+
+// Photons in a hash grid of cells twice as wide as the gather `radius`, so
+// that the photons within the radius of any point lie in 2 x 2 x 2 cells.
+// Reflected radiance is estimated from them with an Epanechnikov kernel.
+class PhotonMap {
+public:
+    PhotonMap(std::vector<Photon> const & photons, double radius);
+
+    std::size_t size() const { return photons_.size(); }
+    double radius() const { return radius_; }
+
+    // calls `f` for each photon within `radius` of `p`
+    template <typename F>
+    void for_each_near(point3 const & p, F && f) const;
+
+    // density estimate of the light reflected at `rec` towards `wo`
+    color radiance(HitRecord const & rec, vec3 const & wo) const;
+
+private:
+    std::size_t cell(std::int64_t x, std::int64_t y, std::int64_t z) const {
+        auto const hash = static_cast<std::uint64_t>(x) * 73856093u
+                        ^ static_cast<std::uint64_t>(y) * 19349663u
+                        ^ static_cast<std::uint64_t>(z) * 83492791u;
+        return static_cast<std::size_t>(hash) & (cell_starts_.size() - 2);  // modulo the number of cells
+    }
+
+    std::int64_t coordinate(double const x) const { return static_cast<std::int64_t>(std::floor(x / (2.0 * radius_))); }
+
+    std::size_t cell(point3 const & p) const { return cell(coordinate(p.x), coordinate(p.y), coordinate(p.z)); }
+
+    double radius_;
+    std::vector<Photon> photons_;            // sorted by cell
+    std::vector<std::size_t> cell_starts_;   // one past the last cell, the number of cells is a power of two
+};
+
+inline PhotonMap::PhotonMap(std::vector<Photon> const & photons, double const radius)
+    : radius_{radius}, photons_(photons.size()) {
+    std::size_t cells = 1;
+    while (cells < photons.size())
+        cells *= 2;
+    cell_starts_.assign(cells + 1, 0);
+
+    // counting sort by cell
+    for (auto const & photon : photons)
+        ++cell_starts_[cell(photon.p) + 1];
+    for (std::size_t ii = 1; ii < cell_starts_.size(); ++ii)
+        cell_starts_[ii] += cell_starts_[ii - 1];
+    auto next = cell_starts_;
+    for (auto const & photon : photons)
+        photons_[next[cell(photon.p)]++] = photon;
+}
+
+template <typename F>
+void PhotonMap::for_each_near(point3 const & p, F && f) const {
+    auto const r2 = radius_ * radius_;
+    // cells overlapping the cube of width 2 radius around `p`, the same
+    // cell may come up twice after hashing
+    std::size_t visited[8];
+    int number_of_visited = 0;
+    auto const x0 = coordinate(p.x - radius_), y0 = coordinate(p.y - radius_), z0 = coordinate(p.z - radius_);
+    for (int dx = 0; dx < 2; ++dx)
+        for (int dy = 0; dy < 2; ++dy)
+            for (int dz = 0; dz < 2; ++dz) {
+                auto const index = cell(x0 + dx, y0 + dy, z0 + dz);
+                if (std::find(visited, visited + number_of_visited, index) != visited + number_of_visited)
+                    continue;
+                visited[number_of_visited++] = index;
+                for (auto ii = cell_starts_[index]; ii < cell_starts_[index + 1]; ++ii)
+                    if ((photons_[ii].p - p).length_squared() < r2)
+                        f(photons_[ii]);
+            }
+}
+
+inline color PhotonMap::radiance(HitRecord const & rec, vec3 const & wo) const {
+    color result{0.0, 0.0, 0.0};
+    auto const r2 = radius_ * radius_;
+    for_each_near(rec.p, [&](Photon const & photon) {
+        auto const cos_theta = dot(photon.wi, rec.normal);
+        if (cos_theta <= 0.0)
+            return;
+        auto const kernel = 2.0 * (1.0 - (photon.p - rec.p).length_squared() / r2);
+        result += kernel / cos_theta * rec.material_ptr->eval(rec, photon.wi, wo) * photon.power;
+    });
+    return result / (pi * r2);
+}
+
+namespace ns_photon_map {
+    // specular bounces after which a photon is given up
+    inline constexpr int max_specular_bounces{16};
+
+    // photons emitted per unit of work of a thread
+    inline constexpr std::size_t batch_size{4096};
+
+    // Emits `count` photons from `lights` and appends those that reach a
+    // non-specular surface of `world` after at least one specular bounce
+    // to `result`, each with the power of a single emitted photon.
+    inline void emit_caustic_photons(HittableI const & world, HittableI const & lights, std::size_t const count,
+                                     std::vector<Photon> & result) {
+        for (std::size_t ii = 0; ii < count; ++ii) {
+            auto const light = lights.sample_surface();
+            if (light.pdf <= 0.0)
+                continue;
+            // emitters shine to both sides, cosine weighted
+            auto const normal = random_double() < 0.5 ? light.record.normal : -light.record.normal;
+            auto direction = normal + random_unit_vector();
+            if (direction.near_zero())
+                direction = normal;
+            Ray ray{light.record.p, unit_vector(direction), random_double()};
+            auto const emitted = light.record.material_ptr->scatter(Ray{light.record.p + ray.d, -ray.d}, light.record).emitted;
+            color power = 2.0 * pi / light.pdf * emitted;
+
+            for (int bounce = 0; bounce <= max_specular_bounces; ++bounce) {
+                auto const rec = world.hit(ray, 1e-3, infinity);
+                if (!rec || rec.side == FaceSide::medium)
+                    break;
+                if (!rec.material_ptr->is_specular()) {
+                    if (bounce > 0)
+                        result.push_back(Photon{rec.p, -unit_vector(ray.d), power});
+                    break;
+                }
+                auto const scatter_info = rec.material_ptr->scatter(ray, rec);
+                if (!scatter_info)
+                    break;
+                power = power * scatter_info.attenuation;
+                ray = scatter_info.scattered_ray;
+            }
+        }
+    }
+}
+
+// Map of the caustics cast by `lights` through specular surfaces of
+// `world`, from `number_of_photons` photons emitted on all cores.
+inline PhotonMap trace_caustics(HittableI const & world,
+                                HittableI const & lights,
+                                std::size_t const number_of_photons,
+                                double const radius) {
+    Counter batches{(number_of_photons + ns_photon_map::batch_size - 1) / ns_photon_map::batch_size};
+    std::vector<Photon> photons;
+    std::mutex mutex;
+    auto const trace = [&] {
+        std::vector<Photon> traced;
+        while (auto const batch = batches.next()) {
+            auto const first = batch.value() * ns_photon_map::batch_size;
+            ns_photon_map::emit_caustic_photons(world, lights, std::min(ns_photon_map::batch_size, number_of_photons - first), traced);
+        }
+        std::lock_guard lock{mutex};
+        photons.insert(std::end(photons), std::begin(traced), std::end(traced));
+    };
+
+    std::vector<std::thread> threads(std::max(1u, std::thread::hardware_concurrency()) - 1);
+    for (auto & thread : threads)
+        thread = std::thread{trace};
+    trace();
+    for (auto & thread : threads)
+        thread.join();
+
+    for (auto & photon : photons)
+        photon.power = photon.power / static_cast<double>(number_of_photons);
+    return PhotonMap{photons, radius};
+}
@@ -0,0 +1,113 @@
+#include <photon_map.hpp>
+
+#include <hittable_list.hpp>
+#include <material.hpp>
+#include <quad.hpp>
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <memory>
+#include <vector>
+
+
+using testing::DoubleNear;
+using testing::Eq;
+using testing::Gt;
+using testing::Test;
+
+
+TEST(APhotonMap, finds_the_photons_within_its_radius) {
+    std::vector<Photon> photons;
+    for (int ii = 0; ii < 2000; ++ii)
+        photons.push_back(Photon{point3{random_double(-2.0, 2.0), random_double(-2.0, 2.0), random_double(-2.0, 2.0)},
+                                 vec3{0.0, 1.0, 0.0}, color{1.0}});
+    PhotonMap const map{photons, 0.3};
+    EXPECT_THAT(map.size(), Eq(photons.size()));
+
+    for (int ii = 0; ii < 50; ++ii) {
+        point3 const p{random_double(-2.0, 2.0), random_double(-2.0, 2.0), random_double(-2.0, 2.0)};
+        int expected = 0;
+        for (auto const & photon : photons)
+            expected += (photon.p - p).length_squared() < 0.09;
+        int found = 0;
+        map.for_each_near(p, [&found](Photon const &) { ++found; });
+        EXPECT_THAT(found, Eq(expected));
+    }
+}
+
+TEST(APhotonMap, estimates_the_radiance_reflected_by_a_lambertian_surface) {
+    // irradiance 1 from straight above on a plane: albedo / pi
+    double const albedo = 0.5;
+    int const n = 200000;
+    std::vector<Photon> photons;
+    for (int ii = 0; ii < n; ++ii)
+        photons.push_back(Photon{point3{random_double(0.0, 10.0), 0.0, random_double(0.0, 10.0)},
+                                 vec3{0.0, 1.0, 0.0}, color{100.0 / n}});
+    PhotonMap const map{photons, 0.5};
+
+    HitRecord rec{point3{5.0, 0.0, 5.0}, vec3{0.0, 1.0, 0.0}, std::make_shared<lambertian>(color{albedo}), 1.0, {}, FaceSide::front};
+    EXPECT_THAT(map.radiance(rec, vec3{0.0, 1.0, 0.0}).x, DoubleNear(albedo / pi, 0.03 * albedo / pi));
+
+    // light from below does not reach the surface
+    rec.normal = vec3{0.0, -1.0, 0.0};
+    EXPECT_THAT(map.radiance(rec, vec3{0.0, -1.0, 0.0}).x, Eq(0.0));
+}
+
+TEST(APhotonMap, can_be_empty) {
+    PhotonMap const map{{}, 1.0};
+    HitRecord const rec{point3{0.0}, vec3{0.0, 1.0, 0.0}, std::make_shared<lambertian>(color{0.5}), 1.0, {}, FaceSide::front};
+    EXPECT_THAT(map.radiance(rec, vec3{0.0, 1.0, 0.0}), Eq(color{0.0}));
+}
+
+
+struct ALightBetweenAMirrorAndAFloor : Test {
+public:
+    ALightBetweenAMirrorAndAFloor() {
+        world.add(std::make_shared<Quad>(point3{-50.0, 0.0, -50.0}, vec3{0.0, 0.0, 100.0}, vec3{100.0, 0.0, 0.0},
+                                         std::make_shared<lambertian>(color{0.5})));
+        world.add(std::make_shared<Quad>(point3{-50.0, 2.0, -50.0}, vec3{100.0, 0.0, 0.0}, vec3{0.0, 0.0, 100.0},
+                                         std::make_shared<metal>(color{1.0}, 0.0)));
+        world.add(std::make_shared<Quad>(point3{-0.25, 1.0, -0.25}, vec3{0.5, 0.0, 0.0}, vec3{0.0, 0.0, 0.5},
+                                         std::make_shared<DiffuseLight>(color{4.0})));
+        lights.add(world.objects.back());
+    }
+
+    HittableList world;
+    HittableList lights;
+};
+
+TEST_F(ALightBetweenAMirrorAndAFloor, stores_the_light_reflected_onto_the_floor) {
+    auto const map = trace_caustics(world, lights, 20000, 0.5);
+    // about half of the photons leave the light upwards, a few hit it again
+    EXPECT_THAT(map.size(), Gt(8000u));
+    int on_the_floor = 0;
+    map.for_each_near(point3{0.0, 0.0, 0.0}, [&on_the_floor](Photon const & photon) {
+        on_the_floor += photon.p.y == 0.0 && photon.wi.y > 0.0;
+    });
+    EXPECT_THAT(on_the_floor, Gt(0));
+}
+
+TEST_F(ALightBetweenAMirrorAndAFloor, stores_no_photons_without_specular_surfaces) {
+    world.objects[1] = std::make_shared<Quad>(point3{-50.0, 2.0, -50.0}, vec3{100.0, 0.0, 0.0}, vec3{0.0, 0.0, 100.0},
+                                              std::make_shared<lambertian>(color{1.0}));
+    EXPECT_THAT(trace_caustics(world, lights, 10000, 0.5).size(), Eq(0u));
+}
+
+TEST_F(ALightBetweenAMirrorAndAFloor, conserves_the_emitted_power) {
+    // the light emits pi * radiance * area upwards, and the mirror reflects
+    // nearly all of it onto the floor
+    int const n = 100000;
+    std::vector<Photon> photons;
+    ns_photon_map::emit_caustic_photons(world, lights, n, photons);
+    double power = 0.0;
+    for (auto const & photon : photons)
+        power += photon.power.x / n;
+    EXPECT_THAT(power, DoubleNear(pi * 4.0 * 0.25, 0.03 * pi));
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+
+// Plans the passes of a progressive render: passes of `samples_per_pass`
+// samples per pixel until `target_samples` are taken, or until the next pass
+// is expected to end after `deadline`. The expected duration is taken from
+// the previous pass. The first pass always runs, so that there is an image.
+// With a `growth` above 1, every pass takes that many times the samples of
+// the previous one, e.g. doubling passes for learning the path guide.
+class PassScheduler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    PassScheduler(std::size_t const target_samples,
+                  std::size_t const samples_per_pass,
+                  Clock::time_point const deadline,
+                  double const growth = 1.0)
+        : target_samples_{target_samples}
+        , samples_per_pass_{std::max<std::size_t>(samples_per_pass, 1)}
+        , deadline_{deadline}
+        , growth_{std::max(growth, 1.0)} {}
+
+    // samples per pixel of the pass starting at `now`, 0 if rendering stops
+    std::size_t next_pass(Clock::time_point const now) {
+        auto const samples = std::min(samples_per_pass_, target_samples_ - samples_taken_);
+        if (samples == 0)
+            return 0;
+        if (samples_taken_ > 0 && now + time_per_sample_ * static_cast<double>(samples) > deadline_)
+            return 0;
+        pass_start_ = now;
+        pass_samples_ = samples;
+        return samples;
+    }
+
+    // the pass returned by the last `next_pass` finished at `now`
+    void end_pass(Clock::time_point const now) {
+        time_per_sample_ = std::chrono::duration<double>(now - pass_start_) / static_cast<double>(pass_samples_);
+        samples_taken_ += pass_samples_;
+        samples_per_pass_ = static_cast<std::size_t>(std::ceil(static_cast<double>(samples_per_pass_) * growth_));
+    }
+
+    std::size_t samples_taken() const { return samples_taken_; }
+
+private:
+    std::size_t target_samples_;
+    std::size_t samples_per_pass_;
+    Clock::time_point deadline_;
+    double growth_;
+
+    std::size_t samples_taken_{0};
+    Clock::time_point pass_start_{};
+    std::size_t pass_samples_{0};
+    std::chrono::duration<double> time_per_sample_{0.0};
+};
@@ -0,0 +1,69 @@
+#include <progressive.hpp>
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <chrono>
+#include <vector>
+
+
+using testing::Eq;
+using testing::Test;
+
+using namespace std::chrono_literals;
+
+
+struct APassScheduler : Test {
+public:
+    PassScheduler::Clock::time_point const start{};
+};
+
+TEST_F(APassScheduler, stops_at_the_target_samples) {
+    PassScheduler scheduler{10, 4, start + 1h};
+    auto now = start;
+    std::vector<std::size_t> passes;
+    while (auto const samples = scheduler.next_pass(now)) {
+        passes.push_back(samples);
+        now += 1s;
+        scheduler.end_pass(now);
+    }
+    EXPECT_THAT(passes, Eq(std::vector<std::size_t>{4, 4, 2}));
+    EXPECT_THAT(scheduler.samples_taken(), Eq(10u));
+}
+
+TEST_F(APassScheduler, stops_before_a_pass_that_would_miss_the_deadline) {
+    PassScheduler scheduler{100, 2, start + 10s};
+    auto now = start;
+    while (scheduler.next_pass(now)) {
+        now += 3s;
+        scheduler.end_pass(now);
+    }
+    EXPECT_THAT(scheduler.samples_taken(), Eq(6u));
+    EXPECT_TRUE(now <= start + 10s);
+}
+
+TEST_F(APassScheduler, grows_the_passes) {
+    PassScheduler scheduler{20, 1, start + 1h, 2.0};
+    auto now = start;
+    std::vector<std::size_t> passes;
+    while (auto const samples = scheduler.next_pass(now)) {
+        passes.push_back(samples);
+        now += 1s;
+        scheduler.end_pass(now);
+    }
+    EXPECT_THAT(passes, Eq(std::vector<std::size_t>{1, 2, 4, 8, 5}));
+}
+
+TEST_F(APassScheduler, runs_the_first_pass_even_past_the_deadline) {
+    PassScheduler scheduler{100, 2, start};
+    EXPECT_THAT(scheduler.next_pass(start + 1s), Eq(2u));
+    scheduler.end_pass(start + 2s);
+    EXPECT_THAT(scheduler.next_pass(start + 2s), Eq(0u));
+    EXPECT_THAT(scheduler.samples_taken(), Eq(2u));
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -13,11 +13,19 @@ public:
         , normal_{unit_vector(cross(u, v))}
         , d_{dot(corner_, normal_)}
         , w_{cross(u, v) / (dot(cross(u, v), cross(u, v)))}
+        , axis_{normal_axis(u, v)}
         , aabb_{Aabb{AabbBounds{min_components(corner, corner + u + v),
-                                max_components(corner, corner + u + v)}}.pad()} {}
+                                max_components(corner, corner + u + v)}}.pad()}
+        , uv_scale_{1.0 / std::min(u.length(), v.length())} {}
+
+    // true if u and v are parallel to coordinate axes
+    bool is_axis_aligned() const { return axis_ >= 0; }
 
     // HittableI
     HitRecord hit(Ray const & ray, double t_min, double t_max) const override {
+        if (is_axis_aligned())
+            return hit_axis_aligned(ray, t_min, t_max);
+
         auto const denom = dot(ray.d, normal_);  // project direction onto normal
 
         if (std::abs(denom) < 1e-8)  // direction is parallel to plane
@@ -40,17 +48,90 @@ public:
         result.t = t;
         result.material_ptr = material_;
         result.uv = TextureCoordinates2d{alpha, beta};
+        result.uv_scale = uv_scale_;
+        result.object = this;
         return result;
     };
+
+    SurfaceSample sample_surface() const override {
+        auto const [alpha, beta] = random_2d();
+
+        HitRecord record;
+        record.p = corner_ + alpha * u_ + beta * v_;
+        record.normal = normal_;
+        record.side = FaceSide::front;
+        record.uv = TextureCoordinates2d{alpha, beta};
+        record.uv_scale = uv_scale_;
+        record.material_ptr = material_;
+        record.object = this;
+        return {record, 1.0 / cross(u_, v_).length()};
+    }
+    double surface_pdf(HitRecord const & rec) const override {
+        return 1.0 / cross(u_, v_).length();
+    }
+    double surface_pdf_from(point3 const & reference, HitRecord const & rec) const override {
+        return 1.0 / cross(u_, v_).length();
+    }
     Aabb bounding_box(TimeInterval times) const override { return aabb_; }
 
 private:
+    // For axis-aligned quads all terms of the dot and cross products in `hit`
+    // but one are zero. Evaluating only the remaining term yields the same
+    // floating point results with one division and two interval checks.
+    HitRecord hit_axis_aligned(Ray const & ray, double const t_min, double const t_max) const {
+        auto const n = static_cast<std::size_t>(axis_);
+        // normal_[n] is not exactly +-1, as unit_vector multiplies by the inverse length
+        auto const denom = ray.d[n] * normal_[n];
+        if (std::abs(denom) < 1e-8)  // direction is parallel to plane
+            return HitRecord::miss();
+
+        auto const t = (d_ - normal_[n] * ray.o[n]) / denom;
+        if (t < t_min || t_max < t)  // hit outside of ray interval
+            return HitRecord::miss();
+
+        auto const n1 = (n + 1) % 3;
+        auto const n2 = (n + 2) % 3;
+        auto const p1 = ray.o[n1] + t * ray.d[n1] - corner_[n1];
+        auto const p2 = ray.o[n2] + t * ray.d[n2] - corner_[n2];
+        auto const alpha = w_[n] * (p1 * v_[n2] - p2 * v_[n1]);
+        if (alpha < 0.0 || 1.0 < alpha)
+            return HitRecord::miss();
+        auto const beta = w_[n] * (u_[n1] * p2 - u_[n2] * p1);
+        if (beta < 0.0 || 1.0 < beta)
+            return HitRecord::miss();
+
+        HitRecord result;
+        result.p = ray.at(t);
+        result.set_face_normal(ray, normal_);
+        result.t = t;
+        result.material_ptr = material_;
+        result.uv = TextureCoordinates2d{alpha, beta};
+        result.uv_scale = uv_scale_;
+        result.object = this;
+        return result;
+    }
+
+    // axis of the normal if u and v are parallel to the two other axes, -1 otherwise
+    static int normal_axis(vec3 const & u, vec3 const & v) {
+        auto const single_axis = [](vec3 const & e) {
+            int const nonzero = (e.x != 0.0) + (e.y != 0.0) + (e.z != 0.0);
+            return nonzero != 1 ? -1 : e.x != 0.0 ? 0 : e.y != 0.0 ? 1 : 2;
+        };
+        auto const u_axis = single_axis(u);
+        auto const v_axis = single_axis(v);
+        if (u_axis < 0 || v_axis < 0 || u_axis == v_axis)
+            return -1;
+        return 3 - u_axis - v_axis;
+    }
+
     vec3 const corner_;
     vec3 const u_;
     vec3 const v_;
     vec3 const normal_;
     double const d_;
     vec3 const w_;  // entity cached to speed up hit computations
+    int const axis_;
     std::shared_ptr<MaterialI> const material_;
     Aabb const aabb_;
+    double const uv_scale_;  // along the shorter edge
 };
\ No newline at end of file
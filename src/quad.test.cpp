@@ -3,11 +3,15 @@
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
 
+#include <cmath>
 #include <memory>
 
 
+using testing::DoubleEq;
 using testing::Eq;
+using testing::Ge;
 using testing::Gt;
+using testing::Le;
 using testing::Test;
 
 
@@ -63,6 +67,77 @@ TEST_F(AnAxisAlignedQuad, returns_correct_hit_location) {
     EXPECT_THAT(hit_record.uv, Eq(TextureCoordinates2d{0.25, 0.5}));
 }
 
+TEST_F(AnAxisAlignedQuad, samples_points_on_its_surface) {
+    for (int ii = 0; ii < 100; ++ii) {
+        auto const sample = quad.sample_surface();
+        auto const uv = sample.record.uv;
+        EXPECT_THAT(sample.record.p, Eq(corner + uv.u * u + uv.v * v));
+        EXPECT_THAT(uv.u, Ge(0.0));
+        EXPECT_THAT(uv.u, Le(1.0));
+        EXPECT_THAT(uv.v, Ge(0.0));
+        EXPECT_THAT(uv.v, Le(1.0));
+    }
+}
+
+TEST_F(AnAxisAlignedQuad, has_uniform_area_pdf) {
+    EXPECT_THAT(quad.sample_surface().pdf, DoubleEq(0.5));
+}
+
+TEST_F(AnAxisAlignedQuad, is_detected_as_axis_aligned) {
+    EXPECT_TRUE(quad.is_axis_aligned());
+}
+
+TEST(Quad, is_not_axis_aligned_with_skewed_edges) {
+    Quad const quad{vec3{0.0}, vec3{1.0, 1.0, 0.0}, vec3{0.0, 0.0, 1.0}, std::make_shared<DummyMaterial>()};
+    EXPECT_FALSE(quad.is_axis_aligned());
+}
+
+// the general intersection of `Quad::hit`
+HitRecord general_quad_hit(vec3 const & corner, vec3 const & u, vec3 const & v, Ray const & ray) {
+    auto const normal = unit_vector(cross(u, v));
+    auto const w = cross(u, v) / (dot(cross(u, v), cross(u, v)));
+    auto const denom = dot(ray.d, normal);
+    if (std::abs(denom) < 1e-8)
+        return HitRecord::miss();
+    auto const t = (dot(corner, normal) - dot(normal, ray.o)) / denom;
+    if (t < 0.0)
+        return HitRecord::miss();
+    vec3 const p = ray.at(t) - corner;
+    auto const alpha = dot(w, cross(p, v));
+    auto const beta = dot(w, cross(u, p));
+    if (alpha < 0.0 || 1.0 < alpha || beta < 0.0 || 1.0 < beta)
+        return HitRecord::miss();
+    HitRecord result;
+    result.p = ray.at(t);
+    result.t = t;
+    result.uv = TextureCoordinates2d{alpha, beta};
+    return result;
+}
+
+TEST(Quad, axis_aligned_hits_equal_the_general_intersection) {
+    for (int ii = 0; ii < 10000; ++ii) {
+        auto const u_axis = random_int(0, 2);
+        auto const v_axis = (u_axis + random_int(1, 2)) % 3;
+        vec3 u{0.0}, v{0.0};
+        u[u_axis] = random_double(-2.0, 2.0);
+        v[v_axis] = random_double(-2.0, 2.0);
+        point3 const corner = point3::random(-1.0, 1.0);
+        Quad const quad{corner, u, v, std::make_shared<DummyMaterial>()};
+        ASSERT_TRUE(quad.is_axis_aligned());
+
+        point3 const origin = point3::random(-3.0, 3.0);
+        Ray const ray{origin, corner + random_double(-0.2, 1.2) * u + random_double(-0.2, 1.2) * v - origin};
+        auto const expected = general_quad_hit(corner, u, v, ray);
+        auto const actual = quad.hit(ray, 0.0, infinity);
+        ASSERT_THAT(bool{actual}, Eq(bool{expected}));
+        if (expected) {
+            EXPECT_THAT(actual.t, Eq(expected.t));
+            EXPECT_THAT(actual.p, Eq(expected.p));
+            EXPECT_THAT(actual.uv, Eq(expected.uv));
+        }
+    }
+}
+
 int main(int argc, char ** argv)
 {
     ::testing::InitGoogleTest(&argc, argv);
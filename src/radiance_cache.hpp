@@ -0,0 +1,117 @@
+#pragma once
+
+#include <color.hpp>
+#include <common.hpp>
+#include <vec3.hpp>
+
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+// Light reflected by diffuse surfaces, averaged over the cells of a hash
+// grid over positions and normals. The cells hold the reflected radiance
+// per unit albedo, i.e. the cosine weighted incident radiance over pi, so
+// that textured surfaces share them. Threads record and look up
+// concurrently without locks; records that find no free entry within
+// `max_probes` of their hash are dropped.
+class RadianceCache {
+public:
+    // probes of the open addressing
+    static constexpr int max_probes{16};
+
+    // `capacity` is rounded up to a power of two
+    explicit RadianceCache(double cell_size, std::uint32_t min_samples = 16, std::size_t capacity = 1 << 18);
+
+    double cell_size() const { return cell_size_; }
+
+    // mean of the cell of `p` and `normal`, if it has `min_samples` records
+    std::optional<color> lookup(point3 const & p, vec3 const & normal) const;
+
+    void record(point3 const & p, vec3 const & normal, color const & value);
+
+    // with at least one record
+    std::size_t number_of_cells() const;
+
+private:
+    struct Entry {
+        std::atomic<std::uint64_t> key{0};  // 0 for free entries
+        std::atomic<double> sum[3]{};
+        std::atomic<std::uint32_t> count{0};
+    };
+
+    // 20 bits per coordinate of the cell, 3 for the dominant axis of the
+    // normal and its sign, and a top bit that keeps keys from being 0
+    std::uint64_t key(point3 const & p, vec3 const & normal) const {
+        auto const quantized = [this](double const x) {
+            return static_cast<std::uint64_t>(static_cast<std::int64_t>(std::floor(x / cell_size_)) + (1 << 19)) & 0xfffff;
+        };
+        auto const ax = std::abs(normal.x), ay = std::abs(normal.y), az = std::abs(normal.z);
+        int const axis = ax >= ay && ax >= az ? 0 : (ay >= az ? 1 : 2);
+        std::uint64_t const direction = 2 * axis + (normal[axis] < 0.0 ? 1 : 0);
+        return std::uint64_t{1} << 63 | quantized(p.x) << 43 | quantized(p.y) << 23 | quantized(p.z) << 3 | direction;
+    }
+
+    std::size_t slot(std::uint64_t key) const {
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdu;
+        key ^= key >> 33;
+        return static_cast<std::size_t>(key) & (capacity_ - 1);
+    }
+
+    double cell_size_;
+    std::uint32_t min_samples_;
+    std::size_t capacity_;
+    std::unique_ptr<Entry[]> entries_;
+};
+
+inline RadianceCache::RadianceCache(double const cell_size, std::uint32_t const min_samples, std::size_t const capacity)
+    : cell_size_{cell_size}, min_samples_{min_samples}, capacity_{1} {
+    while (capacity_ < capacity)
+        capacity_ *= 2;
+    entries_ = std::make_unique<Entry[]>(capacity_);
+}
+
+inline std::optional<color> RadianceCache::lookup(point3 const & p, vec3 const & normal) const {
+    auto const k = key(p, normal);
+    auto index = slot(k);
+    for (int probe = 0; probe < max_probes; ++probe, index = (index + 1) & (capacity_ - 1)) {
+        auto const & entry = entries_[index];
+        auto const stored = entry.key.load(std::memory_order_relaxed);
+        if (stored == 0)
+            return std::nullopt;
+        if (stored != k)
+            continue;
+        auto const count = entry.count.load(std::memory_order_relaxed);
+        if (count < min_samples_)
+            return std::nullopt;
+        return color{entry.sum[0].load(std::memory_order_relaxed),
+                     entry.sum[1].load(std::memory_order_relaxed),
+                     entry.sum[2].load(std::memory_order_relaxed)} / count;
+    }
+    return std::nullopt;
+}
+
+inline void RadianceCache::record(point3 const & p, vec3 const & normal, color const & value) {
+    auto const k = key(p, normal);
+    auto index = slot(k);
+    for (int probe = 0; probe < max_probes; ++probe, index = (index + 1) & (capacity_ - 1)) {
+        auto & entry = entries_[index];
+        std::uint64_t expected = 0;
+        if (!entry.key.compare_exchange_strong(expected, k, std::memory_order_relaxed) && expected != k)
+            continue;
+        for (int c = 0; c < 3; ++c)
+            atomic_add(entry.sum[c], value[c]);
+        entry.count.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+}
+
+inline std::size_t RadianceCache::number_of_cells() const {
+    std::size_t result = 0;
+    for (std::size_t ii = 0; ii < capacity_; ++ii)
+        result += entries_[ii].count.load(std::memory_order_relaxed) > 0;
+    return result;
+}
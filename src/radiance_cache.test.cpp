@@ -0,0 +1,82 @@
+#include <radiance_cache.hpp>
+
+#include <color.hpp>
+#include <vec3.hpp>
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <thread>
+#include <vector>
+
+
+using testing::DoubleNear;
+using testing::Eq;
+using testing::Test;
+
+
+struct ARadianceCache : Test {
+public:
+    RadianceCache cache{1.0, 4};
+    vec3 const up{0.0, 1.0, 0.0};
+};
+
+TEST_F(ARadianceCache, knows_nothing_before_enough_records) {
+    EXPECT_FALSE(cache.lookup(point3{0.5}, up));
+    for (int ii = 0; ii < 3; ++ii)
+        cache.record(point3{0.5}, up, color{1.0});
+    EXPECT_FALSE(cache.lookup(point3{0.5}, up));
+    cache.record(point3{0.5}, up, color{1.0});
+    EXPECT_TRUE(cache.lookup(point3{0.5}, up));
+}
+
+TEST_F(ARadianceCache, averages_the_records_of_a_cell) {
+    for (int ii = 0; ii < 4; ++ii)
+        cache.record(point3{0.1 + 0.2 * ii, 0.5, 0.5}, up, color{1.0 * ii, 2.0, 0.0});
+    auto const cached = cache.lookup(point3{0.9, 0.9, 0.1}, up);
+    ASSERT_TRUE(cached);
+    EXPECT_THAT(*cached, Eq(color{1.5, 2.0, 0.0}));
+    EXPECT_THAT(cache.number_of_cells(), Eq(1u));
+}
+
+TEST_F(ARadianceCache, separates_cells_by_position_and_normal) {
+    for (int ii = 0; ii < 4; ++ii) {
+        cache.record(point3{0.5}, up, color{1.0});
+        cache.record(point3{1.5, 0.5, 0.5}, up, color{2.0});
+        cache.record(point3{0.5}, -up, color{3.0});
+        cache.record(point3{-0.5, 0.5, 0.5}, up, color{4.0});
+    }
+    EXPECT_THAT(cache.number_of_cells(), Eq(4u));
+    EXPECT_THAT(*cache.lookup(point3{0.5}, vec3{0.1, 0.9, 0.1}), Eq(color{1.0}));
+    EXPECT_THAT(*cache.lookup(point3{1.5, 0.5, 0.5}, up), Eq(color{2.0}));
+    EXPECT_THAT(*cache.lookup(point3{0.5}, -up), Eq(color{3.0}));
+    EXPECT_THAT(*cache.lookup(point3{-0.5, 0.5, 0.5}, up), Eq(color{4.0}));
+}
+
+TEST_F(ARadianceCache, records_from_threads_concurrently) {
+    int const records = 10000;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+        threads.emplace_back([this, t] {
+            for (int ii = 0; ii < records; ++ii)
+                cache.record(point3{0.5 + ii % 8, 0.5, 0.5}, up, color{1.0 * t});
+        });
+    for (auto & thread : threads)
+        thread.join();
+    EXPECT_THAT(cache.number_of_cells(), Eq(8u));
+    for (int ii = 0; ii < 8; ++ii)
+        EXPECT_THAT(cache.lookup(point3{0.5 + ii, 0.5, 0.5}, up)->x, DoubleNear(1.5, 1e-12));
+}
+
+TEST(AFullRadianceCache, drops_records) {
+    RadianceCache cache{1.0, 1, RadianceCache::max_probes};
+    for (int ii = 0; ii < 2 * RadianceCache::max_probes; ++ii)
+        cache.record(point3{ii + 0.5, 0.5, 0.5}, vec3{0.0, 1.0, 0.0}, color{1.0});
+    EXPECT_THAT(cache.number_of_cells(), Eq(static_cast<std::size_t>(RadianceCache::max_probes)));
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
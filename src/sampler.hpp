@@ -0,0 +1,312 @@
+#pragma once
+
+#include <common.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+
+// Samplers provide the random numbers of one pixel sample, one dimension (a
+// call of `get_1d` or `get_2d`) after the other. `render_rows` installs one
+// per thread with `ScopedRandomSource`, so that the camera, the materials and
+// the lights draw from it through `random_double` and `random_2d`. The
+// samples of a pixel are stratified per dimension, which pays off as long as
+// paths request the same quantities in the same order.
+class SamplerI : public RandomSourceI {
+public:
+    // starts sample `index` of pixel (x, y), skipping `dimension` dimensions
+    virtual void start_pixel_sample(int x, int y, std::uint32_t index, std::uint32_t dimension = 0) = 0;
+};
+
+namespace ns_sampler {
+    // Chris Wellons' lowbias32
+    inline std::uint32_t hash(std::uint32_t x) {
+        x ^= x >> 16;
+        x *= 0x7feb352du;
+        x ^= x >> 15;
+        x *= 0x846ca68bu;
+        x ^= x >> 16;
+        return x;
+    }
+
+    inline std::uint32_t hash_combine(std::uint32_t const seed, std::uint32_t const value) {
+        return seed ^ (hash(value) + 0x9e3779b9u + (seed << 6) + (seed >> 2));
+    }
+
+    inline std::uint32_t hash(int const x, int const y, std::uint32_t const z, std::uint32_t const w) {
+        return hash(hash_combine(hash_combine(hash_combine(hash(static_cast<std::uint32_t>(x)),
+                                                           static_cast<std::uint32_t>(y)), z), w));
+    }
+
+    inline double to_unit(std::uint32_t const x) { return x * (1.0 / 4294967296.0); }
+
+    // element `index` of a pseudo-random permutation of [0, length) chosen by
+    // `seed`, after Kensler ("Correlated Multi-Jittered Sampling")
+    inline std::uint32_t permute(std::uint32_t index, std::uint32_t const length, std::uint32_t const seed) {
+        std::uint32_t w = length - 1;
+        w |= w >> 1;
+        w |= w >> 2;
+        w |= w >> 4;
+        w |= w >> 8;
+        w |= w >> 16;
+        do {
+            index ^= seed;
+            index *= 0xe170893du;
+            index ^= seed >> 16;
+            index ^= (index & w) >> 4;
+            index ^= seed >> 8;
+            index *= 0x0929eb3fu;
+            index ^= seed >> 23;
+            index ^= (index & w) >> 1;
+            index *= 1u | seed >> 27;
+            index *= 0x6935fa69u;
+            index ^= (index & w) >> 11;
+            index *= 0x74dcb303u;
+            index ^= (index & w) >> 2;
+            index *= 0x9e501cc3u;
+            index ^= (index & w) >> 2;
+            index *= 0xc860a3dfu;
+            index &= w;
+            index ^= index >> 5;
+        } while (index >= length);
+        return (index + seed) % length;
+    }
+
+    // direction numbers of the first two Sobol dimensions, the second from
+    // the primitive polynomial x + 1 of Joe and Kuo's table
+    inline constexpr std::array<std::array<std::uint32_t, 32>, 2> sobol_directions = [] {
+        std::array<std::array<std::uint32_t, 32>, 2> result{};
+        for (std::size_t bit = 0; bit < 32; ++bit)
+            result[0][bit] = 1u << (31 - bit);
+        result[1][0] = 1u << 31;
+        for (std::size_t bit = 1; bit < 32; ++bit)
+            result[1][bit] = result[1][bit - 1] ^ (result[1][bit - 1] >> 1);
+        return result;
+    }();
+
+    inline std::uint32_t reverse_bits(std::uint32_t x) {
+        x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+        x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+        x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+        x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+        return (x >> 16) | (x << 16);
+    }
+
+    inline std::uint32_t sobol(std::uint32_t index, std::size_t const dimension) {
+        if (dimension == 0)
+            return reverse_bits(index);
+        std::uint32_t result = 0;
+        for (std::size_t bit = 0; index != 0; index >>= 1, ++bit)
+            if (index & 1u)
+                result ^= sobol_directions[dimension][bit];
+        return result;
+    }
+
+    // Owen scrambling with the hash of Laine and Karras, as in Burley
+    // ("Practical Hash-based Owen Scrambling")
+    inline std::uint32_t owen_scramble(std::uint32_t x, std::uint32_t const seed) {
+        x = reverse_bits(x);
+        x += seed;
+        x ^= x * 0x6c50b47cu;
+        x ^= x * 0xb82f1e52u;
+        x ^= x * 0xc7afe638u;
+        x ^= x * 0x8d22f6e6u;
+        return reverse_bits(x);
+    }
+
+    // Point `index` of a 2d Sobol sequence, shuffled and Owen scrambled by
+    // `seed`. Different seeds give independent sequences, which pads the
+    // dimensions of a sample with decorrelated pairs. The shuffle maps every
+    // aligned block of 2^k indices to another one, so the first 2^k samples
+    // stay a net, and all 2^32 indices to distinct points.
+    inline std::array<double, 2> scrambled_sobol_2d(std::uint32_t index, std::uint32_t const seed) {
+        index = owen_scramble(index, seed);
+        return {to_unit(owen_scramble(sobol(index, 0), hash_combine(seed, 0))),
+                to_unit(owen_scramble(sobol(index, 1), hash_combine(seed, 1)))};
+    }
+
+    inline constexpr int blue_noise_size{64};
+
+    // Ranks in [0, 1) on a toroidal `blue_noise_size`^2 tile whose low
+    // frequencies are weak. Each pixel in turn is assigned to the largest
+    // void, the free pixel with the least energy from the assigned pixels
+    // under a Gaussian kernel, as in the void and cluster method of Ulichney.
+    inline std::vector<double> const & blue_noise_mask() {
+        static std::vector<double> const mask = [] {
+            constexpr int n = blue_noise_size;
+            constexpr double sigma = 1.5;
+            std::vector<double> kernel(n * n);
+            for (int y = 0; y < n; ++y)
+                for (int x = 0; x < n; ++x) {
+                    auto const dx = std::min(x, n - x);
+                    auto const dy = std::min(y, n - y);
+                    kernel[y * n + x] = std::exp(-(dx * dx + dy * dy) / (2.0 * sigma * sigma));
+                }
+
+            // tiny random energies break the ties of the first pixels
+            std::vector<double> energy(n * n);
+            for (std::size_t ii = 0; ii < energy.size(); ++ii)
+                energy[ii] = 1e-6 * to_unit(hash(static_cast<std::uint32_t>(ii)));
+            std::vector<double> result(n * n, -1.0);
+            for (int rank = 0; rank < n * n; ++rank) {
+                int best = -1;
+                for (int ii = 0; ii < n * n; ++ii)
+                    if (result[ii] < 0.0 && (best < 0 || energy[ii] < energy[best]))
+                        best = ii;
+                result[best] = (rank + 0.5) / (n * n);
+                int const bx = best % n, by = best / n;
+                for (int y = 0; y < n; ++y)
+                    for (int x = 0; x < n; ++x)
+                        energy[y * n + x] += kernel[((y - by + n) % n) * n + (x - bx + n) % n];
+            }
+            return result;
+        }();
+        return mask;
+    }
+}
+
+//-------------------------------------------------------------------independent
+// Uncorrelated numbers, like the default of `random_double`.
+class IndependentSampler : public SamplerI {
+public:
+    void start_pixel_sample(int, int, std::uint32_t, std::uint32_t) override {}
+    double get_1d() override { return distribution_(generator_); }
+    std::array<double, 2> get_2d() override { return {get_1d(), get_1d()}; }
+
+private:
+    std::mt19937 generator_;
+    std::uniform_real_distribution<double> distribution_{0.0, 1.0};
+};
+
+//-------------------------------------------------------------------stratified
+// Jittered strata, one per sample of `samples_per_pixel`, randomly permuted
+// per pixel and dimension. `get_2d` stratifies on a grid if
+// `samples_per_pixel` is a square, and as a Latin hypercube otherwise. Each
+// further `samples_per_pixel` samples use new permutations.
+class StratifiedSampler : public SamplerI {
+public:
+    explicit StratifiedSampler(std::uint32_t const samples_per_pixel)
+        : samples_per_pixel_{std::max(samples_per_pixel, 1u)}
+        , grid_size_{static_cast<std::uint32_t>(std::sqrt(static_cast<double>(samples_per_pixel_)))} {}
+
+    void start_pixel_sample(int const x, int const y, std::uint32_t const index, std::uint32_t const dimension = 0) override {
+        index_ = index;
+        dimension_ = dimension;
+        permutation_seed_ = ns_sampler::hash(x, y, index / samples_per_pixel_, 0x57a7u);
+        jitter_seed_ = ns_sampler::hash(x, y, index, 0x3177u);
+    }
+
+    double get_1d() override { return stratified_1d(dimension_++, 0); }
+
+    std::array<double, 2> get_2d() override {
+        auto const dimension = dimension_++;
+        if (grid_size_ * grid_size_ != samples_per_pixel_)
+            return {stratified_1d(dimension, 0), stratified_1d(dimension, 1)};
+        auto const stratum = ns_sampler::permute(index_ % samples_per_pixel_, samples_per_pixel_, seed(dimension, 0));
+        return {(stratum % grid_size_ + jitter(dimension, 0)) / grid_size_,
+                (stratum / grid_size_ + jitter(dimension, 1)) / grid_size_};
+    }
+
+private:
+    double stratified_1d(std::uint32_t const dimension, std::uint32_t const component) const {
+        auto const stratum = ns_sampler::permute(index_ % samples_per_pixel_, samples_per_pixel_, seed(dimension, component));
+        return (stratum + jitter(dimension, component)) / samples_per_pixel_;
+    }
+
+    std::uint32_t seed(std::uint32_t const dimension, std::uint32_t const component) const {
+        return ns_sampler::hash_combine(permutation_seed_, 2 * dimension + component);
+    }
+
+    double jitter(std::uint32_t const dimension, std::uint32_t const component) const {
+        return ns_sampler::to_unit(ns_sampler::hash(ns_sampler::hash_combine(jitter_seed_, 2 * dimension + component)));
+    }
+
+    std::uint32_t samples_per_pixel_;
+    std::uint32_t grid_size_;
+    std::uint32_t index_{0}, dimension_{0};
+    std::uint32_t permutation_seed_{0}, jitter_seed_{0};
+};
+
+//-------------------------------------------------------------------sobol
+// Owen scrambled 2d Sobol points, shuffled and scrambled independently per
+// pixel and dimension. The first 2^k samples of a pixel stratify each
+// `get_2d` into 2^k elementary intervals of any shape.
+class SobolSampler : public SamplerI {
+public:
+    void start_pixel_sample(int const x, int const y, std::uint32_t const index, std::uint32_t const dimension = 0) override {
+        index_ = index;
+        dimension_ = dimension;
+        pixel_seed_ = ns_sampler::hash(x, y, 0x50b01u, 0u);
+    }
+
+    double get_1d() override { return get_2d()[0]; }
+
+    std::array<double, 2> get_2d() override {
+        return ns_sampler::scrambled_sobol_2d(index_, ns_sampler::hash(ns_sampler::hash_combine(pixel_seed_, dimension_++)));
+    }
+
+private:
+    std::uint32_t index_{0}, dimension_{0};
+    std::uint32_t pixel_seed_{0};
+};
+
+//-------------------------------------------------------------------blue noise
+// The same scrambled Sobol sequence for all pixels, shifted toroidally by a
+// blue noise mask per pixel (Georgiev and Fajardo, "Blue-noise Dithered
+// Sampling"). The error of neighbouring pixels is anti-correlated, which
+// looks like high frequency noise at low sample counts.
+class BlueNoiseSampler : public SamplerI {
+public:
+    BlueNoiseSampler() : mask_{ns_sampler::blue_noise_mask()} {}
+
+    void start_pixel_sample(int const x, int const y, std::uint32_t const index, std::uint32_t const dimension = 0) override {
+        x_ = x;
+        y_ = y;
+        index_ = index;
+        dimension_ = dimension;
+    }
+
+    double get_1d() override { return get_2d()[0]; }
+
+    std::array<double, 2> get_2d() override {
+        auto const dimension = dimension_++;
+        auto const point = ns_sampler::scrambled_sobol_2d(index_, ns_sampler::hash(dimension + 0xb1u));
+        return {shift(point[0], dimension, 0), shift(point[1], dimension, 1)};
+    }
+
+private:
+    // the mask is offset per dimension and component, to decorrelate them
+    double shift(double const u, std::uint32_t const dimension, std::uint32_t const component) const {
+        constexpr int n = ns_sampler::blue_noise_size;
+        auto const offset = ns_sampler::hash(static_cast<std::uint32_t>(2 * dimension + component));
+        auto const x = (x_ + static_cast<int>(offset % n)) & (n - 1);
+        auto const y = (y_ + static_cast<int>((offset / n) % n)) & (n - 1);
+        auto const shifted = u + mask_[y * n + x];
+        return shifted < 1.0 ? shifted : shifted - 1.0;
+    }
+
+    std::vector<double> const & mask_;
+    int x_{0}, y_{0};
+    std::uint32_t index_{0}, dimension_{0};
+};
+
+enum class SamplerType { independent, stratified, sobol, blue_noise };
+
+inline std::unique_ptr<SamplerI> make_sampler(SamplerType const type, std::uint32_t const samples_per_pixel) {
+    switch (type) {
+    case SamplerType::independent:
+        return std::make_unique<IndependentSampler>();
+    case SamplerType::stratified:
+        return std::make_unique<StratifiedSampler>(samples_per_pixel);
+    case SamplerType::sobol:
+        return std::make_unique<SobolSampler>();
+    case SamplerType::blue_noise:
+        return std::make_unique<BlueNoiseSampler>();
+    }
+    return std::make_unique<IndependentSampler>();
+}
@@ -0,0 +1,161 @@
+#include <sampler.hpp>
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <vector>
+
+
+using testing::Each;
+using testing::Eq;
+using testing::Ge;
+using testing::Gt;
+using testing::Lt;
+using testing::Test;
+
+
+TEST(Permute, is_a_permutation) {
+    for (std::uint32_t const length : {1u, 5u, 16u, 100u}) {
+        std::vector<std::uint32_t> permuted;
+        for (std::uint32_t ii = 0; ii < length; ++ii)
+            permuted.push_back(ns_sampler::permute(ii, length, 1234u));
+        std::sort(std::begin(permuted), std::end(permuted));
+        for (std::uint32_t ii = 0; ii < length; ++ii)
+            EXPECT_THAT(permuted[ii], Eq(ii));
+    }
+}
+
+TEST(ScrambledSobol2d, is_stratified_in_all_elementary_intervals) {
+    // 16 points, one in every cell of the 1x16, 2x8, 4x4, 8x2 and 16x1 grids
+    for (std::uint32_t const seed : {0u, 7u, 123456u}) {
+        for (int log_columns = 0; log_columns <= 4; ++log_columns) {
+            int const columns = 1 << log_columns;
+            int const rows = 16 / columns;
+            std::vector<int> counts(16, 0);
+            for (std::uint32_t ii = 0; ii < 16; ++ii) {
+                auto const [u, v] = ns_sampler::scrambled_sobol_2d(ii, seed);
+                ++counts[static_cast<int>(v * rows) * columns + static_cast<int>(u * columns)];
+            }
+            EXPECT_THAT(counts, Each(Eq(1)));
+        }
+    }
+}
+
+TEST(BlueNoiseMask, holds_every_rank_once) {
+    auto mask = ns_sampler::blue_noise_mask();
+    std::sort(std::begin(mask), std::end(mask));
+    auto const n = static_cast<int>(mask.size());
+    for (int ii = 0; ii < n; ++ii)
+        EXPECT_THAT(mask[ii], Eq((ii + 0.5) / n));
+}
+
+TEST(BlueNoiseMask, differs_more_between_neighbours_than_white_noise) {
+    auto const & mask = ns_sampler::blue_noise_mask();
+    constexpr int n = ns_sampler::blue_noise_size;
+    double difference = 0.0;
+    for (int y = 0; y < n; ++y)
+        for (int x = 0; x < n; ++x)
+            difference += std::abs(mask[y * n + x] - mask[y * n + (x + 1) % n]) / (n * n);
+    // 1/3 for independent uniform neighbours
+    EXPECT_THAT(difference, Gt(0.4));
+}
+
+TEST(StratifiedSampler, puts_one_sample_per_stratum_into_every_dimension) {
+    StratifiedSampler sampler{8};
+    std::vector<std::vector<int>> counts(3, std::vector<int>(8, 0));
+    for (std::uint32_t index = 0; index < 8; ++index) {
+        sampler.start_pixel_sample(3, 4, index);
+        for (std::size_t dimension = 0; dimension < 3; ++dimension)
+            ++counts[dimension][static_cast<int>(sampler.get_1d() * 8)];
+    }
+    for (auto const & count : counts)
+        EXPECT_THAT(count, Each(Eq(1)));
+}
+
+TEST(StratifiedSampler, stratifies_2d_dimensions_on_a_grid) {
+    StratifiedSampler sampler{16};
+    std::vector<int> counts(16, 0);
+    for (std::uint32_t index = 0; index < 16; ++index) {
+        sampler.start_pixel_sample(3, 4, index);
+        auto const [u, v] = sampler.get_2d();
+        ++counts[static_cast<int>(v * 4) * 4 + static_cast<int>(u * 4)];
+    }
+    EXPECT_THAT(counts, Each(Eq(1)));
+}
+
+struct AllSamplers : Test {
+public:
+    std::vector<std::unique_ptr<SamplerI>> const samplers = [] {
+        std::vector<std::unique_ptr<SamplerI>> result;
+        for (auto const type : {SamplerType::independent, SamplerType::stratified, SamplerType::sobol, SamplerType::blue_noise})
+            result.push_back(make_sampler(type, 16));
+        return result;
+    }();
+};
+
+TEST_F(AllSamplers, return_numbers_in_the_unit_interval) {
+    for (auto const & sampler : samplers)
+        for (std::uint32_t index = 0; index < 64; ++index) {
+            sampler->start_pixel_sample(static_cast<int>(index % 7), 5, index);
+            for (int dimension = 0; dimension < 10; ++dimension) {
+                auto const u = sampler->get_1d();
+                auto const [v, w] = sampler->get_2d();
+                for (auto const x : {u, v, w}) {
+                    EXPECT_THAT(x, Ge(0.0));
+                    EXPECT_THAT(x, Lt(1.0));
+                }
+            }
+        }
+}
+
+// all but the independent sampler
+TEST_F(AllSamplers, repeat_a_sample_when_restarted) {
+    for (std::size_t ii = 1; ii < samplers.size(); ++ii) {
+        auto & sampler = *samplers[ii];
+        sampler.start_pixel_sample(2, 3, 5);
+        auto const first = sampler.get_1d();
+        auto const second = sampler.get_2d();
+        sampler.start_pixel_sample(2, 3, 5, 1);
+        EXPECT_THAT(sampler.get_2d(), Eq(second));
+        sampler.start_pixel_sample(2, 3, 5);
+        EXPECT_THAT(sampler.get_1d(), Eq(first));
+    }
+}
+
+// all but the independent sampler
+TEST_F(AllSamplers, keep_drawing_new_points_past_2_to_the_16_samples) {
+    for (std::size_t ii = 1; ii < samplers.size(); ++ii) {
+        auto & sampler = *samplers[ii];
+        std::vector<std::array<double, 2>> points;
+        for (std::uint32_t index = 0; index < 65536; ++index) {
+            sampler.start_pixel_sample(2, 3, index, 4);
+            points.push_back(sampler.get_2d());
+        }
+        std::sort(std::begin(points), std::end(points));
+        for (std::uint32_t const index : {65536u, 65537u, 200000u}) {
+            sampler.start_pixel_sample(2, 3, index, 4);
+            EXPECT_FALSE(std::binary_search(std::begin(points), std::end(points), sampler.get_2d()));
+        }
+    }
+}
+
+TEST_F(AllSamplers, can_replace_random_double) {
+    for (std::size_t ii = 1; ii < samplers.size(); ++ii) {
+        auto & sampler = *samplers[ii];
+        ScopedRandomSource const source{sampler};
+        sampler.start_pixel_sample(0, 0, 3);
+        auto const expected = sampler.get_1d();
+        sampler.start_pixel_sample(0, 0, 3);
+        EXPECT_THAT(random_double(), Eq(expected));
+    }
+    EXPECT_THAT(ns_common::random_source(), Eq(nullptr));
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
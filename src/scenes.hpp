@@ -1,16 +1,27 @@
 #pragma once
+#include <bvh.hpp>
 #include <camera.hpp>
 #include <color.hpp>
+#include <environment.hpp>
 #include <vec3.hpp>
 
 #include <hittable_list.hpp>
 #include <hittables.hpp>
+#include <light_bvh.hpp>
 #include <material.hpp>
 #include <moving_sphere.hpp>
+#include <particle_cloud.hpp>
+#include <photon_map.hpp>
 #include <quad.hpp>
 #include <ray.hpp>
 #include <scenes.hpp>
 #include <sphere.hpp>
+#include <volume.hpp>
+
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <vector>
 
 enum class SceneID {
     random_spheres,
@@ -21,7 +32,9 @@ enum class SceneID {
     simple_light,
     cornell_box,
     cornell_smoke,
+    cornell_cloud,
     final_scene,
+    many_lights,
 };
 
 using BackgroundFunction = std::function<color(Ray const &)>;
@@ -30,8 +43,39 @@ struct Scene {
     HittableList world;
     BackgroundFunction background_color;
     Camera camera;
+    LightBvh lights;                                        // emitters that are sampled explicitly
+    std::vector<std::shared_ptr<ConstantMedium>> media{};   // media lit by sampling `lights`
+    std::shared_ptr<EnvironmentMap const> environment{};    // sampled explicitly if set, `background_color` must match it
+    std::shared_ptr<PhotonMap const> caustics{};            // from `lights` through specular surfaces, if set
+    double pixel_spread{0.0};                               // of the camera rays, 0 for point sampled textures
 };
 
+// emissive primitives of `world` that support surface sampling, including
+// those inside of nested lists such as boxes
+HittableList collect_lights(HittableList const & world) {
+    HittableList result;
+    for (auto const & object : world.objects) {
+        if (auto const list = std::dynamic_pointer_cast<HittableList>(object)) {
+            for (auto const & light : collect_lights(*list).objects)
+                result.add(light);
+            continue;
+        }
+        auto const sample = object->sample_surface();
+        if (sample.pdf > 0.0 && sample.record.material_ptr && sample.record.material_ptr->is_emissive())
+            result.add(object);
+    }
+    return result;
+}
+
+// top level constant density media of `world`
+std::vector<std::shared_ptr<ConstantMedium>> collect_media(HittableList const & world) {
+    std::vector<std::shared_ptr<ConstantMedium>> result;
+    for (auto const & object : world.objects)
+        if (auto medium = std::dynamic_pointer_cast<ConstantMedium>(object))
+            result.push_back(medium);
+    return result;
+}
+
 color default_background(Ray const & ray) {
     vec3 const unit_direction = unit_vector(ray.d);
     auto t = 0.5 * (unit_direction.y + 1.0);
@@ -207,6 +251,30 @@ HittableList cornell_smoke() {
     return world;
 }
 
+HittableList cornell_cloud() {
+    HittableList world = cornell_box_base();
+
+    // turbulent noise fading out towards the surface of a ball
+    int const resolution = 64;
+    Perlin const noise;
+    auto const grid = std::make_shared<SparseVoxelGrid>(GridResolution{resolution, resolution, resolution});
+    for (int k = 0; k < resolution; ++k)
+        for (int j = 0; j < resolution; ++j)
+            for (int i = 0; i < resolution; ++i) {
+                vec3 const local = (vec3{static_cast<double>(i), static_cast<double>(j), static_cast<double>(k)} + vec3{0.5})
+                                 / resolution;
+                auto const falloff = std::clamp(1.0 - 2.0 * (local - vec3{0.5}).length(), 0.0, 1.0);
+                auto const density = falloff * noise.turbulence(4.0 * local);
+                if (density > 0.01)
+                    grid->set(i, j, k, density);
+            }
+
+    Aabb const bounds{AabbBounds{point3{100.0, 50.0, 150.0}, point3{455.0, 405.0, 505.0}}};
+    world.add(std::make_shared<HeterogeneousMedium>(grid, bounds, 0.05, color{0.9, 0.9, 0.9}));
+
+    return world;
+}
+
 HittableList final_scene() {
     HittableList boxes1;
     // floor
@@ -237,8 +305,8 @@ HittableList final_scene() {
     auto const sphere_material = std::make_shared<lambertian>(color{0.7, 0.3, 0.1});
     world.add(std::make_shared<MovingSphere>(center1, center2, 0.0, 1.0, 50.0, sphere_material));
 
-    // glass sphere
-    world.add(std::make_shared<Sphere>(point3{260.0, 150.0, 45.0}, 50.0, std::make_shared<dielectric>(1.5)));
+    // glass sphere, dispersive like flint glass with the `spectral` engine
+    world.add(std::make_shared<Sphere>(point3{260.0, 150.0, 45.0}, 50.0, std::make_shared<dielectric>(1.5, 0.01)));
     // metal sphere
     world.add(std::make_shared<Sphere>(point3{0.0, 150.0, 145.0}, 50.0, std::make_shared<metal>(color{0.8, 0.8, 0.0}, 1.0)));
 
@@ -258,19 +326,42 @@ HittableList final_scene() {
     world.add(std::make_shared<Sphere>(point3{220.0, 280.0 ,300.0}, 80.0, std::make_shared<lambertian>(pertext)));
 
     // spheres in a box
-    HittableList boxes2;
     auto const white = std::make_shared<lambertian>(color{0.73, 0.73, 0.73});
     int const ns = 1000;
-    for (int j = 0; j < ns; j++)
-        boxes2.add(std::make_shared<Sphere>(point3::random(0.0,165.0), 10.0, white));
+    std::vector<point3> centers(ns);
+    for (auto & center : centers)
+        center = point3::random(0.0, 165.0);
     world.add(std::make_shared<Translated>(
         make_shared<RotatedY>(
-            std::make_shared<BvhNode>(boxes2, TimeInterval{}), 15.0),
+            std::make_shared<ParticleCloud>(centers, 10.0, white), 15.0),
             vec3{-100.0, 270.0, 395.0}));
 
     return world;
 }
 
+// small lights of random colors on a 32 by 32 grid around three spheres;
+// the 45 cells under the spheres stay empty, which leaves 979 lights
+HittableList many_lights() {
+    HittableList world;
+
+    world.add(std::make_shared<Quad>(point3{-50.0, 0.0, -50.0}, vec3{0.0, 0.0, 100.0}, vec3{100.0, 0.0, 0.0},
+                                     std::make_shared<lambertian>(color{0.5, 0.5, 0.5})));
+    world.add(std::make_shared<Sphere>(point3{0.0, 1.0, 0.0}, 1.0, std::make_shared<lambertian>(color{0.4, 0.2, 0.1})));
+    world.add(std::make_shared<Sphere>(point3{-3.0, 1.0, 1.0}, 1.0, std::make_shared<metal>(color{0.7, 0.6, 0.5}, 0.2)));
+    world.add(std::make_shared<Sphere>(point3{3.0, 1.0, -1.0}, 1.0, std::make_shared<lambertian>(color{0.8, 0.8, 0.8})));
+
+    for (int a = -16; a < 16; ++a)
+        for (int b = -16; b < 16; ++b) {
+            point3 const center{a + 0.5 + 0.4 * random_double(), 0.1, b + 0.5 + 0.4 * random_double()};
+            if (std::abs(center.x) < 4.5 && std::abs(center.z) < 2.5)
+                continue;
+            auto const light = std::make_shared<DiffuseLight>(20.0 * color::random(0.1, 1.0));
+            world.add(std::make_shared<Sphere>(center, 0.1, light));
+        }
+
+    return world;
+}
+
 Scene create_scene(SceneID const id, AspectRatio const aspect_ratio)
 {
     vec3 const vertical_up{0.0, 1.0, 0.0};
@@ -284,11 +375,15 @@ Scene create_scene(SceneID const id, AspectRatio const aspect_ratio)
     auto vertical_fov_degree = FieldOfView{20.0};
     Aperture aperture{0.0};
     HittableList world;
+    std::shared_ptr<EnvironmentMap const> environment;
 
     switch (id) {
     case SceneID::random_spheres:
         aperture = Aperture{0.1};
         world = random_scene();
+        // written by data/make_sky.py
+        environment = std::make_shared<EnvironmentMap const>(EnvironmentMap::load(DATA_PATH "/sky.hdr"));
+        background_color = [environment](Ray const & ray) { return environment->radiance(ray.d); };
         break;
     case SceneID::two_spheres:
         world = two_spheres();
@@ -324,6 +419,13 @@ Scene create_scene(SceneID const id, AspectRatio const aspect_ratio)
         lookat = point3{278.0, 278.0, 0.0};
         background_color = black_background;
         break;
+    case SceneID::cornell_cloud:
+        world = cornell_cloud();
+        vertical_fov_degree = FieldOfView{40.0};
+        lookfrom = point3{278.0, 278.0, -800};
+        lookat = point3{278.0, 278.0, 0.0};
+        background_color = black_background;
+        break;
     case SceneID::final_scene:
         world = final_scene();
         vertical_fov_degree = FieldOfView{40.0};
@@ -331,6 +433,13 @@ Scene create_scene(SceneID const id, AspectRatio const aspect_ratio)
         lookat = point3{278.0, 278.0, 0.0};
         background_color = black_background;
         break;
+    case SceneID::many_lights:
+        world = many_lights();
+        vertical_fov_degree = FieldOfView{40.0};
+        lookfrom = point3{0.0, 6.0, 12.0};
+        lookat = point3{0.0, 0.5, 0.0};
+        background_color = black_background;
+        break;
     }
 
     return {world,
@@ -343,5 +452,8 @@ Scene create_scene(SceneID const id, AspectRatio const aspect_ratio)
                    aperture,
                    focus_distance,
                    time0,
-                   time1}};
-}
\ No newline at end of file
+                   time1},
+            collect_lights(world),
+            collect_media(world),
+            environment};
+}
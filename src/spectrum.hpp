@@ -0,0 +1,210 @@
+#pragma once
+
+#include <color.hpp>
+#include <common.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+
+namespace ns_spectrum {
+    // wavelengths per path, processed element-wise in loops the compiler
+    // vectorizes
+    inline constexpr std::size_t number_of_samples{4};
+
+    // visible range in nm
+    inline constexpr double min_wavelength{380.0};
+    inline constexpr double max_wavelength{720.0};
+}
+
+// Values of a spectrum at the wavelengths of a path.
+class SampledSpectrum {
+public:
+    SampledSpectrum() = default;
+    explicit SampledSpectrum(double const value) { values_.fill(value); }
+
+    double operator[](std::size_t const ii) const { return values_[ii]; }
+    double & operator[](std::size_t const ii) { return values_[ii]; }
+
+    SampledSpectrum & operator+=(SampledSpectrum const & other) {
+        for (std::size_t ii = 0; ii < ns_spectrum::number_of_samples; ++ii)
+            values_[ii] += other.values_[ii];
+        return *this;
+    }
+
+    SampledSpectrum & operator*=(SampledSpectrum const & other) {
+        for (std::size_t ii = 0; ii < ns_spectrum::number_of_samples; ++ii)
+            values_[ii] *= other.values_[ii];
+        return *this;
+    }
+
+    SampledSpectrum & operator*=(double const factor) {
+        for (auto & value : values_)
+            value *= factor;
+        return *this;
+    }
+
+    double max_component() const { return *std::max_element(std::begin(values_), std::end(values_)); }
+
+    bool is_black() const {
+        return std::all_of(std::begin(values_), std::end(values_), [](double const value) { return value == 0.0; });
+    }
+
+private:
+    std::array<double, ns_spectrum::number_of_samples> values_{};
+};
+
+inline SampledSpectrum operator+(SampledSpectrum lhs, SampledSpectrum const & rhs) { return lhs += rhs; }
+inline SampledSpectrum operator*(SampledSpectrum lhs, SampledSpectrum const & rhs) { return lhs *= rhs; }
+inline SampledSpectrum operator*(SampledSpectrum lhs, double const factor) { return lhs *= factor; }
+inline SampledSpectrum operator*(double const factor, SampledSpectrum rhs) { return rhs *= factor; }
+
+namespace ns_spectrum {
+    // Basis spectra of Smits ("An RGB-to-Spectrum Conversion for
+    // Reflectances"), piecewise constant on 10 bins over the visible range.
+    inline constexpr std::size_t number_of_bins{10};
+    using BasisSpectrum = std::array<double, number_of_bins>;
+    inline constexpr BasisSpectrum white{1.0000, 1.0000, 0.9999, 0.9993, 0.9992, 0.9998, 1.0000, 1.0000, 1.0000, 1.0000};
+    inline constexpr BasisSpectrum cyan{0.9710, 0.9426, 1.0007, 1.0007, 1.0007, 1.0007, 0.1564, 0.0000, 0.0000, 0.0000};
+    inline constexpr BasisSpectrum magenta{1.0000, 1.0000, 0.9685, 0.2229, 0.0000, 0.0458, 0.8369, 1.0000, 1.0000, 0.9959};
+    inline constexpr BasisSpectrum yellow{0.0001, 0.0000, 0.1088, 0.6651, 1.0000, 1.0000, 0.9996, 0.9586, 0.9685, 0.9840};
+    inline constexpr BasisSpectrum red{0.1012, 0.0515, 0.0000, 0.0000, 0.0000, 0.0000, 0.8325, 1.0149, 1.0149, 1.0149};
+    inline constexpr BasisSpectrum green{0.0000, 0.0000, 0.0273, 0.7937, 1.0000, 0.9418, 0.1719, 0.0000, 0.0000, 0.0025};
+    inline constexpr BasisSpectrum blue{1.0000, 1.0000, 0.8916, 0.3323, 0.0000, 0.0000, 0.0003, 0.0369, 0.0483, 0.0496};
+
+    inline std::size_t bin(double const wavelength) {
+        auto const x = (wavelength - min_wavelength) / (max_wavelength - min_wavelength) * number_of_bins;
+        return static_cast<std::size_t>(std::clamp(x, 0.0, number_of_bins - 1.0));
+    }
+
+    // piecewise Gaussian of the fit of the CIE 1931 matching functions
+    inline double lobe(double const wavelength, double const mean, double const sigma_below, double const sigma_above) {
+        auto const t = (wavelength - mean) / (wavelength < mean ? sigma_below : sigma_above);
+        return std::exp(-0.5 * t * t);
+    }
+
+    // CIE 1931 color matching functions, in the multi-lobe fit of Wyman et
+    // al. ("Simple Analytic Approximations to the CIE XYZ Color Matching
+    // Functions")
+    inline vec3 xyz_matching(double const wavelength) {
+        return vec3{1.056 * lobe(wavelength, 599.8, 37.9, 31.0) + 0.362 * lobe(wavelength, 442.0, 16.0, 26.7)
+                        - 0.065 * lobe(wavelength, 501.1, 20.4, 26.2),
+                    0.821 * lobe(wavelength, 568.8, 46.9, 40.5) + 0.286 * lobe(wavelength, 530.9, 16.3, 31.1),
+                    1.217 * lobe(wavelength, 437.0, 11.8, 36.0) + 0.681 * lobe(wavelength, 459.0, 26.0, 13.8)};
+    }
+
+    inline color xyz_to_linear_srgb(vec3 const & xyz) {
+        return color{ 3.2404542 * xyz.x - 1.5371385 * xyz.y - 0.4985314 * xyz.z,
+                     -0.9692660 * xyz.x + 1.8760108 * xyz.y + 0.0415560 * xyz.z,
+                      0.0556434 * xyz.x - 0.2040259 * xyz.y + 1.0572252 * xyz.z};
+    }
+
+    // linear sRGB of the spectrum 1 over the visible range, which is mapped
+    // to white
+    inline color const & white_balance() {
+        static color const result = [] {
+            constexpr int steps = 3400;
+            vec3 xyz{0.0, 0.0, 0.0};
+            auto const step = (max_wavelength - min_wavelength) / steps;
+            for (int ii = 0; ii < steps; ++ii)
+                xyz += step * xyz_matching(min_wavelength + (ii + 0.5) * step);
+            return xyz_to_linear_srgb(xyz);
+        }();
+        return result;
+    }
+}
+
+// Hero wavelength sampling (Wilkie et al., "Hero Wavelength Spectral
+// Sampling"): the hero wavelength is uniform over the visible range, the
+// others are spaced evenly after it, wrapping around. A dispersive event
+// terminates all but the hero, whose estimate then stands for all of them.
+class SampledWavelengths {
+public:
+    static SampledWavelengths sample(double const u) {
+        using namespace ns_spectrum;
+        SampledWavelengths result;
+        auto const range = max_wavelength - min_wavelength;
+        for (std::size_t ii = 0; ii < number_of_samples; ++ii) {
+            auto wavelength = min_wavelength + range * u + ii * range / number_of_samples;
+            if (wavelength >= max_wavelength)
+                wavelength -= range;
+            result.wavelengths_[ii] = wavelength;
+            result.bins_[ii] = bin(wavelength);
+        }
+        return result;
+    }
+
+    double operator[](std::size_t const ii) const { return wavelengths_[ii]; }
+    double hero() const { return wavelengths_[0]; }
+
+    bool secondary_terminated() const { return secondary_terminated_; }
+
+    // keeps the hero wavelength only, reweighting `throughput` accordingly
+    void terminate_secondary(SampledSpectrum & throughput) {
+        if (secondary_terminated_)
+            return;
+        secondary_terminated_ = true;
+        throughput[0] *= ns_spectrum::number_of_samples;
+        for (std::size_t ii = 1; ii < ns_spectrum::number_of_samples; ++ii)
+            throughput[ii] = 0.0;
+    }
+
+    // Smits' reflectance spectrum of `rgb`, also used for emission, which it
+    // scales linearly
+    SampledSpectrum upsample(color const & rgb) const {
+        using namespace ns_spectrum;
+        auto const r = rgb.x, g = rgb.y, b = rgb.z;
+        // white for the smallest component, then the secondary and the
+        // primary color of the remaining two
+        double white_weight, secondary_weight, primary_weight;
+        BasisSpectrum const * secondary;
+        BasisSpectrum const * primary;
+        if (r <= g && r <= b) {
+            white_weight = r;
+            secondary = &cyan;
+            secondary_weight = std::min(g, b) - r;
+            primary = g <= b ? &blue : &green;
+            primary_weight = std::abs(b - g);
+        } else if (g <= r && g <= b) {
+            white_weight = g;
+            secondary = &magenta;
+            secondary_weight = std::min(r, b) - g;
+            primary = r <= b ? &blue : &red;
+            primary_weight = std::abs(b - r);
+        } else {
+            white_weight = b;
+            secondary = &yellow;
+            secondary_weight = std::min(r, g) - b;
+            primary = r <= g ? &green : &red;
+            primary_weight = std::abs(g - r);
+        }
+
+        SampledSpectrum result;
+        for (std::size_t ii = 0; ii < number_of_samples; ++ii) {
+            auto const k = bins_[ii];
+            result[ii] = white_weight * white[k] + secondary_weight * (*secondary)[k] + primary_weight * (*primary)[k];
+        }
+        return result;
+    }
+
+    // linear sRGB estimate of a spectrum from its values at the wavelengths,
+    // white balanced so that upsampled white stays white
+    color to_rgb(SampledSpectrum const & spectrum) const {
+        using namespace ns_spectrum;
+        vec3 xyz{0.0, 0.0, 0.0};
+        for (std::size_t ii = 0; ii < number_of_samples; ++ii)
+            if (spectrum[ii] != 0.0)
+                xyz += spectrum[ii] * xyz_matching(wavelengths_[ii]);
+        // over the uniform density of the wavelengths and their number
+        xyz = (max_wavelength - min_wavelength) / number_of_samples * xyz;
+        auto const rgb = xyz_to_linear_srgb(xyz);
+        auto const & white = white_balance();
+        return color{rgb.x / white.x, rgb.y / white.y, rgb.z / white.z};
+    }
+
+private:
+    std::array<double, ns_spectrum::number_of_samples> wavelengths_{};
+    std::array<std::size_t, ns_spectrum::number_of_samples> bins_{};
+    bool secondary_terminated_{false};
+};
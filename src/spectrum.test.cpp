@@ -0,0 +1,94 @@
+#include <spectrum.hpp>
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <cmath>
+
+
+using testing::DoubleNear;
+using testing::Eq;
+using testing::Ge;
+using testing::Lt;
+
+
+// mean of `to_rgb(upsample(rgb))` over evenly spread hero wavelengths
+color round_trip(color const & rgb) {
+    int const n = 1000;
+    color mean{0.0};
+    for (int ii = 0; ii < n; ++ii) {
+        auto const wavelengths = SampledWavelengths::sample((ii + 0.5) / n);
+        mean += wavelengths.to_rgb(wavelengths.upsample(rgb)) / n;
+    }
+    return mean;
+}
+
+TEST(SampledWavelengths, spaces_the_wavelengths_evenly_from_the_hero) {
+    auto const wavelengths = SampledWavelengths::sample(0.5);
+    EXPECT_THAT(wavelengths.hero(), DoubleNear(550.0, 1e-9));
+    EXPECT_THAT(wavelengths[1], DoubleNear(635.0, 1e-9));
+    EXPECT_THAT(wavelengths[2], DoubleNear(380.0, 1e-9));
+    EXPECT_THAT(wavelengths[3], DoubleNear(465.0, 1e-9));
+}
+
+TEST(SampledWavelengths, stay_in_the_visible_range) {
+    for (double u = 0.0; u < 1.0; u += 0.01) {
+        auto const wavelengths = SampledWavelengths::sample(u);
+        for (std::size_t ii = 0; ii < ns_spectrum::number_of_samples; ++ii) {
+            EXPECT_THAT(wavelengths[ii], Ge(ns_spectrum::min_wavelength));
+            EXPECT_THAT(wavelengths[ii], Lt(ns_spectrum::max_wavelength));
+        }
+    }
+}
+
+TEST(SampledWavelengths, keep_the_hero_only_after_termination) {
+    auto wavelengths = SampledWavelengths::sample(0.3);
+    SampledSpectrum throughput{0.5};
+    wavelengths.terminate_secondary(throughput);
+    wavelengths.terminate_secondary(throughput);
+    EXPECT_TRUE(wavelengths.secondary_terminated());
+    EXPECT_THAT(throughput[0], Eq(2.0));
+    for (std::size_t ii = 1; ii < ns_spectrum::number_of_samples; ++ii)
+        EXPECT_THAT(throughput[ii], Eq(0.0));
+}
+
+TEST(SampledWavelengths, upsample_white_to_a_flat_spectrum) {
+    auto const wavelengths = SampledWavelengths::sample(0.2);
+    auto const spectrum = wavelengths.upsample(color{0.7});
+    for (std::size_t ii = 0; ii < ns_spectrum::number_of_samples; ++ii)
+        EXPECT_THAT(spectrum[ii], DoubleNear(0.7, 1e-3));
+}
+
+TEST(SampledWavelengths, convert_white_back_to_white) {
+    auto const rgb = round_trip(color{1.0});
+    for (int c = 0; c < 3; ++c)
+        EXPECT_THAT(rgb[c], DoubleNear(1.0, 0.01));
+}
+
+TEST(SampledWavelengths, convert_colors_back_to_similar_colors) {
+    for (auto const & expected : {color{0.8, 0.3, 0.1}, color{0.1, 0.6, 0.2}, color{0.2, 0.3, 0.9}}) {
+        auto const rgb = round_trip(expected);
+        for (int c = 0; c < 3; ++c)
+            EXPECT_THAT(rgb[c], DoubleNear(expected[c], 0.1)) << expected;
+    }
+}
+
+TEST(SampledWavelengths, convert_the_hero_alone_to_the_same_color_on_average) {
+    color mean{0.0}, hero_only{0.0};
+    int const n = 1000;
+    for (int ii = 0; ii < n; ++ii) {
+        auto wavelengths = SampledWavelengths::sample((ii + 0.5) / n);
+        auto spectrum = wavelengths.upsample(color{0.8, 0.3, 0.1});
+        mean += wavelengths.to_rgb(spectrum) / n;
+        wavelengths.terminate_secondary(spectrum);
+        hero_only += wavelengths.to_rgb(spectrum) / n;
+    }
+    for (int c = 0; c < 3; ++c)
+        EXPECT_THAT(hero_only[c], DoubleNear(mean[c], 0.01));
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -6,6 +6,8 @@
 #include <texture.hpp>
 #include <vec3.hpp>
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <memory>
 
@@ -20,8 +22,14 @@ struct Sphere : HittableI {
     // HittableI
     HitRecord hit(Ray const & r, double t_min, double t_max) const override;
     Aabb bounding_box(TimeInterval times) const override;
+    std::optional<TimeInterval> intersect_interval(Ray const & r) const override;
+    SurfaceSample sample_surface() const override;
+    double surface_pdf(HitRecord const & rec) const override { return 1.0 / (4.0 * pi * r * r); }
+    // uniform in the solid angle of the visible cap
+    SurfaceSample sample_surface_from(point3 const & reference) const override;
+    double surface_pdf_from(point3 const & reference, HitRecord const & rec) const override;
 
-    TextureCoordinates2d get_uv(point3 const p) const;
+    static TextureCoordinates2d get_uv(point3 const p);
 };
 
 inline HitRecord Sphere::hit(Ray const & ray, double t_min, double t_max) const {
@@ -46,7 +54,7 @@ inline HitRecord Sphere::hit(Ray const & ray, double t_min, double t_max) const
     auto sqrtd = sqrt(discriminant);
     auto root = (-h - sqrtd) / a;
     if(root < t_min || t_max < root) {
-        root = -h + sqrtd / a;
+        root = (-h + sqrtd) / a;
         if(root < t_min || t_max < root)
             return HitRecord::miss();
     }
@@ -57,16 +65,96 @@ inline HitRecord Sphere::hit(Ray const & ray, double t_min, double t_max) const
     vec3 const outward_normal = (result.p - c) / r;
     result.set_face_normal(ray, outward_normal);
     result.uv = get_uv(outward_normal);
+    result.uv_scale = 1.0 / (pi * r);
     result.material_ptr = material_ptr;
+    result.object = this;
     return result;
 }
 
+inline std::optional<TimeInterval> Sphere::intersect_interval(Ray const & ray) const {
+    // both roots of the quadratic equation solved in `hit`
+    vec3 oc = ray.o - c;
+    auto a = ray.d.length_squared();
+    auto h = dot(oc, ray.d);
+    auto C = oc.length_squared() - r * r;
+
+    auto discriminant = h*h - a*C;
+    if (discriminant < 0)
+        return std::nullopt;
+
+    auto sqrtd = sqrt(discriminant);
+    return TimeInterval{(-h - sqrtd) / a, (-h + sqrtd) / a};
+}
+
+inline SurfaceSample Sphere::sample_surface() const {
+    vec3 const outward_normal = random_unit_vector();
+
+    HitRecord record;
+    record.p = c + r * outward_normal;
+    record.normal = outward_normal;
+    record.side = FaceSide::front;
+    record.uv = get_uv(outward_normal);
+    record.uv_scale = 1.0 / (pi * r);
+    record.material_ptr = material_ptr;
+    record.object = this;
+    return {record, 1.0 / (4.0 * pi * r * r)};
+}
+
+inline SurfaceSample Sphere::sample_surface_from(point3 const & reference) const {
+    vec3 const to_center = c - reference;
+    auto const distance_squared = to_center.length_squared();
+    if (distance_squared <= r * r)
+        return sample_surface();
+
+    // cone of directions from `reference` towards the sphere
+    auto const distance = std::sqrt(distance_squared);
+    auto const sin_theta_max_squared = r * r / distance_squared;
+    auto const cos_theta_max = std::sqrt(std::max(0.0, 1.0 - sin_theta_max_squared));
+    auto const one_minus_cos_theta_max = sin_theta_max_squared / (1.0 + cos_theta_max);  // avoids cancellation
+
+    auto const [u1, u2] = random_2d();
+    auto const cos_theta = 1.0 - u1 * one_minus_cos_theta_max;
+    auto const sin_theta = std::sqrt(std::max(0.0, 1.0 - cos_theta * cos_theta));
+    auto const phi = 2.0 * pi * u2;
+    vec3 const w = to_center / distance;
+    auto const [e1, e2] = orthonormal_basis(w);
+    vec3 const direction = sin_theta * std::cos(phi) * e1 + sin_theta * std::sin(phi) * e2 + cos_theta * w;
+
+    // closer intersection of the direction with the sphere
+    auto const s = distance * cos_theta - std::sqrt(std::max(0.0, r * r - distance_squared * sin_theta * sin_theta));
+    vec3 const outward_normal = unit_vector(reference + s * direction - c);
+
+    HitRecord record;
+    record.p = c + r * outward_normal;
+    record.normal = outward_normal;
+    record.side = FaceSide::front;
+    record.uv = get_uv(outward_normal);
+    record.uv_scale = 1.0 / (pi * r);
+    record.material_ptr = material_ptr;
+    record.object = this;
+
+    return {record, surface_pdf_from(reference, record)};
+}
+
+inline double Sphere::surface_pdf_from(point3 const & reference, HitRecord const & rec) const {
+    auto const distance_squared = (c - reference).length_squared();
+    if (distance_squared <= r * r)
+        return 1.0 / (4.0 * pi * r * r);
+
+    // uniform solid angle density of the visible cap, converted to area
+    auto const sin_theta_max_squared = r * r / distance_squared;
+    auto const one_minus_cos_theta_max = sin_theta_max_squared / (1.0 + std::sqrt(std::max(0.0, 1.0 - sin_theta_max_squared)));
+    vec3 const to_reference = reference - rec.p;
+    auto const cos_light = std::abs(dot((rec.p - c) / r, to_reference)) / to_reference.length();
+    return cos_light / (2.0 * pi * one_minus_cos_theta_max * to_reference.length_squared());
+}
+
 inline Aabb Sphere::bounding_box(TimeInterval times) const {
     return Aabb{AabbBounds{c - vec3{r}, c + vec3{r}}};
 }
 
 // p is a point on the sphere of ratius 1 centered at the origin.
-inline TextureCoordinates2d Sphere::get_uv(point3 const p) const {
+inline TextureCoordinates2d Sphere::get_uv(point3 const p) {
     auto const theta = std::acos(-p.y);
     auto const phi = std::atan2(-p.z, p.x) + pi;
     return {phi / (2.0 * pi), theta / pi};
@@ -7,8 +7,13 @@
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
 
+#include <cmath>
 
+
+using testing::DoubleEq;
+using testing::DoubleNear;
 using testing::Eq;
+using testing::Ge;
 
 
 TEST(sphere, has_center) { Sphere{vec3{}, 0.0}.c; }
@@ -81,6 +86,59 @@ TEST_F(a_sphere_and_unnormalized_ray, hit_time_is_correct_for_unnormalized_ray)
     EXPECT_THAT(s.hit(r, 0.0, 10.0).t, Eq(2.0));
 }
 
+TEST_F(a_sphere_and_unnormalized_ray, hit_from_inside_finds_the_far_side) {
+    EXPECT_THAT(s.hit(r, 2.5, 10.0).t, Eq(3.0));
+}
+
+TEST_F(a_sphere_and_unnormalized_ray, intersect_interval_returns_entry_and_exit) {
+    auto const interval = s.intersect_interval(r);
+    ASSERT_TRUE(interval);
+    EXPECT_THAT(interval->min, Eq(2.0));
+    EXPECT_THAT(interval->max, Eq(3.0));
+}
+
+TEST_F(a_sphere_and_missing_ray, intersect_interval_is_empty) {
+    EXPECT_FALSE(s.intersect_interval(r));
+}
+
+TEST_F(a_sphere, samples_points_on_its_surface) {
+    for (int ii = 0; ii < 100; ++ii) {
+        auto const sample = s.sample_surface();
+        EXPECT_THAT(sample.record.p.length(), DoubleNear(1.0, 1e-12));
+        EXPECT_THAT(sample.record.normal, Eq(sample.record.p));
+        EXPECT_THAT(sample.record.object, Eq(&s));
+    }
+}
+
+TEST_F(a_sphere, has_uniform_area_pdf) {
+    EXPECT_THAT(s.sample_surface().pdf, DoubleEq(1.0 / (4.0 * pi)));
+}
+
+TEST_F(a_sphere, samples_the_cap_visible_from_outside) {
+    point3 const reference{0.0, 0.0, 3.0};
+    for (int ii = 0; ii < 100; ++ii) {
+        auto const sample = s.sample_surface_from(reference);
+        EXPECT_THAT(sample.record.p.length(), DoubleNear(1.0, 1e-12));
+        EXPECT_THAT(dot(sample.record.normal, reference - sample.record.p), Ge(0.0));
+    }
+}
+
+TEST_F(a_sphere, samples_uniformly_in_solid_angle_from_outside) {
+    // cos / (distance^2 pdf) is the inverse solid angle pdf of the cap
+    point3 const reference{0.0, 0.0, 3.0};
+    auto const solid_angle = 2.0 * pi * (1.0 - std::sqrt(8.0) / 3.0);
+    for (int ii = 0; ii < 100; ++ii) {
+        auto const sample = s.sample_surface_from(reference);
+        vec3 const to_reference = reference - sample.record.p;
+        auto const cos_light = dot(sample.record.normal, unit_vector(to_reference));
+        EXPECT_THAT(cos_light / (to_reference.length_squared() * sample.pdf), DoubleNear(solid_angle, 1e-9));
+    }
+}
+
+TEST_F(a_sphere, samples_uniformly_from_inside) {
+    EXPECT_THAT(s.sample_surface_from(point3{0.5, 0.0, 0.0}).pdf, DoubleEq(1.0 / (4.0 * pi)));
+}
+
 
 int main(int argc, char **argv)
 {
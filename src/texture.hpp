@@ -9,7 +9,9 @@
 #include <stb_image.h>
 
 #include <algorithm>
+#include <cmath>
 #include <memory>
+#include <vector>
 
 struct TextureCoordinates2d : inject_pointer_as_iterator<double>
                             , inject_trivial_begin_end<TextureCoordinates2d>
@@ -20,8 +22,22 @@ struct TextureCoordinates2d : inject_pointer_as_iterator<double>
     TextureCoordinates2d(double const u, double const v) : u{u}, v{v} {}
 };
 
+// Width of the surface area that a texture lookup stands for, e.g. the
+// pixel of a camera ray, in world units and in texture coordinates. Zero for
+// point sampling.
+struct Footprint {
+    double width{0.0};
+    double uv_width{0.0};
+};
+
 struct TextureI {
     virtual color value(TextureCoordinates2d const uv, point3 const & p) const = 0;
+
+    // average over `footprint` around the lookup, as far as the texture can
+    // prefilter itself, otherwise the point sample
+    virtual color filtered_value(TextureCoordinates2d const uv, point3 const & p, Footprint const & footprint) const {
+        return value(uv, p);
+    }
 };
 
 
@@ -53,6 +69,13 @@ struct CheckerTexture : TextureI {
         return even->value(uv, p);
     }
 
+    color filtered_value(TextureCoordinates2d const uv, point3 const & p, Footprint const & footprint) const override {
+        auto sines = std::sin(10.0 * p.x) * std::sin(10.0 * p.y) * std::sin(10.0 * p.z);
+        if (sines < 0)
+            return odd->filtered_value(uv, p, footprint);
+        return even->filtered_value(uv, p, footprint);
+    }
+
     std::shared_ptr<TextureI> even;
     std::shared_ptr<TextureI> odd;
 };
@@ -71,6 +94,16 @@ struct NoiseTexture : TextureI {
         return color(1.0, 1.0, 1.0) * 0.5 * (1.0 + std::sin(scale * p.z + 10.0 * noise.turbulence(p)));
     }
 
+    // Octave k of the turbulence has features of size 2^-k, which average
+    // out once they are smaller than the footprint. Skipping them also saves
+    // most of the cost on wide footprints, e.g. after diffuse bounces.
+    color filtered_value(TextureCoordinates2d const uv, point3 const & p, Footprint const & footprint) const override {
+        auto const octaves = std::clamp(std::floor(-std::log2(footprint.width)) + 1.0, 1.0, max_octaves);
+        return color(1.0, 1.0, 1.0) * 0.5 * (1.0 + std::sin(scale * p.z + 10.0 * noise.turbulence(p, octaves)));
+    }
+
+    inline static constexpr double max_octaves{7.0};
+
     Perlin noise;
     double const scale;
 };
@@ -86,6 +119,7 @@ public:
             throw std::runtime_error("Could not load texture image: " + file_name + "\n");
 
         bytes_per_scanline_ = bytes_per_pixel_ * width_;
+        build_mip_levels();
     }
 
     ~ImageTexture() {
@@ -96,12 +130,80 @@ public:
     color value(TextureCoordinates2d const uv, point3 const & p) const override {
         int const i = std::clamp(uv.u, 0.0, 1.0) * (width_ - 1);
         int const j = flip(std::clamp(uv.v, 0.0, 1.0)) * (height_ - 1);
+        return texel(i, j);
+    }
 
+    // Trilinear between the two mip levels whose texels are closest to the
+    // footprint in size, bilinear within each level.
+    color filtered_value(TextureCoordinates2d const uv, point3 const & p, Footprint const & footprint) const override {
+        auto const texels = footprint.uv_width * std::max(width_, height_);
+        if (!(texels > 1.0))
+            return value(uv, p);
+        auto const level = std::min(std::log2(texels), static_cast<double>(mip_levels_.size()));
+        auto const lower = static_cast<std::size_t>(level);
+        auto const fraction = level - lower;
+        auto const lower_value = lower == 0 ? bilinear(width_, height_, uv, [this](int const i, int const j) { return texel(i, j); })
+                                            : mip_value(mip_levels_[lower - 1], uv);
+        if (fraction == 0.0)
+            return lower_value;
+        return (1.0 - fraction) * lower_value + fraction * mip_value(mip_levels_[lower], uv);
+    }
+
+    std::size_t number_of_mip_levels() const { return mip_levels_.size(); }
+
+private:
+    // the image halved in size once or more, by averaging
+    struct MipLevel {
+        int width, height;
+        std::vector<color> texels;
+    };
+
+    void build_mip_levels() {
+        auto previous_width = width_, previous_height = height_;
+        auto const previous_texel = [&](int const i, int const j) {
+            auto const ii = std::min(i, previous_width - 1), jj = std::min(j, previous_height - 1);
+            if (mip_levels_.empty())
+                return texel(ii, jj);
+            return mip_levels_.back().texels[jj * previous_width + ii];
+        };
+        while (previous_width > 1 || previous_height > 1) {
+            MipLevel level{std::max(1, previous_width / 2), std::max(1, previous_height / 2), {}};
+            level.texels.reserve(level.width * level.height);
+            for (int j = 0; j < level.height; ++j)
+                for (int i = 0; i < level.width; ++i)
+                    level.texels.push_back(0.25 * (previous_texel(2 * i, 2 * j) + previous_texel(2 * i + 1, 2 * j)
+                                                   + previous_texel(2 * i, 2 * j + 1) + previous_texel(2 * i + 1, 2 * j + 1)));
+            previous_width = level.width;
+            previous_height = level.height;
+            mip_levels_.push_back(std::move(level));
+        }
+    }
+
+    color mip_value(MipLevel const & level, TextureCoordinates2d const uv) const {
+        return bilinear(level.width, level.height, uv, [&level](int const i, int const j) {
+            return level.texels[j * level.width + i];
+        });
+    }
+
+    // between the four texels of an image of `width` x `height` around `uv`,
+    // which `value` would round down to the first of them
+    template <class Texel>
+    color bilinear(int const width, int const height, TextureCoordinates2d const uv, Texel const & texel) const {
+        auto const x = std::clamp(uv.u, 0.0, 1.0) * (width - 1);
+        auto const y = flip(std::clamp(uv.v, 0.0, 1.0)) * (height - 1);
+        int const i = static_cast<int>(x), j = static_cast<int>(y);
+        int const i1 = std::min(i + 1, width - 1), j1 = std::min(j + 1, height - 1);
+        auto const fx = x - i, fy = y - j;
+        return (1.0 - fy) * ((1.0 - fx) * texel(i, j) + fx * texel(i1, j))
+             + fy * ((1.0 - fx) * texel(i, j1) + fx * texel(i1, j1));
+    }
+
+    // of the full resolution image
+    color texel(int const i, int const j) const {
         auto pixel_it = data_ + j * bytes_per_scanline_ + i * bytes_per_pixel_;
         return color_scale * color(pixel_it[0], pixel_it[1], pixel_it[2]);
     }
 
-private:
     double flip(double const d) const { return 1.0 - d; }
 
     inline static constexpr int bytes_per_pixel_{3};
@@ -110,4 +212,5 @@ private:
     unsigned char * data_{nullptr};
     int width_, height_;
     int bytes_per_scanline_;
+    std::vector<MipLevel> mip_levels_;
 };
\ No newline at end of file
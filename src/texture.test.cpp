@@ -7,6 +7,7 @@
 #include <string>
 
 using testing::DoubleEq;
+using testing::DoubleNear;
 using testing::Eq;
 using testing::Ne;
 using testing::Test;
@@ -52,6 +53,30 @@ TEST_F(AnImageTexture, retrieves_the_correct_color) {
                         expected_color);
 }
 
+TEST_F(AnImageTexture, keeps_its_color_in_all_mip_levels) {
+    EXPECT_THAT(texture.number_of_mip_levels(), Eq(3u));
+    color const expected_color{33.0 / 255.0, 64.0 / 255.0, 128.0 / 255.0};
+    for (double const uv_width : {0.0, 0.15, 0.4, 10.0})
+        expect_double_equal(texture.filtered_value(TextureCoordinates2d{0.5, 0.5}, point3{}, Footprint{1.0, uv_width}),
+                            expected_color);
+}
+
+struct ANoiseTexture : Test {
+    NoiseTexture const texture{4.0};
+    point3 const p{0.3, 1.7, -2.2};
+};
+
+TEST_F(ANoiseTexture, uses_all_octaves_for_point_samples) {
+    EXPECT_THAT(texture.filtered_value({}, p, Footprint{}), Eq(texture.value({}, p)));
+}
+
+TEST_F(ANoiseTexture, drops_the_octaves_smaller_than_the_footprint) {
+    auto const one_octave = 0.5 * (1.0 + std::sin(4.0 * p.z + 10.0 * texture.noise.turbulence(p, 1.0)));
+    EXPECT_THAT(texture.filtered_value({}, p, Footprint{2.0, 0.0}).x, DoubleNear(one_octave, 1e-12));
+    auto const three_octaves = 0.5 * (1.0 + std::sin(4.0 * p.z + 10.0 * texture.noise.turbulence(p, 3.0)));
+    EXPECT_THAT(texture.filtered_value({}, p, Footprint{0.2, 0.0}).x, DoubleNear(three_octaves, 1e-12));
+}
+
 int main(int argc, char **argv)
 {
  ::testing::InitGoogleTest(&argc, argv);
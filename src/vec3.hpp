@@ -3,11 +3,13 @@
 #include <common.hpp>
 #include <crtp_functionality.hpp>
 
+#include <algorithm>
 #include <array>
 #include <cmath>
 #include <iostream>
 #include <string>
 #include <sstream>
+#include <utility>
 
 
 struct vec3 : inject_trivial_begin_end<vec3>
@@ -82,23 +84,44 @@ inline double dot(vec3 const & u, vec3 const & v) {
          + u.z * v.z;
 }
 
+// two unit vectors completing the unit vector `n` to a right-handed orthonormal
+// basis (Duff et al., "Building an Orthonormal Basis, Revisited")
+inline std::array<vec3, 2> orthonormal_basis(vec3 const & n) {
+    double const sign = std::copysign(1.0, n.z);
+    double const a = -1.0 / (sign + n.z);
+    double const b = n.x * n.y * a;
+    return {vec3{1.0 + sign * n.x * n.x * a, sign * b, -sign * n.x},
+            vec3{b, sign + n.y * n.y * a, -n.y}};
+}
+
 // TODO: how to make this a static member while still using the dot function?
+// Shirley's concentric mapping of a square to the disk, which keeps the
+// stratification of random_2d()
 inline vec3 random_in_unit_disk() {
-    while (true)
-        if (vec3 const v{random_double(-1.0, 1.0), random_double(-1.0, 1.0), 0.0};
-            v.length_squared() < 1.0)
-            return v;
+    auto const [u1, u2] = random_2d();
+    auto const a = 2.0 * u1 - 1.0;
+    auto const b = 2.0 * u2 - 1.0;
+    if (a == 0.0 && b == 0.0)
+        return vec3{0.0, 0.0, 0.0};
+    auto const [r, theta] = std::abs(a) > std::abs(b) ? std::pair{a, pi / 4.0 * (b / a)}
+                                                      : std::pair{b, pi / 2.0 - pi / 4.0 * (a / b)};
+    return vec3{r * std::cos(theta), r * std::sin(theta), 0.0};
 }
 
-inline vec3 random_in_unit_sphere() {
-    auto result = vec3::random(-1.0, 1.0);
-    while (dot(result, result) > 1.0)
-        result = vec3::random(-1.0, 1.0);
-    return result;
+// uniform on the sphere, from exactly two numbers of random_2d()
+inline vec3 random_unit_vector() {
+    auto const [u1, u2] = random_2d();
+    auto const z = 1.0 - 2.0 * u1;
+    auto const r = std::sqrt(std::max(0.0, 1.0 - z * z));
+    auto const phi = 2.0 * pi * u2;
+    return vec3{r * std::cos(phi), r * std::sin(phi), z};
 }
 
-inline vec3 random_unit_vector() {
-    return unit_vector(random_in_unit_sphere());
+// uniform in the ball, from exactly one random_double() for the radius and
+// the two numbers of random_unit_vector()
+inline vec3 random_in_unit_sphere() {
+    auto const r = std::cbrt(random_double());
+    return r * random_unit_vector();
 }
 
 inline vec3 random_in_hemisphere(vec3 const & normal) {
@@ -10,6 +10,7 @@
 
 using testing::AllOf;
 using testing::DoubleEq;
+using testing::DoubleNear;
 using testing::Eq;
 using testing::Ge;
 using testing::Le;
@@ -217,6 +218,15 @@ TEST(vec3, can_generate_random_vec3_in_unit_sphere) {
     }
 }
 
+TEST(vec3, random_vec3_in_unit_sphere_is_uniform_in_the_ball) {
+    int const n = 100000;
+    int inner = 0;
+    for (int i = 0; i < n; ++i)
+        if (random_in_unit_sphere().length() < 0.5)
+            ++inner;
+    EXPECT_THAT(static_cast<double>(inner) / n, DoubleNear(0.125, 0.01));
+}
+
 TEST(vec3, can_generate_random_unit_vec3) {
     for (int i = 0; i < 100; ++i) {
         auto const rv = random_unit_vector();
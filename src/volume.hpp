@@ -0,0 +1,349 @@
+#pragma once
+
+#include <aabb.hpp>
+#include <color.hpp>
+#include <common.hpp>
+#include <hit.hpp>
+#include <material.hpp>
+#include <ray.hpp>
+#include <vec3.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+using GridResolution = std::array<int, 3>;
+
+// Scalar densities sampled at voxel centers.
+// Voxel (i, j, k) covers [i, i+1] x [j, j+1] x [k, k+1] in voxel units.
+struct VoxelGridI {
+    virtual GridResolution resolution() const = 0;
+    // zero for voxels outside of the grid
+    virtual double voxel(int i, int j, int k) const = 0;
+};
+
+// trilinear interpolation at `local`, with the grid spanning [0, 1]^3
+inline double trilinear(VoxelGridI const & grid, vec3 const & local) {
+    auto const res = grid.resolution();
+    double const x = local.x * res[0] - 0.5;
+    double const y = local.y * res[1] - 0.5;
+    double const z = local.z * res[2] - 0.5;
+    int const i = static_cast<int>(std::floor(x));
+    int const j = static_cast<int>(std::floor(y));
+    int const k = static_cast<int>(std::floor(z));
+    double const fx = x - i;
+    double const fy = y - j;
+    double const fz = z - k;
+
+    auto const lerp = [](double const a, double const b, double const t) { return a + t * (b - a); };
+    auto const plane = [&](int const kk) {
+        return lerp(lerp(grid.voxel(i, j,     kk), grid.voxel(i + 1, j,     kk), fx),
+                    lerp(grid.voxel(i, j + 1, kk), grid.voxel(i + 1, j + 1, kk), fx),
+                    fy);
+    };
+    return lerp(plane(k), plane(k + 1), fz);
+}
+
+//----------------------------------------------------------------------dense grid
+class DenseVoxelGrid : public VoxelGridI {
+public:
+    explicit DenseVoxelGrid(GridResolution const resolution)
+        : resolution_{resolution}
+        , data_(static_cast<std::size_t>(resolution[0]) * resolution[1] * resolution[2], 0.0f) {}
+
+    void set(int const i, int const j, int const k, double const value) {
+        data_[index(i, j, k)] = static_cast<float>(value);
+    }
+
+    // VoxelGridI
+    GridResolution resolution() const override { return resolution_; }
+
+    double voxel(int const i, int const j, int const k) const override {
+        return contains(i, j, k) ? data_[index(i, j, k)] : 0.0;
+    }
+
+private:
+    bool contains(int const i, int const j, int const k) const {
+        return 0 <= i && i < resolution_[0] &&
+               0 <= j && j < resolution_[1] &&
+               0 <= k && k < resolution_[2];
+    }
+
+    std::size_t index(int const i, int const j, int const k) const {
+        return i + static_cast<std::size_t>(resolution_[0]) * (j + static_cast<std::size_t>(resolution_[1]) * k);
+    }
+
+    GridResolution resolution_;
+    std::vector<float> data_;
+};
+
+//---------------------------------------------------------------sparse brick grid
+// Voxels are grouped into bricks of 8^3. Only bricks containing a nonzero
+// density are allocated, which keeps mostly empty smoke and cloud grids small.
+class SparseVoxelGrid : public VoxelGridI {
+public:
+    inline static constexpr int brick_size{8};
+
+    explicit SparseVoxelGrid(GridResolution const resolution)
+        : resolution_{resolution}
+        , bricks_{(resolution[0] + brick_size - 1) / brick_size,
+                  (resolution[1] + brick_size - 1) / brick_size,
+                  (resolution[2] + brick_size - 1) / brick_size}
+        , brick_index_(static_cast<std::size_t>(bricks_[0]) * bricks_[1] * bricks_[2], empty_brick_) {}
+
+    explicit SparseVoxelGrid(VoxelGridI const & grid) : SparseVoxelGrid{grid.resolution()} {
+        for (int k = 0; k < resolution_[2]; ++k)
+            for (int j = 0; j < resolution_[1]; ++j)
+                for (int i = 0; i < resolution_[0]; ++i)
+                    if (auto const value = grid.voxel(i, j, k); value != 0.0)
+                        set(i, j, k, value);
+    }
+
+    void set(int const i, int const j, int const k, double const value) {
+        auto & brick = brick_index_[brick_of(i, j, k)];
+        if (brick == empty_brick_) {
+            if (value == 0.0)
+                return;
+            brick = static_cast<std::int32_t>(pool_.size() / voxels_per_brick_);
+            pool_.resize(pool_.size() + voxels_per_brick_, 0.0f);
+        }
+        pool_[brick * voxels_per_brick_ + in_brick(i, j, k)] = static_cast<float>(value);
+    }
+
+    std::size_t allocated_bricks() const { return pool_.size() / voxels_per_brick_; }
+
+    // VoxelGridI
+    GridResolution resolution() const override { return resolution_; }
+
+    double voxel(int const i, int const j, int const k) const override {
+        if (i < 0 || resolution_[0] <= i || j < 0 || resolution_[1] <= j || k < 0 || resolution_[2] <= k)
+            return 0.0;
+        auto const brick = brick_index_[brick_of(i, j, k)];
+        return brick == empty_brick_ ? 0.0 : pool_[brick * voxels_per_brick_ + in_brick(i, j, k)];
+    }
+
+private:
+    inline static constexpr std::int32_t empty_brick_{-1};
+    inline static constexpr std::size_t voxels_per_brick_{brick_size * brick_size * brick_size};
+
+    std::size_t brick_of(int const i, int const j, int const k) const {
+        return i / brick_size + static_cast<std::size_t>(bricks_[0]) * (j / brick_size + static_cast<std::size_t>(bricks_[1]) * (k / brick_size));
+    }
+
+    static std::size_t in_brick(int const i, int const j, int const k) {
+        return i % brick_size + brick_size * (j % brick_size + brick_size * (k % brick_size));
+    }
+
+    GridResolution resolution_;
+    GridResolution bricks_;
+    std::vector<std::int32_t> brick_index_;
+    std::vector<float> pool_;
+};
+
+//-----------------------------------------------------------------majorant grid
+// Coarse grid of density upper bounds. Each cell bounds every trilinear
+// lookup inside of it, i.e. it also covers the neighbouring voxel layer.
+class MajorantGrid {
+public:
+    MajorantGrid(VoxelGridI const & grid, int const cell_size = 8)
+        : cell_size_{cell_size}
+        , resolution_{(grid.resolution()[0] + cell_size - 1) / cell_size,
+                      (grid.resolution()[1] + cell_size - 1) / cell_size,
+                      (grid.resolution()[2] + cell_size - 1) / cell_size}
+        , majorants_(static_cast<std::size_t>(resolution_[0]) * resolution_[1] * resolution_[2], 0.0) {
+        auto const voxels = grid.resolution();
+        for (int k = 0; k < voxels[2]; ++k)
+            for (int j = 0; j < voxels[1]; ++j)
+                for (int i = 0; i < voxels[0]; ++i) {
+                    auto const value = grid.voxel(i, j, k);
+                    if (value <= 0.0)
+                        continue;
+                    // all cells whose lookups may interpolate this voxel
+                    for (int ck = cell_of(k - 1, 2); ck <= cell_of(k + 1, 2); ++ck)
+                        for (int cj = cell_of(j - 1, 1); cj <= cell_of(j + 1, 1); ++cj)
+                            for (int ci = cell_of(i - 1, 0); ci <= cell_of(i + 1, 0); ++ci) {
+                                auto & majorant = majorants_[index(ci, cj, ck)];
+                                majorant = std::max(majorant, value);
+                            }
+                }
+    }
+
+    GridResolution resolution() const { return resolution_; }
+    int cell_size() const { return cell_size_; }
+
+    double majorant(int const i, int const j, int const k) const { return majorants_[index(i, j, k)]; }
+
+private:
+    int cell_of(int const voxel, std::size_t const dim) const {
+        return std::clamp(voxel < 0 ? -1 : voxel / cell_size_, 0, resolution_[dim] - 1);
+    }
+
+    std::size_t index(int const i, int const j, int const k) const {
+        return i + static_cast<std::size_t>(resolution_[0]) * (j + static_cast<std::size_t>(resolution_[1]) * k);
+    }
+
+    int cell_size_;
+    GridResolution resolution_;
+    std::vector<double> majorants_;
+};
+
+//---------------------------------------------------------heterogeneous medium
+// A participating medium with densities from a voxel grid mapped onto `bounds`.
+//
+// Free-flight distances are sampled by delta tracking and transmittance is
+// estimated by ratio tracking. Both walk the majorant grid cell by cell, so
+// that empty cells are skipped and every tentative collision is drawn from a
+// tight local bound instead of the global maximum.
+class HeterogeneousMedium : public HittableI {
+public:
+    HeterogeneousMedium(std::shared_ptr<VoxelGridI> grid,
+                        Aabb const & bounds,
+                        double const density_scale,
+                        color const albedo,
+                        int const majorant_cell_size = 8)
+        : grid_{grid}
+        , majorants_{*grid, majorant_cell_size}
+        , bounds_{bounds}
+        , density_scale_{density_scale}
+        , phase_function_{std::make_shared<Isotropic>(albedo)} {}
+
+    // extinction coefficient at a world space point
+    double density(point3 const & p) const {
+        vec3 const local = (p - bounds_.min()) * inverse_extent();
+        return density_scale_ * trilinear(*grid_, local);
+    }
+
+    // HittableI
+    HitRecord hit(Ray const & ray, double t_min, double t_max) const override;
+    double transmittance(Ray const & ray, double t0, double t1) const override;
+    Aabb bounding_box(TimeInterval times) const override { return bounds_; }
+
+private:
+    vec3 inverse_extent() const {
+        vec3 const extent = bounds_.max() - bounds_.min();
+        return vec3{1.0 / extent.x, 1.0 / extent.y, 1.0 / extent.z};
+    }
+
+    // Calls `visit(t_begin, t_end, majorant)` for the majorant cells along
+    // the ray within [t0, t1] until `visit` returns false.
+    template <class Visitor>
+    void traverse(Ray const & ray, double t0, double t1, Visitor && visit) const;
+
+    std::shared_ptr<VoxelGridI> grid_;
+    MajorantGrid majorants_;
+    Aabb bounds_;
+    double density_scale_;
+    std::shared_ptr<MaterialI> phase_function_;
+};
+
+template <class Visitor>
+void HeterogeneousMedium::traverse(Ray const & ray, double const t0, double const t1, Visitor && visit) const {
+    auto const interval = bounds_.intersect_interval(ray, TimeInterval{t0, t1});
+    if (!interval || interval->max <= interval->min)
+        return;
+
+    // 3D-DDA through the majorant cells, in units of majorant cells
+    auto const res = majorants_.resolution();
+    auto const voxels = grid_->resolution();
+    vec3 const extent = bounds_.max() - bounds_.min();
+    vec3 const cell_extent{extent.x * majorants_.cell_size() / voxels[0],
+                           extent.y * majorants_.cell_size() / voxels[1],
+                           extent.z * majorants_.cell_size() / voxels[2]};
+
+    auto const entry = ray.at(interval->min) - bounds_.min();
+    std::array<int, 3> cell, step;
+    std::array<double, 3> t_next, t_delta;
+    for (std::size_t dim = 0; dim < 3; ++dim) {
+        cell[dim] = std::clamp(static_cast<int>(std::floor(entry[dim] / cell_extent[dim])), 0, res[dim] - 1);
+        if (ray.d[dim] > 0.0) {
+            step[dim] = 1;
+            t_delta[dim] = cell_extent[dim] / ray.d[dim];
+            t_next[dim] = interval->min + ((cell[dim] + 1) * cell_extent[dim] - entry[dim]) / ray.d[dim];
+        } else if (ray.d[dim] < 0.0) {
+            step[dim] = -1;
+            t_delta[dim] = -cell_extent[dim] / ray.d[dim];
+            t_next[dim] = interval->min + (cell[dim] * cell_extent[dim] - entry[dim]) / ray.d[dim];
+        } else {
+            step[dim] = 0;
+            t_delta[dim] = infinity;
+            t_next[dim] = infinity;
+        }
+    }
+
+    double t = interval->min;
+    while (t < interval->max) {
+        auto const dim = t_next[0] < t_next[1] ? (t_next[0] < t_next[2] ? 0 : 2)
+                                               : (t_next[1] < t_next[2] ? 1 : 2);
+        auto const t_end = std::min(t_next[dim], interval->max);
+        auto const majorant = density_scale_ * majorants_.majorant(cell[0], cell[1], cell[2]);
+        if (t_end > t && !visit(t, t_end, majorant))
+            return;
+
+        t = t_end;
+        cell[dim] += step[dim];
+        t_next[dim] += t_delta[dim];
+        if (cell[dim] < 0 || res[dim] <= cell[dim])
+            return;
+    }
+}
+
+inline HitRecord HeterogeneousMedium::hit(Ray const & ray, double t_min, double t_max) const {
+    auto const ray_length = ray.d.length();
+    std::optional<double> collision;
+
+    // delta tracking: tentative collisions with the local majorant are real
+    // with probability density / majorant
+    traverse(ray, t_min, t_max, [&](double const t_begin, double const t_end, double const majorant) {
+        if (majorant <= 0.0)
+            return true;  // empty space
+        auto t = t_begin;
+        while (true) {
+            t -= std::log(1.0 - random_double()) / (majorant * ray_length);
+            if (t >= t_end)
+                return true;
+            if (random_double() * majorant < density(ray.at(t))) {
+                collision = t;
+                return false;
+            }
+        }
+    });
+
+    if (!collision)
+        return HitRecord::miss();
+
+    HitRecord result{};
+    result.t = *collision;
+    result.p = ray.at(result.t);
+    result.side = FaceSide::medium;
+    result.material_ptr = phase_function_;
+    result.object = this;
+    return result;
+}
+
+inline double HeterogeneousMedium::transmittance(Ray const & ray, double const t0, double const t1) const {
+    auto const ray_length = ray.d.length();
+    double result = 1.0;
+
+    // ratio tracking: weight by the null-collision probability at every
+    // tentative collision instead of terminating
+    traverse(ray, t0, t1, [&](double const t_begin, double const t_end, double const majorant) {
+        if (majorant <= 0.0)
+            return true;
+        auto t = t_begin;
+        while (true) {
+            t -= std::log(1.0 - random_double()) / (majorant * ray_length);
+            if (t >= t_end)
+                return true;
+            result *= 1.0 - density(ray.at(t)) / majorant;
+            if (result <= 0.0)
+                return false;
+        }
+    });
+
+    return std::max(result, 0.0);
+}
@@ -0,0 +1,182 @@
+#include <bvh.hpp>
+#include <volume.hpp>
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <cmath>
+#include <memory>
+
+
+using testing::DoubleEq;
+using testing::DoubleNear;
+using testing::Eq;
+using testing::Ge;
+using testing::Test;
+
+
+TEST(DenseVoxelGrid, is_zero_initialized) {
+    DenseVoxelGrid const grid{GridResolution{2, 3, 4}};
+    EXPECT_THAT(grid.voxel(1, 2, 3), Eq(0.0));
+}
+
+TEST(DenseVoxelGrid, is_zero_outside) {
+    DenseVoxelGrid grid{GridResolution{2, 2, 2}};
+    grid.set(0, 0, 0, 1.0);
+    EXPECT_THAT(grid.voxel(-1, 0, 0), Eq(0.0));
+    EXPECT_THAT(grid.voxel(0, 2, 0), Eq(0.0));
+}
+
+TEST(DenseVoxelGrid, stores_values) {
+    DenseVoxelGrid grid{GridResolution{2, 3, 4}};
+    grid.set(1, 2, 3, 0.5);
+    EXPECT_THAT(grid.voxel(1, 2, 3), Eq(0.5));
+    EXPECT_THAT(grid.voxel(1, 2, 2), Eq(0.0));
+}
+
+TEST(SparseVoxelGrid, allocates_only_nonzero_bricks) {
+    SparseVoxelGrid grid{GridResolution{64, 64, 64}};
+    grid.set(0, 0, 0, 0.0);
+    EXPECT_THAT(grid.allocated_bricks(), Eq(0u));
+    grid.set(20, 30, 40, 1.0);
+    grid.set(21, 31, 41, 2.0);
+    EXPECT_THAT(grid.allocated_bricks(), Eq(1u));
+    EXPECT_THAT(grid.voxel(20, 30, 40), Eq(1.0));
+    EXPECT_THAT(grid.voxel(21, 31, 41), Eq(2.0));
+    EXPECT_THAT(grid.voxel(22, 31, 41), Eq(0.0));
+}
+
+TEST(SparseVoxelGrid, equals_the_dense_grid_it_is_built_from) {
+    DenseVoxelGrid dense{GridResolution{10, 11, 12}};
+    for (int ii = 0; ii < 50; ++ii)
+        dense.set(random_int(0, 9), random_int(0, 10), random_int(0, 11), random_double());
+    SparseVoxelGrid const sparse{dense};
+    for (int k = 0; k < 12; ++k)
+        for (int j = 0; j < 11; ++j)
+            for (int i = 0; i < 10; ++i)
+                ASSERT_THAT(sparse.voxel(i, j, k), Eq(dense.voxel(i, j, k)));
+}
+
+TEST(trilinear, returns_voxel_values_at_voxel_centers) {
+    DenseVoxelGrid grid{GridResolution{2, 2, 2}};
+    grid.set(0, 0, 0, 1.0);
+    grid.set(1, 1, 1, 3.0);
+    EXPECT_THAT(trilinear(grid, vec3{0.25, 0.25, 0.25}), DoubleEq(1.0));
+    EXPECT_THAT(trilinear(grid, vec3{0.75, 0.75, 0.75}), DoubleEq(3.0));
+}
+
+TEST(trilinear, interpolates_between_voxel_centers) {
+    DenseVoxelGrid grid{GridResolution{2, 1, 1}};
+    grid.set(0, 0, 0, 1.0);
+    grid.set(1, 0, 0, 3.0);
+    EXPECT_THAT(trilinear(grid, vec3{0.5, 0.5, 0.5}), DoubleEq(2.0));
+}
+
+TEST(MajorantGrid, bounds_all_trilinear_lookups) {
+    DenseVoxelGrid grid{GridResolution{16, 16, 16}};
+    for (int ii = 0; ii < 20; ++ii)
+        grid.set(random_int(0, 15), random_int(0, 15), random_int(0, 15), random_double());
+    MajorantGrid const majorants{grid, 4};
+    for (int ii = 0; ii < 2000; ++ii) {
+        auto const local = vec3::random();
+        auto const cell_x = static_cast<int>(local.x * 4);
+        auto const cell_y = static_cast<int>(local.y * 4);
+        auto const cell_z = static_cast<int>(local.z * 4);
+        ASSERT_THAT(majorants.majorant(cell_x, cell_y, cell_z), Ge(trilinear(grid, local)));
+    }
+}
+
+TEST(MajorantGrid, is_zero_far_from_density) {
+    DenseVoxelGrid grid{GridResolution{16, 16, 16}};
+    grid.set(0, 0, 0, 1.0);
+    MajorantGrid const majorants{grid, 4};
+    EXPECT_THAT(majorants.majorant(0, 0, 0), Eq(1.0));
+    EXPECT_THAT(majorants.majorant(3, 3, 3), Eq(0.0));
+}
+
+struct AHomogeneousGridMedium : Test {
+    static std::shared_ptr<VoxelGridI> uniform_grid() {
+        auto grid = std::make_shared<DenseVoxelGrid>(GridResolution{8, 8, 8});
+        for (int k = 0; k < 8; ++k)
+            for (int j = 0; j < 8; ++j)
+                for (int i = 0; i < 8; ++i)
+                    grid->set(i, j, k, 1.0);
+        return grid;
+    }
+
+    double const sigma = 0.5;
+    HeterogeneousMedium const medium{uniform_grid(), Aabb{AabbBounds{point3{0.0}, point3{4.0}}}, sigma, color{1.0}, 2};
+    // passes through the inner voxels only, where the interpolated density is constant
+    Ray const ray{point3{-1.0, 2.0, 2.0}, vec3{2.0, 0.0, 0.0}};
+};
+
+TEST_F(AHomogeneousGridMedium, has_scaled_density) {
+    EXPECT_THAT(medium.density(point3{2.0}), DoubleEq(sigma));
+}
+
+TEST_F(AHomogeneousGridMedium, has_expected_transmittance) {
+    // from x = 1 to x = 3 the density is constant
+    double mean = 0.0;
+    int const n = 20000;
+    for (int ii = 0; ii < n; ++ii)
+        mean += medium.transmittance(ray, 1.0, 2.0) / n;
+    EXPECT_THAT(mean, DoubleNear(std::exp(-sigma * 2.0), 0.01));
+}
+
+TEST_F(AHomogeneousGridMedium, attenuates_shadow_rays_through_a_world) {
+    BvhNode const world{HittableList{std::make_shared<HeterogeneousMedium>(medium)}, TimeInterval{0.0, 1.0}};
+    double mean = 0.0;
+    int const n = 20000;
+    for (int ii = 0; ii < n; ++ii)
+        mean += world.transmittance(ray, 1.0, 2.0) / n;
+    EXPECT_THAT(mean, DoubleNear(std::exp(-sigma * 2.0), 0.01));
+}
+
+TEST_F(AHomogeneousGridMedium, scatters_with_exponential_free_flight) {
+    // probability of a collision between x = 1 and x = 3
+    int const n = 20000;
+    int collisions = 0;
+    for (int ii = 0; ii < n; ++ii)
+        collisions += medium.hit(ray, 1.0, 2.0) ? 1 : 0;
+    EXPECT_THAT(static_cast<double>(collisions) / n, DoubleNear(1.0 - std::exp(-sigma * 2.0), 0.01));
+}
+
+TEST_F(AHomogeneousGridMedium, scatters_inside_the_ray_interval) {
+    for (int ii = 0; ii < 100; ++ii)
+        if (auto const hit_record = medium.hit(ray, 1.0, 2.0)) {
+            EXPECT_THAT(hit_record.t, Ge(1.0));
+            EXPECT_THAT(2.0, Ge(hit_record.t));
+        }
+}
+
+TEST(HeterogeneousMedium, estimates_fractional_transmittance_by_ratio_tracking) {
+    // below their majorant, tentative collisions scale the estimate instead of ending it
+    auto grid = std::make_shared<DenseVoxelGrid>(GridResolution{8, 8, 8});
+    for (int k = 0; k < 8; ++k)
+        for (int j = 0; j < 8; ++j)
+            for (int i = 0; i < 8; ++i)
+                grid->set(i, j, k, (i + j + k) % 2 == 0 ? 1.0 : 0.5);
+    HeterogeneousMedium const medium{grid, Aabb{AabbBounds{point3{0.0}, point3{1.0}}}, 1.0, color{1.0}};
+    Ray const ray{point3{-1.0, 0.5, 0.5}, vec3{1.0, 0.0, 0.0}};
+    bool fractional = false;
+    for (int ii = 0; ii < 100; ++ii) {
+        auto const transmittance = medium.transmittance(ray, 0.0, infinity);
+        fractional = fractional || (0.0 < transmittance && transmittance < 1.0);
+    }
+    EXPECT_TRUE(fractional);
+}
+
+TEST(HeterogeneousMedium, never_scatters_in_empty_grids) {
+    HeterogeneousMedium const medium{std::make_shared<SparseVoxelGrid>(GridResolution{32, 32, 32}),
+                                     Aabb{AabbBounds{point3{0.0}, point3{1.0}}}, 1.0, color{1.0}};
+    Ray const ray{point3{-1.0, 0.5, 0.5}, vec3{1.0, 0.0, 0.0}};
+    EXPECT_FALSE(medium.hit(ray, 0.0, infinity));
+    EXPECT_THAT(medium.transmittance(ray, 0.0, infinity), Eq(1.0));
+}
+
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
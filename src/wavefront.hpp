@@ -0,0 +1,190 @@
+#pragma once
+
+#include <color.hpp>
+#include <hit.hpp>
+#include <integrator.hpp>
+#include <material.hpp>
+#include <ray.hpp>
+#include <scenes.hpp>
+#include <vec3.hpp>
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Paths alive at one bounce, in structure-of-arrays layout.
+struct PathQueue {
+    std::vector<point3> origins;
+    std::vector<vec3> directions;
+    std::vector<double> times;
+    std::vector<color> throughputs;
+    std::vector<std::uint32_t> estimates;  // index of the radiance estimate the path contributes to
+    std::vector<ns_integrator::PreviousEvent> previous_events;
+    std::vector<ns_integrator::RayCone> cones;  // footprints for texture filtering
+
+    std::size_t size() const { return origins.size(); }
+
+    Ray ray(std::size_t const index) const { return Ray{origins[index], directions[index], times[index]}; }
+
+    void push(Ray const & ray,
+              color const & throughput,
+              std::uint32_t const estimate,
+              ns_integrator::RayCone const & cone,
+              ns_integrator::PreviousEvent const & previous_event = {}) {
+        origins.push_back(ray.o);
+        directions.push_back(ray.d);
+        times.push_back(ray.time());
+        throughputs.push_back(throughput);
+        estimates.push_back(estimate);
+        previous_events.push_back(previous_event);
+        cones.push_back(cone);
+    }
+
+    void clear() {
+        origins.clear();
+        directions.clear();
+        times.clear();
+        throughputs.clear();
+        estimates.clear();
+        previous_events.clear();
+        cones.clear();
+    }
+};
+
+// Shadow rays of one bounce, in structure-of-arrays layout.
+struct ShadowQueue {
+    std::vector<Ray> rays;
+    std::vector<double> t_maxs;
+    std::vector<color> contributions;      // including the path throughput
+    std::vector<std::uint32_t> estimates;
+
+    std::size_t size() const { return rays.size(); }
+
+    void push(ShadowRay const & shadow, color const & throughput, std::uint32_t const estimate) {
+        rays.push_back(shadow.ray);
+        t_maxs.push_back(shadow.t_max);
+        contributions.push_back(throughput * shadow.contribution);
+        estimates.push_back(estimate);
+    }
+
+    void clear() {
+        rays.clear();
+        t_maxs.clear();
+        contributions.clear();
+        estimates.clear();
+    }
+};
+
+// Breadth-first reference implementation of `ray_color` without a guide or
+// a radiance cache. All paths advance one bounce at a time through separate
+// stages: the intersection of the whole queue, the shading of the hits, and
+// the tracing of the shadow rays generated by shading. Shading goes through the
+// virtual `scatter` and `eval` of the materials in queue order; sorting the
+// hits by material did not pay off without kernels per material type. The
+// queues are kept between calls, so that one instance per thread does not
+// allocate once warmed up.
+//
+// Light from `scene.lights` and `scene.media` is sampled as in `ray_color`;
+// `scene.environment` is only found by the scattered rays, and the caustics
+// are not estimated from `scene.caustics`.
+class WavefrontIntegrator {
+public:
+    WavefrontIntegrator(HittableI const & world, Scene const & scene, int const max_depth)
+        : world_{world}, scene_{scene}, max_depth_{max_depth} {}
+
+    // one radiance estimate per ray
+    std::vector<color> const & trace(std::vector<Ray> const & rays);
+
+private:
+    void intersect(bool sample_lights);
+    void shade(bool sample_lights, int depth);
+    void trace_shadow_rays();
+
+    HittableI const & world_;
+    Scene const & scene_;
+    int const max_depth_;
+
+    PathQueue paths_, next_paths_;
+    ShadowQueue shadows_;
+    std::vector<HitRecord> hits_;
+    std::vector<std::uint32_t> order_;  // paths with a hit
+    std::vector<color> estimates_;
+};
+
+inline std::vector<color> const & WavefrontIntegrator::trace(std::vector<Ray> const & rays) {
+    estimates_.assign(rays.size(), color{0.0, 0.0, 0.0});
+    paths_.clear();
+    for (std::size_t ii = 0; ii < rays.size(); ++ii)
+        paths_.push(rays[ii], color{1.0, 1.0, 1.0}, static_cast<std::uint32_t>(ii), ns_integrator::RayCone{0.0, scene_.pixel_spread});
+
+    for (int depth = 0; depth < max_depth_ && paths_.size() > 0; ++depth) {
+        // light sampled at this event is reached after depth + 1 events
+        bool const sample_lights = !scene_.lights.objects.empty() && depth + 1 < max_depth_;
+        intersect(sample_lights);
+        shade(sample_lights, depth);
+        trace_shadow_rays();
+        std::swap(paths_, next_paths_);
+    }
+    return estimates_;
+}
+
+inline void WavefrontIntegrator::intersect(bool const sample_lights) {
+    hits_.resize(paths_.size());
+    order_.clear();
+    for (std::size_t ii = 0; ii < paths_.size(); ++ii) {
+        auto const ray = paths_.ray(ii);
+        hits_[ii] = world_.hit(ray, 1e-3, infinity);
+        if (hits_[ii])
+            hits_[ii].footprint = paths_.cones[ii].advance(ray, hits_[ii]);
+        auto & estimate = estimates_[paths_.estimates[ii]];
+
+        if (sample_lights)
+            for (auto const & medium : scene_.media)
+                estimate += paths_.throughputs[ii]
+                          * medium->in_scattered_light(ray, 1e-3, hits_[ii] ? hits_[ii].t : infinity, scene_.lights, world_);
+
+        if (hits_[ii])
+            order_.push_back(static_cast<std::uint32_t>(ii));
+        else
+            estimate += paths_.throughputs[ii] * scene_.background_color(ray);
+    }
+}
+
+inline void WavefrontIntegrator::shade(bool const sample_lights, int const depth) {
+    next_paths_.clear();
+    shadows_.clear();
+    for (auto const ii : order_) {
+        auto const & rec = hits_[ii];
+        auto const ray = paths_.ray(ii);
+        auto const estimate = paths_.estimates[ii];
+        auto throughput = paths_.throughputs[ii];
+
+        auto const scatter_info = rec.material_ptr->scatter(ray, rec);
+        estimates_[estimate] += paths_.previous_events[ii].emission_weight(scene_.lights, rec) * throughput * scatter_info.emitted;
+        if (!scatter_info)
+            continue;
+
+        bool const medium_event = ns_integrator::is_listed_medium(scene_, rec.object);
+        bool const lights_sampled = sample_lights && (medium_event || !rec.material_ptr->is_specular());
+        ns_integrator::PreviousEvent previous{lights_sampled, medium_event, rec.p, 0.0};
+        if (lights_sampled && !medium_event) {
+            if (auto const shadow = sample_light(rec, -ray.d, ray.time(), scene_.lights))
+                shadows_.push(*shadow, throughput, estimate);
+            previous.pdf = rec.material_ptr->pdf(rec, scatter_info.scattered_ray.d, -ray.d);
+        }
+
+        throughput = throughput * scatter_info.attenuation;
+        if (!ns_integrator::survives_roulette(depth, throughput))
+            continue;
+
+        auto cone = paths_.cones[ii];
+        cone.scatter(rec.material_ptr->is_specular());
+        next_paths_.push(scatter_info.scattered_ray, throughput, estimate, cone, previous);
+    }
+}
+
+inline void WavefrontIntegrator::trace_shadow_rays() {
+    for (std::size_t ii = 0; ii < shadows_.size(); ++ii)
+        estimates_[shadows_.estimates[ii]] += world_.transmittance(shadows_.rays[ii], 1e-3, shadows_.t_maxs[ii])
+                                            * shadows_.contributions[ii];
+}
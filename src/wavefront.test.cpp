@@ -0,0 +1,110 @@
+#include <wavefront.hpp>
+
+#include <hittable_list.hpp>
+#include <integrator.hpp>
+#include <material.hpp>
+#include <quad.hpp>
+#include <sphere.hpp>
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <memory>
+#include <vector>
+
+
+using testing::DoubleNear;
+using testing::Eq;
+using testing::Test;
+
+
+Scene scene_of(HittableList const & world, color const background, HittableList const & lights = {}) {
+    return Scene{world, [background](Ray const &) { return background; }, Camera{}, lights, {}};
+}
+
+TEST(WavefrontIntegrator, returns_nothing_for_no_rays) {
+    auto const scene = scene_of(HittableList{}, color{1.0});
+    WavefrontIntegrator integrator{scene.world, scene, 10};
+    EXPECT_TRUE(integrator.trace({}).empty());
+}
+
+TEST(WavefrontIntegrator, returns_one_estimate_per_ray_in_order) {
+    auto const scene = scene_of(HittableList{std::make_shared<Sphere>(point3{0.0, 0.0, -5.0}, 1.0,
+                                                                      std::make_shared<DiffuseLight>(color{2.0}))},
+                                color{0.5});
+    WavefrontIntegrator integrator{scene.world, scene, 10};
+    auto const estimates = integrator.trace({Ray{point3{0.0}, vec3{0.0, 0.0, -1.0}},
+                                             Ray{point3{0.0}, vec3{0.0, 0.0, 1.0}},
+                                             Ray{point3{0.0}, vec3{0.0, 0.0, -1.0}}});
+    EXPECT_THAT(estimates, Eq(std::vector<color>{color{2.0}, color{0.5}, color{2.0}}));
+}
+
+// the width of the footprint of the lookup
+struct FootprintTexture : TextureI {
+    color value(TextureCoordinates2d const, point3 const &) const override { return color{0.0}; }
+    color filtered_value(TextureCoordinates2d const, point3 const &, Footprint const & footprint) const override {
+        return color{footprint.width};
+    }
+};
+
+TEST(WavefrontIntegrator, widens_the_footprint_along_the_path) {
+    HittableList const world{std::vector<std::shared_ptr<HittableI>>{
+        std::make_shared<Quad>(point3{-1.0, -1.0, -2.0}, vec3{2.0, 0.0, 0.0}, vec3{0.0, 2.0, 0.0},
+                               std::make_shared<metal>(color{1.0})),
+        std::make_shared<Quad>(point3{-1.0, -1.0, 3.0}, vec3{2.0, 0.0, 0.0}, vec3{0.0, 2.0, 0.0},
+                               std::make_shared<DiffuseLight>(std::make_shared<FootprintTexture>()))}};
+    auto scene = scene_of(world, color{0.0});
+    scene.pixel_spread = 0.01;
+    WavefrontIntegrator integrator{world, scene, 10};
+    // 2 to the mirror and 5 back to the light, with the spread of the camera
+    EXPECT_THAT(integrator.trace({Ray{point3{0.0}, vec3{0.0, 0.0, -1.0}}}).front().x, DoubleNear(0.07, 1e-9));
+}
+
+struct AFloorBelowALight : Test {
+    std::shared_ptr<HittableI> const light = std::make_shared<Quad>(point3{-0.25, 1.0, -0.25}, vec3{0.5, 0.0, 0.0}, vec3{0.0, 0.0, 0.5},
+                                                                    std::make_shared<DiffuseLight>(color{4.0}));
+    HittableList const world = make_world();
+    Scene const scene = scene_of(world, color{0.1}, HittableList{light});
+    std::vector<Ray> const rays = std::vector<Ray>(40000, Ray{point3{0.0, 0.5, 0.5}, vec3{0.0, -1.0, -1.0}});
+
+    HittableList make_world() const {
+        HittableList result{light};
+        result.add(std::make_shared<Quad>(point3{-1.0, 0.0, -1.0}, vec3{0.0, 0.0, 2.0}, vec3{1.0, 0.0, 0.0},
+                                          std::make_shared<lambertian>(color{0.5})));
+        result.add(std::make_shared<Quad>(point3{0.0, 0.0, -1.0}, vec3{0.0, 0.0, 2.0}, vec3{1.0, 0.0, 0.0},
+                                          std::make_shared<metal>(color{0.8}, 0.3)));
+        result.add(std::make_shared<Sphere>(point3{0.0, 0.3, -0.3}, 0.2, std::make_shared<dielectric>(1.5)));
+        return result;
+    }
+
+    static double mean(std::vector<color> const & estimates) {
+        double result = 0.0;
+        for (auto const & estimate : estimates)
+            result += estimate.x / estimates.size();
+        return result;
+    }
+};
+
+TEST_F(AFloorBelowALight, estimates_the_same_as_ray_color) {
+    WavefrontIntegrator integrator{world, scene, 6};
+    auto const wavefront = mean(integrator.trace(rays));
+
+    std::vector<color> reference;
+    for (auto const & ray : rays)
+        reference.push_back(ray_color(ray, world, scene, 6));
+    EXPECT_THAT(wavefront, DoubleNear(mean(reference), 0.03 * mean(reference)));
+}
+
+TEST_F(AFloorBelowALight, can_be_reused) {
+    WavefrontIntegrator integrator{world, scene, 6};
+    auto const first = mean(integrator.trace(rays));
+    auto const second = mean(integrator.trace(rays));
+    EXPECT_THAT(second, DoubleNear(first, 0.03 * first));
+}
+
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}